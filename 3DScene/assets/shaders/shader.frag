@@ -6,9 +6,15 @@ in vec3 Normal;
 in vec2 TexCoord;
 
 uniform sampler2D tex;
-uniform vec3 keyLightDir; 
-uniform vec3 keyLightColor;
-uniform vec3 viewPos; // Camera's position
+
+// per-frame camera and lighting data, must match the block in shader.vert
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos; // Camera's position
+    vec4 keyLightDir;
+    vec4 keyLightColor;
+};
 
 void main() {
     /*
@@ -17,19 +23,19 @@ void main() {
     *
     */ 
     float ambientStrength = 0.4;
-    vec3 ambient = ambientStrength * keyLightColor;
+    vec3 ambient = ambientStrength * keyLightColor.rgb;
 
     // Diffuse
     vec3 norm = normalize(Normal);
-    float diff = max(dot(norm, keyLightDir), 0.0); 
-    vec3 diffuse = diff * keyLightColor;
+    float diff = max(dot(norm, keyLightDir.xyz), 0.0); 
+    vec3 diffuse = diff * keyLightColor.rgb;
 
     // Specular
     float specularStrength = 0.5;
-    vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 reflectDir = reflect(-keyLightDir, norm); 
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
+    vec3 reflectDir = reflect(-keyLightDir.xyz, norm); 
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * keyLightColor;
+    vec3 specular = specularStrength * spec * keyLightColor.rgb;
 
     // Combine the results
     vec3 objectColor = texture(tex, TexCoord).rgb;
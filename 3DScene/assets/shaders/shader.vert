@@ -1,20 +1,40 @@
 #version 330 core
 layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 color; 
-layout (location = 2) in vec3 normal;
+layout (location = 2) in vec3 normal; // only xy is fetched when normals are octahedral encoded
 layout (location = 3) in vec2 uv;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
 
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 model;
+// per-frame camera and lighting data, updated once per frame and shared by every program
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 keyLightDir;
+    vec4 keyLightColor;
+};
+
+// per-object data, bound as a range of the object ring for each draw
+layout (std140) uniform ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    uvec4 vertexFormat;
+};
+
+// unfolds a normal stored on the octahedron
+vec3 octDecode(vec2 e){
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return n;
+}
 
 void main(){
     gl_Position = projection * view * model * vec4(position, 1.0);
     FragPos = vec3(model * vec4(position, 1.0)); // World position of vertex
-    Normal = normalize(mat3(transpose(inverse(model))) * normal); // Transform normal to world space and normalize
+    vec3 objectNormal = vertexFormat.x == 1u ? octDecode(normal.xy) : normal;
+    Normal = normalize(mat3(normalMatrix) * objectNormal); // Transform normal to world space and normalize
     TexCoord = uv;
 }
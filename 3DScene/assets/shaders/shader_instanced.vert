@@ -0,0 +1,50 @@
+#version 420 core
+layout (location = 0) in vec3 position;
+layout (location = 2) in vec3 normal; // only xy is fetched when normals are octahedral encoded
+layout (location = 3) in vec2 uv;
+layout (location = 4) in mat4 instanceModel; // per instance, locations 4 to 7
+layout (location = 8) in uint instanceMaterial; // per instance
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+flat out uint MaterialIndex;
+
+// per-frame camera and lighting data, updated once per frame and shared by every program
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 keyLightDir;
+    vec4 keyLightColor;
+};
+
+// per-mesh data, model only holds the mesh's dequantization and normalMatrix is unused
+layout (std140) uniform ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    uvec4 vertexFormat;
+};
+
+// unfolds a normal stored on the octahedron
+vec3 octDecode(vec2 e){
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return n;
+}
+
+void main(){
+    vec4 worldPos = instanceModel * (model * vec4(position, 1.0));
+    gl_Position = projection * view * worldPos;
+    FragPos = worldPos.xyz;
+
+    // the cofactor matrix is the inverse transpose up to scale, which the normalize removes
+    mat3 m = mat3(instanceModel);
+    mat3 cofactor = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    vec3 objectNormal = vertexFormat.x == 1u ? octDecode(normal.xy) : normal;
+    Normal = normalize(cofactor * objectNormal) * sign(determinant(m)); // mirrored instances flip the cofactor
+
+    TexCoord = uv;
+    MaterialIndex = instanceMaterial;
+}
@@ -9,20 +9,73 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <string>
+#include <frame_pacer.h>
+#include <frustum_culling.h>
+#include <geometry_arena.h>
+#include <input.h>
 #include <mesh.h>
+#include <mesh_file.h>
+#include <mesh_lod.h>
+#include <path_tracer.h>
+#include <scene_graph.h>
 #include <shader.h>
+#include <soft_rasterizer.h>
+#include <ray_scene.h>
+#include <texture_manager.h>
+#include <thread_pool.h>
+#include <uniform_buffer.h>
 #include "camera.h" 
+
+// settings for rendering the scene offscreen along a scripted camera path
+struct HeadlessOptions {
+	uint32_t frames{ 300 }; // number of frames to render
+	std::string outputPath{ "frame_times.csv" }; // frame timings are written as JSON when this ends in .json
+};
+
+// one object in the scene, its world transform comes from the scene graph
+struct SceneObject {
+	const char* name;
+	size_t mesh; // index into meshes and arenaMeshes
+	NodeId node;
+	const char* textureFile; // under assets/textures
+	TextureHandle texture{};
+	uint32_t lod{ 0 }; // level drawn last frame, where the hysteresis band is measured from
+};
+
+// levels of detail of one scene mesh, level 0 is the mesh itself
+struct MeshLodChain {
+	std::vector<size_t> meshes; // index into meshes and arenaMeshes per level
+	std::vector<float> errors; // object space error per level
+};
+
 class App {
 public:
 	App(std::string WindowTitle, int width, int height); //window title, width, and height
-	void Run(); //starts the main loop of the app
+	void Run(const FrameLoopOptions& loopOptions = {}); //starts the main loop of the app
+	bool RunHeadless(const HeadlessOptions& options); //renders into an offscreen framebuffer and writes frame timings
+	bool RunBenchmark(const std::string& name); //runs one of the GL microbenchmarks against the loaded scene
+	bool BakeMeshes(const Path& directory); //writes the scene meshes as baked mesh files, needs no window
+	bool RunPathTrace(const PathTraceOptions& options); //renders the scene with the CPU path tracer and writes a PNG, needs no window
+	bool RunRasterize(const RasterOptions& options); //renders the scene with the CPU rasterizer and writes a PNG, needs no window
 
 	// methods for opening window, setting up the scene, updating the app, rendering the scene, and initializing camera controls
 private:
-	bool openWindow();
+	bool openWindow(bool headless = false);
+	bool createOffscreenTarget();
+	void destroyOffscreenTarget();
+	void applyCameraPath(uint32_t frame, uint32_t frameCount); // orbits the camera around the scene for headless runs
 	void setupScene();
+	void setupPathTracer(PathTracer& tracer, const std::vector<MeshSource>& sources);
+	void setupSoftRasterizer(SoftRasterizer& rasterizer, const std::vector<MeshSource>& sources);
+	std::vector<Image> loadObjectImages() const;
+	RasterFrame rasterFrame(uint32_t width, uint32_t height) const;
+	glm::mat4 projectionMatrix(float aspectRatio) const;
 	void initializeCameraControls(); // Sets up camera input callbacks
 	void handleCameraMovement(float deltaTime); // Processes camera input 
+	InputClock::time_point applyInput(); // drains queued input into the camera, returns the time of the oldest event
+	void buildSceneGraph(); // scene graph nodes and the objects placed on them
+	void updateObjectBounds(); // hands moved objects to the ray scene, which refits its BVH
+	void pickObject(); // casts a ray from the camera along its view direction and reports the object it hits
 	bool update();
 	bool draw();
 
@@ -33,26 +86,50 @@ private:
 	int _height{};
 	GLFWwindow* window{ nullptr };
 
+	// offscreen render target used by headless runs
+	GLuint offscreenFBO{ 0 };
+	GLuint offscreenColor{ 0 };
+	GLuint offscreenDepth{ 0 };
+
 	std::vector<Mesh> meshes;
+	GeometryArena geometry; // the same meshes suballocated from shared buffers, drawn with multi-draw indirect
+	std::vector<ArenaMesh> arenaMeshes; // parallel to meshes
+	std::vector<MeshLodChain> lodChains; // one per scene mesh, the coarser levels are stored after the scene meshes
+	bool useGeometryArena{ false }; // set when the context supports multi-draw indirect
+	FrustumCuller culler; // world bounding spheres of this frame's objects
+	RayScene rayScene; // meshes and objects parallel to meshes and objects, culls large scenes and answers picking and collision rays
+	std::vector<uint32_t> visibleItems;
+	CullStats cullStats; // from the last draw
 	Shader shader;
+	Shader instancedShader; // shader_instanced.vert with shader.frag, model matrices come from an instance buffer
+	UniformBuffer frameUniforms; // camera and lighting, bound once at FrameBinding
+	UniformRing objectUniforms; // model matrices, one record per draw
 	bool running{ false };
 	bool _isOrthographic{ false }; //Projection mode
 
 	Camera _camera; //Camera object
 
-	GLuint woodtilesTexture;
-	GLuint silverTexture;
-	GLuint quartzTexture;
-	GLuint spongeTexture;
+	Input input;
+	std::vector<InputEvent> inputEvents; // reused by applyInput
+	InputLatency inputLatency;
+
+	TextureManager textures;
+
+	// declared after the textures so it is joined before the texture manager its tasks report to goes away
+	ThreadPool workers;
+	GLuint textureSampler{ 0 };
 
 	// Lighting variables
 	glm::vec3 keyLightDir;
 	glm::vec3 keyLightColor;
 	float keyLightIntensity; 
 
-	// Transformation matrices for sponge, pyramid, and sphere/cylinder
-	glm::mat4 spongeTransform;
-	glm::mat4 pyramidTransform;
-	glm::mat4 sphereCylinderTransform; 
+	// Transformations for the plane and the sponge, pyramid, and sphere/cylinder sitting on it
+	SceneGraph scene;
+	NodeId planeNode{ 0 };
+	NodeId spongeNode{ 0 };
+	NodeId pyramidNode{ 0 };
+	NodeId sphereCylinderNode{ 0 };
+	std::vector<SceneObject> objects;
 
 };
\ No newline at end of file
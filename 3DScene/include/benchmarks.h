@@ -0,0 +1,66 @@
+/*
+* Declares the microbenchmarks that can be run from the command line with --bench <name>.
+* Each one prints its results to the console
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include <mesh_file.h>
+#include <geometry_arena.h>
+#include <mesh.h>
+#include <path_tracer.h>
+#include <scene_graph.h>
+#include <shader.h>
+#include <soft_rasterizer.h>
+
+namespace Benchmarks {
+	// compares uploading uniforms through glGetUniformLocation on every call against the cached table and pre-resolved handles
+	void UniformLookup(uint32_t iterations);
+
+	// bakes the meshes into directory, then compares uploading them from memory against opening and mapping the baked files
+	void MeshLoad(const std::vector<MeshSource>& sources, const std::filesystem::path& directory, uint32_t iterations);
+
+	// packs a mesh in each vertex format and reports size, precision loss, and draw time against the authored Vertex
+	void VertexFormats(std::span<const Vertex> vertices, std::span<const uint32_t> indices, uint32_t iterations);
+
+	// draws 1 to 100k copies of a mesh, once with a uniform record and draw call per copy and once as a single instanced draw.
+	// FrameData must already be bound
+	void Instancing(Mesh& mesh, Shader& shader, Shader& instancedShader);
+
+	// draws the meshes as many objects in two pipeline buckets, once per object and once with a multi-draw per bucket,
+	// then churns an arena to report fragmentation. FrameData must already be bound
+	void MultiDraw(const std::vector<MeshSource>& sources, Shader& shader, Shader& instancedShader);
+
+	// animates a graph of about 50k nodes, comparing the dirty subtree update against recomputing every world matrix
+	void SceneGraphUpdate(uint32_t frames);
+
+	// culls up to 100k random spheres against a camera frustum with the scalar and SIMD loops
+	void FrustumCulling(uint32_t frames);
+
+	// builds and refits a BVH over 10k to 1M random boxes, then times frustum and ray queries against it
+	void BvhBuild(uint32_t rays);
+
+	// tessellates the sphere and cylinder up to millions of triangles and measures closest and any hit rays per second
+	void TriangleRaycast(uint32_t rays);
+
+	// renders a small image with 1 worker up to one per hardware thread and reports samples per second and scaling
+	void PathTraceScaling(PathTracer& tracer);
+
+	// generates spheres of 256 to 4096 segments, allocating vectors through Shapes and writing into reused buffers
+	// on one thread and across the pool
+	void ShapeGeneration(ThreadPool& pool);
+
+	// simplifies a dense sphere into a chain, then moves a camera back and forth in front of a field of objects at 1080p and counts the
+	// triangles and level switches with full detail, with level selection, and with selection but no hysteresis
+	void LevelOfDetail(uint32_t objectCount, uint32_t frames);
+
+	// optimizes the sphere and cylinder at 32 to 512 segments and reports ACMR and ATVR before and after and the time taken
+	void MeshOptimization();
+
+	// renders each frame with the CPU rasterizer and reports the time of every stage
+	void SoftRaster(SoftRasterizer& rasterizer, ThreadPool& pool, std::span<const RasterFrame> frames, uint32_t width, uint32_t height);
+}
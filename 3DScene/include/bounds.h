@@ -0,0 +1,47 @@
+/*
+* Defines the bounding volumes used for culling and picking, an axis aligned box and a sphere
+*
+*/
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+// axis aligned box around a mesh or submesh
+struct MeshBounds {
+	glm::vec3 min{ 0.0f };
+	glm::vec3 max{ 0.0f };
+
+	glm::vec3 Center() const { return (min + max) * 0.5f; }
+	glm::vec3 Extents() const { return (max - min) * 0.5f; }
+};
+
+struct BoundingSphere {
+	glm::vec3 center{ 0.0f };
+	float radius{ 0.0f };
+};
+
+// largest factor the transform stretches any direction by, ignoring shear
+inline float MaxScale(const glm::mat4& transform)
+{
+	float scaleX = glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0]));
+	float scaleY = glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1]));
+	float scaleZ = glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]));
+	return glm::sqrt(glm::max(scaleX, glm::max(scaleY, scaleZ)));
+}
+
+// sphere around a transformed object, the radius grows with the largest axis scale
+inline BoundingSphere TransformSphere(const BoundingSphere& sphere, const glm::mat4& transform)
+{
+	return { glm::vec3(transform * glm::vec4(sphere.center, 1.0f)), sphere.radius * MaxScale(transform) };
+}
+
+// box around a transformed box, each world axis takes the absolute matrix row times the extents
+inline MeshBounds TransformBounds(const MeshBounds& bounds, const glm::mat4& transform)
+{
+	glm::vec3 center = glm::vec3(transform * glm::vec4(bounds.Center(), 1.0f));
+	glm::vec3 extents = bounds.Extents();
+	glm::vec3 worldExtents = glm::abs(glm::vec3(transform[0])) * extents.x + glm::abs(glm::vec3(transform[1])) * extents.y
+		+ glm::abs(glm::vec3(transform[2])) * extents.z;
+	return { center - worldExtents, center + worldExtents };
+}
@@ -0,0 +1,131 @@
+/*
+* Defines the bounding volume hierarchy used for culling and ray queries. Nodes are 32 bytes and live in one flat
+* array with both children of a node stored next to each other, and every node is stored after its parent so
+* a refit is a single back to front pass. Leaves refer to a range of the reordered item list
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include <bounds.h>
+#include <frustum_culling.h>
+
+struct Ray {
+	glm::vec3 origin{ 0.0f };
+	glm::vec3 direction{ 0.0f, 0.0f, -1.0f };
+	float tMax{ std::numeric_limits<float>::infinity() };
+};
+
+struct BvhNode {
+	glm::vec3 min{ 0.0f };
+	uint32_t leftOrFirst{ 0 }; // first item of a leaf, left child of an inner node (the right child follows it)
+	glm::vec3 max{ 0.0f };
+	uint32_t count{ 0 }; // items in a leaf, 0 for inner nodes
+
+	bool IsLeaf() const { return count > 0; }
+};
+static_assert(sizeof(BvhNode) == 32, "BVH nodes are meant to fill half a cache line");
+
+// slab test, returns the entry distance or infinity when the ray misses the box or it is farther than ray.tMax
+float IntersectBounds(const Ray& ray, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max);
+
+class Bvh {
+public:
+	// binned surface area heuristic build, leaves hold at most maxLeafSize items. testWidth is how many
+	// items the leaf test handles at once, leaves are costed in whole tests of that many
+	void Build(std::span<const MeshBounds> itemBounds, uint32_t maxLeafSize = 4, uint32_t testWidth = 1);
+
+	// keeps the tree shape and recomputes every node box from the items' new bounds
+	void Refit(std::span<const MeshBounds> itemBounds);
+
+	// appends every item whose box touches the frustum
+	void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& items) const;
+
+	// closest item whose box the ray hits, returns false when nothing is hit
+	bool Raycast(const Ray& ray, std::span<const MeshBounds> itemBounds, uint32_t& item, float& distance) const;
+
+	// Visits the leaves the ray reaches, nearest child first. leafTest(firstItem, count, ray) returns the distance
+	// of the closest hit among those items or infinity, hits shorten the ray so farther subtrees are skipped.
+	// A negative return ends the traversal, for queries that only need to know whether anything was hit
+	template <typename LeafTest>
+	void TraverseRay(Ray ray, LeafTest&& leafTest) const;
+
+	const std::vector<BvhNode>& Nodes() const { return nodes; }
+	const std::vector<uint32_t>& Items() const { return items; } // item indices in leaf order
+	bool Empty() const { return nodes.empty(); }
+
+	// deepest level the build creates, leaves at this depth may hold more than maxLeafSize items
+	static constexpr uint32_t MaxDepth = 64;
+
+private:
+	void split(uint32_t rootIndex, std::span<const MeshBounds> itemBounds, std::span<const glm::vec3> centroids, uint32_t maxLeafSize, uint32_t testWidth);
+
+	std::vector<BvhNode> nodes;
+	std::vector<uint32_t> items;
+};
+
+template <typename LeafTest>
+void Bvh::TraverseRay(Ray ray, LeafTest&& leafTest) const
+{
+	if (nodes.empty()) {
+		return;
+	}
+
+	const glm::vec3 inverseDirection = 1.0f / ray.direction;
+	const float infinity = std::numeric_limits<float>::infinity();
+	if (IntersectBounds(ray, inverseDirection, nodes[0].min, nodes[0].max) == infinity) {
+		return;
+	}
+
+	uint32_t stack[MaxDepth];
+	uint32_t stackSize = 0;
+	uint32_t current = 0;
+	while (true) {
+		const BvhNode& node = nodes[current];
+		if (node.IsLeaf()) {
+			float hit = leafTest(node.leftOrFirst, node.count, ray);
+			if (hit < 0.0f) {
+				return;
+			}
+			if (hit < ray.tMax) {
+				ray.tMax = hit;
+			}
+		}
+		else {
+			uint32_t near = node.leftOrFirst, far = node.leftOrFirst + 1;
+			float nearDistance = IntersectBounds(ray, inverseDirection, nodes[near].min, nodes[near].max);
+			float farDistance = IntersectBounds(ray, inverseDirection, nodes[far].min, nodes[far].max);
+			if (farDistance < nearDistance) {
+				std::swap(near, far);
+				std::swap(nearDistance, farDistance);
+			}
+
+			if (nearDistance != infinity) {
+				if (farDistance != infinity) {
+					stack[stackSize++] = far;
+				}
+				current = near;
+				continue;
+			}
+		}
+
+		// pop until a subtree that is still closer than the best hit turns up
+		bool found = false;
+		while (stackSize > 0) {
+			uint32_t candidate = stack[--stackSize];
+			if (IntersectBounds(ray, inverseDirection, nodes[candidate].min, nodes[candidate].max) != infinity) {
+				current = candidate;
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,63 @@
+/*
+* Defines the frame loop pacing: vsync mode, an optional frame rate cap, and the fixed timestep accumulator.
+* The cap sleeps most of the remaining time and spins the last stretch, because sleeps only promise a lower
+* bound and can wake a millisecond or more late
+*
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+enum class VsyncMode {
+	Off,
+	On,
+	Adaptive // tears instead of waiting a whole extra refresh when a frame is late, falls back to On without driver support
+};
+
+struct FrameLoopOptions {
+	VsyncMode vsync{ VsyncMode::On };
+	double frameCap{ 0.0 }; // frames per second, 0 leaves the rate to vsync
+	double fixedStep{ 1.0 / 120.0 }; // seconds of simulation per update
+	uint32_t maxStepsPerFrame{ 8 }; // after a long stall the simulation drops time instead of trying to catch up
+	std::string statsPath{}; // frame timings are written here on exit when set
+};
+
+class FramePacer {
+public:
+	explicit FramePacer(const FrameLoopOptions& options);
+	~FramePacer(); // restores the system timer resolution raised for the frame cap
+	FramePacer(const FramePacer&) = delete;
+	FramePacer& operator=(const FramePacer&) = delete;
+
+	// sets the swap interval of the current context, returns the mode that was applied
+	static VsyncMode ApplyVsync(VsyncMode mode);
+
+	// call at the top of every frame, returns the seconds since the previous call
+	double BeginFrame();
+
+	// number of fixed steps to simulate this frame
+	uint32_t Steps();
+
+	// how far rendering is between the last two simulation states, 0 to 1
+	double Alpha() const { return accumulator / options.fixedStep; }
+
+	// waits until the frame cap allows the next frame to start, no-op without a cap
+	void WaitForNextFrame();
+
+	double FixedStep() const { return options.fixedStep; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	FrameLoopOptions options;
+	Clock::time_point frameStart{};
+	Clock::time_point nextFrame{};
+	double accumulator{ 0.0 };
+	bool started{ false };
+#if defined(_WIN32)
+	bool timerPeriodRaised{ false };
+#endif
+};
@@ -0,0 +1,79 @@
+/*
+* Defines the frame statistics classes used by the headless benchmark harness. FrameStats collects
+* per-frame CPU and GPU timings and writes them to CSV or JSON, GpuTimer measures GPU time with queries
+*
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+// one row of the benchmark output
+struct FrameSample {
+	uint32_t frame{ 0 };
+	double cpuMs{ 0.0 };
+	double gpuMs{ -1.0 }; // stays negative until the GPU query result is available
+	uint32_t glCalls{ 0 }; // state changes that reached the driver
+	uint32_t glCallsElided{ 0 }; // redundant state changes dropped by the GL state cache
+	uint32_t drawCalls{ 0 };
+	uint32_t objectsVisible{ 0 }; // objects that passed frustum culling
+	uint32_t objectsCulled{ 0 };
+	double cullMs{ 0.0 };
+	double frameMs{ -1.0 }; // time since the previous frame started, including vsync and frame cap waits, negative when unknown
+	double inputLatencyMs{ -1.0 }; // oldest input event of the frame to the GPU finishing it, negative for frames without input
+};
+
+class FrameStats {
+public:
+	void Record(uint32_t frame, double cpuMs, uint32_t glCalls = 0, uint32_t glCallsElided = 0, uint32_t drawCalls = 0);
+	void SetGpuTime(uint32_t frame, double gpuMs);
+	void SetCulling(uint32_t frame, uint32_t visible, uint32_t culled, double cullMs);
+	void SetFrameTime(uint32_t frame, double frameMs);
+	void SetInputLatency(uint32_t frame, double latencyMs);
+
+	// percentile from 0 to 100 of one timing column, samples without a value are skipped
+	double Percentile(double FrameSample::* field, double percent) const;
+
+	// writes JSON when the path ends in .json, CSV otherwise
+	bool Write(const std::string& path) const;
+	void PrintSummary() const;
+
+	const std::vector<FrameSample>& Samples() const { return samples; }
+
+private:
+	bool writeCsv(const std::string& path) const;
+	bool writeJson(const std::string& path) const;
+
+private:
+	std::vector<FrameSample> samples;
+};
+
+// Measures GPU time with GL_TIME_ELAPSED queries. A small ring of queries is used so reading
+// results never stalls the pipeline waiting on the frame that was just submitted
+class GpuTimer {
+public:
+	void Init(FrameStats& frameStats);
+	void Destroy();
+
+	void Begin(uint32_t frame);
+	void End();
+
+	// hands finished results to the stats, blocking on outstanding queries when wait is true
+	void Collect(bool wait = false);
+
+private:
+	void read(size_t slot);
+
+	static constexpr size_t QueryCount = 4;
+
+	FrameStats* stats{ nullptr };
+
+	std::array<GLuint, QueryCount> queries{};
+	std::array<uint32_t, QueryCount> queryFrames{};
+	std::array<bool, QueryCount> pending{};
+	size_t current{ 0 };
+};
@@ -0,0 +1,60 @@
+/*
+* Defines view frustum culling. The frustum planes are pulled out of the projection * view matrix and tested
+* against world space bounding spheres kept in structure of arrays form, four or eight at a time with SSE or AVX
+*
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <bounds.h>
+
+// planes point inward, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all six
+struct Frustum {
+	std::array<glm::vec4, 6> planes{}; // left, right, bottom, top, near, far
+
+	static Frustum FromMatrix(const glm::mat4& projectionView);
+	bool Intersects(const BoundingSphere& sphere) const;
+};
+
+enum class CullMode {
+	Scalar,
+	Simd // AVX when the build enables it, SSE otherwise, scalar on other targets
+};
+
+struct CullStats {
+	uint32_t tested{ 0 };
+	uint32_t visible{ 0 };
+	uint32_t culled{ 0 };
+	double ms{ 0.0 };
+};
+
+class FrustumCuller {
+public:
+	void Clear();
+	void Reserve(size_t sphereCount);
+
+	// returns the index reported back by Cull
+	uint32_t Add(const BoundingSphere& worldSphere);
+	void Set(uint32_t index, const BoundingSphere& worldSphere);
+	size_t Size() const { return count; }
+
+	// fills visible with the indices of every sphere touching the frustum, in ascending order
+	CullStats Cull(const Frustum& frustum, std::vector<uint32_t>& visible, CullMode mode = CullMode::Simd) const;
+
+	// name of the instruction set CullMode::Simd uses in this build
+	static const char* SimdName();
+
+private:
+	void cullScalar(const Frustum& frustum, size_t begin, std::vector<uint32_t>& visible) const;
+
+	// padded to a multiple of 8 so the wide loops never read past the end
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+	size_t count{ 0 };
+};
@@ -0,0 +1,120 @@
+/*
+* Defines the geometry arena. Every mesh added to it is suballocated out of one large vertex buffer and one
+* large index buffer that share a single VAO, so a whole bucket of objects is drawn with one
+* glMultiDrawElementsIndirect call instead of a VAO switch and draw call per object
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <instance_buffer.h>
+#include <objects.h>
+#include <vertex_layout.h>
+
+// matches the command layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+	uint32_t count{ 0 };
+	uint32_t instanceCount{ 0 };
+	uint32_t firstIndex{ 0 };
+	int32_t baseVertex{ 0 };
+	uint32_t baseInstance{ 0 };
+};
+
+// ranges a mesh occupies in the arena, counted in vertices and indices
+struct ArenaMesh {
+	uint32_t vertexOffset{ 0 };
+	uint32_t vertexCount{ 0 };
+	uint32_t indexOffset{ 0 };
+	uint32_t indexCount{ 0 };
+
+	bool Valid() const { return indexCount > 0; }
+};
+
+struct ArenaStats {
+	uint32_t vertexCapacity{ 0 };
+	uint32_t vertexUsed{ 0 };
+	uint32_t indexCapacity{ 0 };
+	uint32_t indexUsed{ 0 };
+	uint32_t freeBlocks{ 0 }; // vertex and index free blocks together
+	float vertexFragmentation{ 0.0f }; // 1 - largest free block / total free space, 0 when the free space is one block
+	float indexFragmentation{ 0.0f };
+};
+
+// first fit allocator over a range of elements, neighbouring free blocks are merged when released
+class ArenaAllocator {
+public:
+	void Reset(uint32_t capacity);
+
+	// returns false when no free block is large enough
+	bool Allocate(uint32_t count, uint32_t& offset);
+	void Release(uint32_t offset, uint32_t count);
+
+	uint32_t Capacity() const { return capacity; }
+	uint32_t Used() const { return used; }
+	uint32_t FreeBlockCount() const { return static_cast<uint32_t>(freeBlocks.size()); }
+	float Fragmentation() const;
+
+private:
+	struct Block {
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	std::vector<Block> freeBlocks; // sorted by offset
+	uint32_t capacity{ 0 };
+	uint32_t used{ 0 };
+};
+
+class GeometryArena {
+public:
+	// every mesh is packed into the same format, which cannot use per-mesh position dequantization
+	static constexpr VertexFormat Format{ PositionFormat::Float3, NormalFormat::Oct16, UvFormat::Half2 };
+
+	// multi-draw indirect needs OpenGL 4.3
+	static bool IsSupported();
+
+	void Create(uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t instanceCapacity = 1024);
+	void Destroy();
+
+	// returns an invalid mesh when the arena is full. Already packed vertices must be in Format
+	ArenaMesh Add(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+	ArenaMesh Add(const PackedVertexView& vertices, std::span<const uint32_t> indices);
+	void Remove(const ArenaMesh& mesh);
+
+	// Draws are recorded into numbered buckets, one per program and texture combination. Upload sends the
+	// instances and commands of every bucket at once, then Submit draws a bucket with a single call
+	void BeginFrame();
+	void Record(uint32_t bucket, const ArenaMesh& mesh, const glm::mat4& model, uint32_t material = 0);
+	void Upload();
+	void Submit(uint32_t bucket);
+
+	bool HasOctNormals() const { return Format.normal == NormalFormat::Oct16; }
+	ArenaStats Stats() const;
+	void PrintReport() const;
+
+private:
+	struct Bucket {
+		std::vector<DrawElementsIndirectCommand> commands;
+		size_t firstCommand{ 0 }; // position in the indirect buffer after Upload
+	};
+
+	VertexLayout layout;
+	ArenaAllocator vertexSpace;
+	ArenaAllocator indexSpace;
+
+	GLuint VAO{ 0 };
+	GLuint vertexBuffer{ 0 };
+	GLuint indexBuffer{ 0 };
+	GLuint indirectBuffer{ 0 };
+	size_t indirectCapacity{ 0 }; // in commands
+	InstanceBuffer instanceBuffer; // read through baseInstance, so each command finds its own transform
+
+	std::vector<Bucket> buckets;
+	std::vector<InstanceData> instances; // this frame's, indexed by baseInstance
+	std::vector<DrawElementsIndirectCommand> commandStaging;
+};
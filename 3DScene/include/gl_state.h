@@ -0,0 +1,45 @@
+/*
+* Declares the GL state cache. All program, vertex array, buffer, texture and capability changes go through
+* here so calls that would not change anything are dropped before they reach the driver
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <glad/glad.h>
+
+namespace GLState {
+	// number of GL calls that reached the driver and that were dropped as redundant since the last reset
+	struct Counters {
+		uint32_t issued{ 0 };
+		uint32_t elided{ 0 };
+		uint32_t draws{ 0 }; // draw calls, a multi-draw counts once
+	};
+
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vao);
+	void BindBuffer(GLenum target, GLuint buffer);
+	void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	void BindTexture(GLuint unit, GLenum target, GLuint texture);
+	void BindSampler(GLuint unit, GLuint sampler);
+
+	void SetDepthTest(bool enabled);
+	void SetBlend(bool enabled);
+
+	// forgets every cached binding, needed after a new context is made current or after raw GL calls
+	void Invalidate();
+
+	// an object being deleted may still be cached as bound, so forget it before its name gets reused
+	void ForgetProgram(GLuint program);
+	void ForgetVertexArray(GLuint vao);
+	void ForgetBuffer(GLuint buffer);
+	void ForgetTexture(GLuint texture);
+	void ForgetSampler(GLuint sampler);
+
+	// draws are not cached, they are only counted for the frame stats
+	void CountDraw();
+
+	Counters FrameCounters();
+	void ResetFrameCounters();
+}
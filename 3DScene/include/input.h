@@ -0,0 +1,75 @@
+/*
+* Defines the input subsystem. GLFW callbacks only queue timestamped events, the app polls before
+* simulating and drains the queue right before drawing so camera look uses the newest mouse motion.
+* InputLatency puts a fence after each frame that consumed input to measure input to frame completion
+*
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+class FrameStats;
+
+using InputClock = std::chrono::steady_clock;
+
+struct InputEvent {
+	enum class Type {
+		MouseMove, // x and y are the cursor offset since the previous move, y points up
+		Scroll, // x and y are the wheel offsets
+		MouseButton,
+		Key
+	};
+
+	Type type{ Type::MouseMove };
+	double x{ 0.0 };
+	double y{ 0.0 };
+	int code{ 0 }; // key or mouse button
+	int action{ 0 }; // GLFW_PRESS, GLFW_RELEASE, or GLFW_REPEAT
+	InputClock::time_point time{};
+};
+
+class Input {
+public:
+	// queues an event stamped with the current time, called from the window callbacks and by scripted runs
+	void Push(InputEvent event);
+	void PushCursor(double x, double y); // absolute cursor position, turned into an offset from the last one
+
+	// dispatches pending window events into the queue and samples the keyboard
+	void Poll(GLFWwindow* window);
+
+	// state of a key as of the last poll, keys are sampled rather than queued because movement holds them down
+	bool KeyDown(int key) const;
+
+	// moves the queued events into events, returns the time of the oldest one
+	InputClock::time_point Drain(std::vector<InputEvent>& events);
+
+private:
+	std::vector<InputEvent> queue;
+	GLFWwindow* polledWindow{ nullptr };
+	double lastX{ 0.0 };
+	double lastY{ 0.0 };
+	bool firstMouse{ true };
+};
+
+// Measures the time from an input event to the GPU finishing the first frame that used it. Fences are
+// checked without blocking, so the completion time is only as precise as how often Collect runs
+class InputLatency {
+public:
+	void Submit(uint32_t frame, InputClock::time_point oldestInput); // after the last GL command of the frame
+	void Collect(FrameStats& stats, bool wait = false);
+	void Destroy();
+
+private:
+	struct Pending {
+		GLsync fence;
+		uint32_t frame;
+		InputClock::time_point input;
+	};
+
+	std::vector<Pending> pending;
+};
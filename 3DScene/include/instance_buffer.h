@@ -0,0 +1,35 @@
+/*
+* Defines the per-instance data and the buffer that holds it for instanced draws. Instances of one mesh are
+* written as a contiguous array and read by shader_instanced.vert through divisor 1 vertex attributes
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// one instance, locations 4 to 7 hold the model matrix columns and location 8 the material index
+struct InstanceData {
+	glm::mat4 model{ 1.f };
+	uint32_t material{ 0 };
+	uint32_t padding[3]{}; // keeps the stride a multiple of 16 bytes
+};
+
+class InstanceBuffer {
+public:
+	void Create(uint32_t instanceCapacity);
+	void Destroy();
+
+	// replaces the contents starting at the first instance, the buffer grows when needed
+	void Update(std::span<const InstanceData> instances, uint32_t firstInstance = 0);
+
+	GLuint Buffer() const { return buffer; }
+	uint32_t Capacity() const { return capacity; }
+
+private:
+	GLuint buffer{ 0 };
+	uint32_t capacity{ 0 };
+};
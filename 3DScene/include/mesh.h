@@ -4,24 +4,56 @@ Defines the mesh class that is responsible for representing the 3D cylinder/sphe
 */
 
 #pragma once
+#include <span>
 #include <vector>
 #include <objects.h> // including the object vertices
+#include <vertex_layout.h>
+#include <instance_buffer.h>
 #include <glad\glad.h>
 
 class Mesh {
 
 	// Initializes the mesh 3D cylinder/sphere with vertices and indices, renders the mesh, and a matrix for translation, rotation, and scale
 public:
-	Mesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	// packs the vertices into the given format, the data can point into a memory mapped baked mesh.
+	// The data is uploaded as given, welding and vertex cache ordering are done beforehand with MeshOptimizer
+	Mesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices, VertexFormat format = VertexFormats::Compact);
+	Mesh(const PackedVertices& vertices, std::span<const uint32_t> indices);
+	Mesh(const PackedVertexView& vertices, std::span<const uint32_t> indices); // no copy, e.g. a baked mesh's packed stream
 
 	void Draw();
 
+	// draws count instances read from the buffer starting at firstInstance, use with shader_instanced.vert
+	void DrawInstanced(const InstanceBuffer& instances, uint32_t count, uint32_t firstInstance = 0);
+	void Destroy(); // meshes are copied around by value, so GL objects are released explicitly
+
 	glm::mat4 Transform{ 1.f };
 
+	// expands quantized positions back to object space, applied before the model matrix but not to normals
+	glm::mat4 Dequantize() const;
+	bool HasOctNormals() const { return layout.format.normal == NormalFormat::Oct16; }
+	uint32_t VertexStride() const { return layout.stride; }
+	uint32_t VertexCount() const { return vertexCount; }
+	uint32_t IndexSize() const { return indexType == GL_UNSIGNED_SHORT ? 2 : 4; } // bytes per index in the element buffer
+
+	// object space bounds, computed when the mesh is built
+	const MeshBounds& Bounds() const { return bounds; }
+	const BoundingSphere& Sphere() const { return sphere; }
+
 	// members elementCount count the vertices and indices, buffer and shader objects
 private:
+	void upload(const PackedVertexView& vertices, std::span<const uint32_t> indices);
+
 
 	uint32_t elementCount{ 0 };
+	uint32_t vertexCount{ 0 };
+	GLenum indexType{ GL_UNSIGNED_INT }; // 16 bit when every vertex can be addressed with it
+	VertexLayout layout;
+	glm::vec3 dequantScale{ 1.0f };
+	glm::vec3 dequantOffset{ 0.0f };
+	MeshBounds bounds;
+	BoundingSphere sphere;
+	GLuint instanceSource{ 0 }; // instance buffer the VAO's per-instance attributes currently point at
 	GLuint VBO{};
 	GLuint shaderProgram{};
 	GLuint VAO{};
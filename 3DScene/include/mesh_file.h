@@ -0,0 +1,132 @@
+/*
+* Defines the baked mesh file format and the classes that read and write it. A baked mesh is a header followed by
+* aligned vertex, index, and submesh sections, so a memory mapped file can be handed straight to glBufferData
+*
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <bounds.h>
+#include <mesh_lod.h>
+#include <objects.h>
+#include <vertex_layout.h>
+
+// range of indices drawn with one material
+struct Submesh {
+	uint32_t indexOffset{ 0 };
+	uint32_t indexCount{ 0 };
+	MeshBounds bounds;
+};
+
+constexpr size_t MeshFileMaxStreams = 2;
+
+// the vertices packed for the GPU in one format, uploaded from the mapping without repacking
+struct MeshFileStream {
+	uint8_t position{ 0 }; // PositionFormat
+	uint8_t normal{ 0 }; // NormalFormat
+	uint8_t uv{ 0 }; // UvFormat
+	uint8_t reserved{ 0 };
+	uint32_t stride{ 0 };
+	uint64_t offset{ 0 };
+	glm::vec3 dequantScale{ 1.0f };
+	glm::vec3 dequantOffset{ 0.0f };
+	MeshBounds bounds;
+	BoundingSphere sphere;
+};
+
+// sits at offset 0, section offsets are from the start of the file and aligned to MeshFileAlignment.
+// The authored vertices are kept next to the packed streams for the ray scene and the LOD builder
+struct MeshFileHeader {
+	uint32_t magic{ 0 };
+	uint32_t version{ 0 };
+	uint32_t vertexStride{ 0 }; // must match sizeof(Vertex), files from an older layout are rejected
+	uint32_t vertexCount{ 0 };
+	uint32_t indexCount{ 0 };
+	uint32_t submeshCount{ 0 };
+	uint64_t vertexOffset{ 0 };
+	uint64_t indexOffset{ 0 };
+	uint64_t submeshOffset{ 0 };
+	uint64_t sourceHash{ 0 }; // hash of the mesh the file was baked from, a bake of an older source is skipped
+	MeshBounds bounds;
+	uint32_t streamCount{ 0 };
+	uint32_t reserved{ 0 };
+	MeshFileStream streams[MeshFileMaxStreams];
+};
+
+constexpr uint32_t MeshFileMagic = 0x4853454D; // "MESH"
+constexpr uint32_t MeshFileVersion = 3; // raised whenever the layout or the processing done while baking changes
+constexpr size_t MeshFileAlignment = 64;
+
+// read only view of a whole file, backed by CreateFileMapping on Windows and mmap elsewhere
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	const uint8_t* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	const uint8_t* data{ nullptr };
+	size_t size{ 0 };
+#ifdef _WIN32
+	void* file{ nullptr };
+	void* mapping{ nullptr };
+#endif
+};
+
+// Baked mesh opened through a file mapping. The spans point into the mapping and stay valid until Close
+class MeshFile {
+public:
+	// checks that every section, index, and submesh stays inside the file. When sourceHash is not zero the file
+	// must also have been baked from that source, so stale bakes are rejected instead of drawn
+	bool Open(const std::filesystem::path& path, uint64_t sourceHash = 0);
+	void Close();
+
+	const MeshFileHeader& Header() const { return header; }
+	std::span<const Vertex> Vertices() const { return vertices; }
+	std::span<const uint32_t> Indices() const { return indices; }
+	std::span<const Submesh> Submeshes() const { return submeshes; }
+
+	// the vertices as baked in format, false when the file has no stream in that format
+	bool PackedStream(const VertexFormat& format, PackedVertexView& view) const;
+
+	// bakes a mesh, a single submesh covering every index is written when none are given. The vertices are also
+	// packed into each of packedFormats, up to MeshFileMaxStreams, so loading needs no packing
+	static bool Write(const std::filesystem::path& path, std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+		std::span<const Submesh> submeshes = {}, uint64_t sourceHash = 0, std::span<const VertexFormat> packedFormats = {});
+
+	// FNV-1a over the unprocessed vertices, indices, and submesh ranges, stored in the header to spot stale bakes
+	static uint64_t SourceHash(std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::span<const Submesh> submeshes);
+
+	static MeshBounds ComputeBounds(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+
+private:
+	MappedFile file;
+	MeshFileHeader header;
+	std::span<const Vertex> vertices;
+	std::span<const uint32_t> indices;
+	std::span<const Submesh> submeshes;
+};
+
+// in-memory mesh and the file name it is baked under
+struct MeshSource {
+	std::string name;
+	std::span<const Vertex> vertices;
+	std::span<const uint32_t> indices;
+	std::vector<Submesh> submeshes; // empty means one submesh for the whole mesh
+	std::function<std::vector<LodLevel>()> coarserLevels; // parametric shapes regenerate their levels, other meshes are simplified
+};
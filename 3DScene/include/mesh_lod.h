@@ -0,0 +1,50 @@
+/*
+* Defines the level of detail chains drawn in place of a mesh when it covers few pixels. Parametric shapes
+* are regenerated with fewer segments, any other mesh is simplified by quadric error edge collapse.
+* Every level stores its geometric error in object space, which the renderer projects to pixels to pick a level
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include <objects.h>
+
+// one coarser level of a mesh, the authored mesh itself is level 0 with an error of 0
+struct LodLevel {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	float error{ 0.0f }; // largest distance from the authored surface, in object space units
+};
+
+namespace MeshLod {
+	// screen space error in pixels below which a coarser level is used
+	constexpr float PixelThreshold = 1.0f;
+
+	// a coarser level is only taken once its error is this fraction of the threshold, so an object sitting
+	// right at a switching distance does not flip between two levels every frame
+	constexpr float Hysteresis = 0.75f;
+
+	// Removes edges by collapsing one end onto the other, cheapest quadric error first, until at most
+	// targetIndexCount indices are left or nothing more can go. Vertices on open borders and on attribute
+	// seams stay where they are so the silhouette and texture mapping hold. Returns the remaining triangles
+	// and sets error to the largest distance from a removed vertex to the simplified surface
+	std::vector<uint32_t> Simplify(std::span<const Vertex> vertices, std::span<const uint32_t> indices, size_t targetIndexCount, float& error);
+
+	// up to maxLevels simplified levels after the mesh itself, each with about ratio times the triangles of the one
+	// before. The chain stops early when a level would barely be smaller
+	std::vector<LodLevel> BuildChain(std::span<const Vertex> vertices, std::span<const uint32_t> indices, uint32_t maxLevels = 4, float ratio = 0.5f);
+
+	// coarser levels of the cylinder and sphere, regenerated with half the segments per level down to 4
+	std::vector<LodLevel> SphereCylinderChain(float cylinderRadius, float cylinderHeight, float sphereRadius, int segments, uint32_t maxLevels = 4);
+
+	// how many pixels one object space unit covers at the nearest point of a bounding sphere,
+	// from the projection's vertical scale so it follows the field of view and orthographic mode
+	float PixelsPerUnit(const glm::mat4& projection, float viewportHeight, float distance);
+
+	// coarsest level whose projected error stays under the threshold, moving away from current only past the hysteresis band
+	uint32_t SelectLevel(std::span<const float> errors, float pixelsPerUnit, uint32_t current);
+}
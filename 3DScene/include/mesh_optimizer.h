@@ -0,0 +1,48 @@
+/*
+* Defines the mesh optimization pass run before a mesh is uploaded. Triangles are reordered so the post
+* transform vertex cache hits more often (Forsyth's scoring), optionally regrouped into clusters that face
+* outward first to cut overdraw, and vertices are reordered into first use order for fetch locality.
+* Welding runs before all of them and merges duplicate vertices so fewer have to be stored and transformed
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <objects.h>
+
+namespace MeshOptimizer {
+	// FIFO cache size of the simulated GPU used to report ACMR and ATVR
+	constexpr uint32_t ReportCacheSize = 16;
+
+	struct CacheStats {
+		float acmr{ 0.0f }; // vertices transformed per triangle, 0.5 is the best a regular grid can do and 3 the worst
+		float atvr{ 0.0f }; // vertices transformed per vertex used, 1 means every vertex is transformed once
+	};
+
+	// Merges vertices whose position, color, normal, and uv all match within tolerance and rewrites the indices.
+	// Seams and poles whose copies differ in uv or normal are kept apart. Returns the number of vertices removed
+	size_t WeldVertices(std::vector<Vertex>& vertices, std::span<uint32_t> indices, float tolerance = 1.0e-6f);
+
+	CacheStats AnalyzeVertexCache(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = ReportCacheSize);
+
+	// reorders the triangles of indices in place for the post transform cache
+	void OptimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount);
+
+	// Splits cache ordered triangles into clusters where the cache order restarts and draws the clusters that face
+	// away from the mesh center first, so they tend to occlude the rest. Keeps the new order only while ACMR stays
+	// within threshold times the cache ordered ACMR
+	void OptimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold = 1.05f);
+
+	// reorders vertices into the order the indices first use them and rewrites the indices, unused vertices go last
+	void OptimizeVertexFetch(std::span<Vertex> vertices, std::span<uint32_t> indices);
+
+	// all three passes, the triangles of each range of submeshes stay inside it
+	struct IndexRange {
+		uint32_t offset;
+		uint32_t count;
+	};
+	void Optimize(std::span<Vertex> vertices, std::span<uint32_t> indices, std::span<const IndexRange> ranges = {});
+}
@@ -0,0 +1,84 @@
+/*
+* Defines the CPU path tracer used as a reference renderer. It traces the same meshes, textures, and key light
+* as the GL renderer through the ray scene, splitting the image into tiles that the thread pool works through.
+* Every pixel seeds its own random sequence, so the image is the same for any number of threads
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <ray_scene.h>
+#include <texture.h>
+#include <thread_pool.h>
+
+struct PathTraceOptions {
+	uint32_t width{ 800 };
+	uint32_t height{ 600 };
+	uint32_t samples{ 16 }; // per pixel
+	uint32_t maxBounces{ 3 }; // indirect bounces after the first hit
+	uint32_t tileSize{ 32 };
+	std::string outputPath{ "pathtrace.png" };
+};
+
+struct PathTraceStats {
+	double ms{ 0.0 };
+	uint64_t samples{ 0 }; // camera paths traced
+	size_t threads{ 0 }; // workers plus the calling thread
+	double SamplesPerSecond() const { return ms > 0.0 ? samples / (ms / 1000.0) : 0.0; }
+};
+
+// matches the pinhole camera of the GL renderer
+struct PathTraceCamera {
+	glm::vec3 position{ 0.0f };
+	glm::vec3 front{ 0.0f, 0.0f, -1.0f };
+	glm::vec3 up{ 0.0f, 1.0f, 0.0f };
+	float fovY{ 75.0f }; // degrees
+};
+
+// the key light and the terms shader.frag lights with, the ambient term becomes a uniform sky
+struct PathTraceLighting {
+	glm::vec3 keyLightDir{ 0.0f, 1.0f, 0.0f }; // toward the light
+	glm::vec3 keyLightColor{ 1.0f };
+	float ambientStrength{ 0.4f };
+	float specularStrength{ 0.5f };
+	float shininess{ 32.0f };
+	glm::vec3 background{ 0.0f }; // seen by camera rays that miss everything
+};
+
+class PathTracer {
+public:
+	// vertex data must outlive the tracer
+	uint32_t AddMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+	uint32_t AddTexture(Image image);
+	uint32_t AddObject(uint32_t mesh, const glm::mat4& world, uint32_t texture);
+
+	void SetCamera(const PathTraceCamera& camera) { this->camera = camera; }
+	void SetLighting(const PathTraceLighting& lighting) { this->lighting = lighting; }
+
+	PathTraceStats Render(ThreadPool& pool, const PathTraceOptions& options, Image& output);
+
+private:
+	struct MeshData {
+		std::span<const Vertex> vertices;
+		std::span<const uint32_t> indices;
+	};
+
+	struct ObjectData {
+		uint32_t texture;
+		glm::mat3 normalMatrix;
+	};
+
+	glm::vec3 trace(Ray ray, uint32_t maxBounces, uint32_t& state) const;
+
+	RayScene scene;
+	std::vector<MeshData> meshes; // parallel to the ray scene's meshes
+	std::vector<ObjectData> objects; // parallel to the ray scene's objects
+	std::vector<Image> textures;
+	PathTraceCamera camera;
+	PathTraceLighting lighting;
+};
@@ -0,0 +1,38 @@
+/*
+* Defines the pixel buffer ring used to stream texture data to the GPU. The buffer is split into segments that
+* are written by the CPU while the GPU copies out of the others, with a fence guarding each segment
+*
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+
+class PixelBufferRing {
+public:
+	void Create(size_t segmentBytes, uint32_t segmentCount = 3);
+	void Destroy();
+
+	// waits until the next segment is free and returns where to write it, the segment is bound to GL_PIXEL_UNPACK_BUFFER
+	uint8_t* Map(GLintptr& offset);
+
+	// must be called after writing and before the glTexSubImage2D that reads the segment
+	void Unmap();
+
+	// marks the segment as in use by the upload commands issued since Unmap
+	void Fence();
+
+	size_t SegmentSize() const { return segmentSize; }
+	bool IsPersistent() const { return persistent; }
+
+private:
+	GLuint buffer{ 0 };
+	size_t segmentSize{ 0 };
+	uint32_t current{ 0 };
+	bool persistent{ false }; // GL 4.4 buffer storage keeps the whole ring mapped for its lifetime
+	uint8_t* persistentPointer{ nullptr };
+	std::vector<GLsync> fences;
+};
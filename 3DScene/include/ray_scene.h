@@ -0,0 +1,57 @@
+/*
+* Defines the ray query scene shared by picking, camera collision, and the path tracer. Meshes keep a
+* triangle BVH in their own space, objects place a mesh in the world, and an object BVH over the world
+* boxes finds the objects a ray needs to visit
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include <bvh.h>
+#include <triangle_bvh.h>
+
+struct SceneHit {
+	uint32_t object{ ~0u };
+	RayHit hit; // distance along the world ray, triangle and barycentrics in the object's mesh
+};
+
+class RayScene {
+public:
+	uint32_t AddMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+	uint32_t AddObject(uint32_t mesh, const glm::mat4& world);
+	void SetTransform(uint32_t object, const glm::mat4& world);
+
+	// builds the object BVH the first time and refits it after objects move
+	void Update();
+
+	// closest triangle of any object within ray.tMax
+	bool Intersect(const Ray& ray, SceneHit& hit) const;
+
+	// true as soon as any triangle is found within ray.tMax
+	bool Occluded(const Ray& ray) const;
+
+	const Bvh& ObjectBvh() const { return objectBvh; }
+	size_t ObjectCount() const { return objects.size(); }
+	uint32_t ObjectMesh(uint32_t object) const { return objects[object].mesh; }
+	const glm::mat4& ObjectTransform(uint32_t object) const { return objects[object].world; }
+
+private:
+	struct Object {
+		uint32_t mesh;
+		glm::mat4 world;
+		glm::mat4 inverse;
+	};
+
+	template <bool AnyHit>
+	bool traverse(const Ray& ray, SceneHit& hit) const;
+
+	std::vector<TriangleBvh> meshes;
+	std::vector<Object> objects;
+	std::vector<MeshBounds> objectBounds; // world space, parallel to objects
+	Bvh objectBvh;
+	bool rebuild{ true };
+};
@@ -0,0 +1,43 @@
+/*
+* Defines the scene graph. Nodes are stored as parallel arrays of local matrices, world matrices, parent indices,
+* and dirty flags, always ordered so a parent comes before its children. World matrices are brought up to date with
+* a single front to back pass that only touches nodes whose local matrix or an ancestor's changed
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+using NodeId = uint32_t;
+constexpr NodeId NoParent = ~0u;
+
+class SceneGraph {
+public:
+	// nodes are appended after their parent, which keeps the parent before child order without sorting
+	NodeId AddNode(const glm::mat4& local, NodeId parent = NoParent);
+	void Reserve(size_t nodeCount);
+	void Clear();
+
+	// marks the node dirty, its subtree is recomputed by the next Update
+	void SetLocal(NodeId node, const glm::mat4& local);
+
+	const glm::mat4& Local(NodeId node) const { return locals[node]; }
+	const glm::mat4& World(NodeId node) const { return worlds[node]; }
+	NodeId Parent(NodeId node) const { return parents[node]; }
+	size_t Size() const { return parents.size(); }
+
+	// recomputes the world matrices of dirty subtrees and returns how many were recomputed
+	uint32_t Update();
+
+	// recomputes every world matrix, used as the baseline by the benchmark
+	void UpdateAll();
+
+private:
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<NodeId> parents;
+	std::vector<uint8_t> dirty; // bytes rather than vector<bool> so the pass reads them without bit twiddling
+};
@@ -6,11 +6,19 @@
 
 #include <filesystem>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <glad/glad.h>
 #include <glm/glm.hpp> 
 
 using Path = std::filesystem::path;
 
+// hash that lets the uniform table be searched with a string_view without building a std::string
+struct UniformNameHash {
+	using is_transparent = void;
+	size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+};
+
 class Shader {
 	// Creates shader, binding, and sets shader uniforms
 public:
@@ -18,17 +26,29 @@ public:
 	Shader(const std::string& vertexSource, const std::string& fragmentSource);
 	Shader(const Path& vertexPath, const Path& fragmentPath);
 
-	void SetVec3(const std::string& name, const glm::vec3& value);
+	void SetVec3(std::string_view name, const glm::vec3& value);
 	void Bind();
 
-	void SetMat4(const std::string& uniformName, const glm::mat4& mat4);
+	void SetMat4(std::string_view uniformName, const glm::mat4& mat4);
+
+	// pre-resolved uniform locations skip the table lookup, -1 is ignored like glUniform does
+	GLint UniformLocation(std::string_view uniformName) const;
+	void SetVec3(GLint location, const glm::vec3& value);
+	void SetMat4(GLint location, const glm::mat4& mat4);
+
+	GLuint Program() const { return shaderProgram; }
 
 	//methods handle shaderl loading and get the unfirom location
 private:
 	void load(const std::string& vertexSource, const std::string& fragmentSource);
-	GLint getUniformLocation(const std::string& uniformName);
+	void cacheUniformLocations();
+	void bindUniformBlocks();
+	GLint getUniformLocation(std::string_view uniformName) const;
 
 private:
-	GLuint shaderProgram;
+	GLuint shaderProgram{ 0 };
+
+	// every active uniform of the linked program, filled once after linking
+	std::unordered_map<std::string, GLint, UniformNameHash, std::equal_to<>> uniformLocations;
 
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+/*
+* Declares the procedural shape generators behind Shapes in objects.h. Every generator has a count function
+* so callers can size their storage exactly, and writes into caller provided spans instead of growing vectors.
+* Sines and cosines come from per segment tables, and large tessellations split their rows across a thread pool.
+* Sphere, Cylinder, and SphereCylinder generate on first use and return the same mesh for the same parameters
+*
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Vertex;
+class ThreadPool;
+
+namespace ShapeGenerators {
+	// vertices and indices of a memoized shape, vector<Vertex> only needs Vertex to be complete where it is used
+	struct GeneratedMesh {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	struct ShapeCounts {
+		size_t vertices{ 0 };
+		size_t indices{ 0 };
+	};
+
+	// sin and cos of step * i for i in [0, segments], computed once per shape instead of once per vertex
+	struct SinCosTable {
+		SinCosTable(int segments, float step);
+
+		std::vector<float> sin;
+		std::vector<float> cos;
+	};
+
+	ShapeCounts SphereCounts(int segments);
+	ShapeCounts CylinderCounts(int segments);
+	ShapeCounts SphereCylinderCounts(int cylinderSegments, int sphereSegments);
+
+	// vertices must hold exactly SphereCounts(segments).vertices, offset moves every position.
+	// Rows are split across pool when one is given and the sphere is large enough to be worth it
+	void WriteSphereVertices(std::span<Vertex> vertices, float radius, int segments, glm::vec3 offset = glm::vec3(0.0f), ThreadPool* pool = nullptr);
+
+	// baseVertex is added to every index, for spheres appended to a larger vertex buffer
+	void WriteSphereIndices(std::span<uint32_t> indices, int segments, uint32_t baseVertex = 0, ThreadPool* pool = nullptr);
+
+	void WriteCylinderVertices(std::span<Vertex> vertices, float radius, float height, int segments);
+	void WriteCylinderIndices(std::span<uint32_t> indices, int segments, uint32_t baseVertex = 0);
+
+	// the cylinder with the sphere sitting on its top edge, cylinder first, sized by SphereCylinderCounts
+	void WriteSphereCylinder(std::span<Vertex> vertices, std::span<uint32_t> indices, float cylinderRadius, float cylinderHeight, int cylinderSegments,
+		float sphereRadius, int sphereSegments, ThreadPool* pool = nullptr);
+
+	// memoized shapes keyed by their parameters, safe to call from any thread. The meshes live until exit
+	const GeneratedMesh& Sphere(float radius, int segments);
+	const GeneratedMesh& Cylinder(float radius, float height, int segments);
+	const GeneratedMesh& SphereCylinder(float cylinderRadius, float cylinderHeight, int cylinderSegments, float sphereRadius, int sphereSegments);
+}
@@ -0,0 +1,113 @@
+/*
+* Defines the CPU rasterizer used for image tests on machines without a GPU. It runs the shader.vert transform and
+* the shader.frag Phong shading. Triangles are binned into screen tiles, and each tile is rasterized by one worker
+* with half-space edge functions eight pixels at a time. The depth buffer keeps the farthest depth of every
+* 8x8 block, so triangles behind everything already drawn in a block are skipped without touching its pixels
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <objects.h>
+#include <texture.h>
+#include <thread_pool.h>
+
+struct RasterOptions {
+	uint32_t width{ 1920 };
+	uint32_t height{ 1080 };
+	std::string outputPath{ "raster.png" };
+};
+
+// the FrameData block of the shaders plus the clear color
+struct RasterFrame {
+	glm::mat4 projection{ 1.0f };
+	glm::mat4 view{ 1.0f };
+	glm::vec3 viewPos{ 0.0f };
+	glm::vec3 keyLightDir{ 0.0f, 1.0f, 0.0f }; // toward the light
+	glm::vec3 keyLightColor{ 1.0f };
+	glm::vec3 clearColor{ 0.0f };
+};
+
+struct RasterStats {
+	double vertexMs{ 0.0 };
+	double binMs{ 0.0 };
+	double rasterMs{ 0.0 };
+	double totalMs{ 0.0 };
+	uint32_t triangles{ 0 }; // set up after near plane clipping
+	uint32_t binEntries{ 0 }; // triangle and tile pairs
+	uint64_t blocksTested{ 0 };
+	uint64_t blocksSkipped{ 0 }; // rejected by the block depth
+};
+
+class SoftRasterizer {
+public:
+	static constexpr uint32_t TileSize = 64;
+	static constexpr uint32_t BlockSize = 8; // pixels per side of a hierarchical depth block, one SIMD row
+
+	// vertex data must outlive the rasterizer
+	uint32_t AddMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+	uint32_t AddTexture(const Image& image); // builds the mip chain that the per pixel level of detail picks from
+	uint32_t AddObject(uint32_t mesh, const glm::mat4& world, uint32_t texture);
+	void SetTransform(uint32_t object, const glm::mat4& world);
+
+	RasterStats Render(ThreadPool& pool, const RasterFrame& frame, uint32_t width, uint32_t height, Image& output);
+
+	// instruction set of the edge function loop in this build
+	static const char* SimdName();
+
+private:
+	struct MeshData {
+		std::span<const Vertex> vertices;
+		std::span<const uint32_t> indices;
+	};
+
+	struct ObjectData {
+		uint32_t mesh;
+		uint32_t texture;
+		glm::mat4 world;
+	};
+
+	// output of the vertex stage
+	struct ClipVertex {
+		glm::vec4 clip;
+		glm::vec3 world;
+		glm::vec3 normal;
+		glm::vec2 uv;
+	};
+
+	// a clipped triangle in pixel coordinates, attributes are divided by w for perspective correct interpolation
+	struct Triangle {
+		glm::vec2 screen[3];
+		float depth[3];
+		float inverseW[3];
+		glm::vec3 worldOverW[3];
+		glm::vec3 normalOverW[3];
+		glm::vec2 uvOverW[3];
+		float area; // twice the signed area, negative for triangles seen from the back
+		float minDepth;
+		int minX, minY, maxX, maxY; // inclusive pixel bounds, already clamped to the screen
+		uint32_t texture;
+	};
+
+	void setupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, uint32_t texture, uint32_t width, uint32_t height);
+	void rasterizeTile(uint32_t tileX, uint32_t tileY, const RasterFrame& frame, uint32_t width, uint32_t height, Image& output,
+		uint64_t& blocksTested, uint64_t& blocksSkipped);
+	// w are the corner weights at the pixel, dx and dy how they change one pixel to the right and down
+	void shade(const Triangle& triangle, const glm::vec3& w, const glm::vec3& dx, const glm::vec3& dy, const RasterFrame& frame, uint8_t* pixel) const;
+
+	std::vector<MeshData> meshes;
+	std::vector<ObjectData> objects;
+	std::vector<MipChain> textures;
+
+	// per frame
+	std::vector<ClipVertex> clipVertices;
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<uint32_t>> bins; // triangle indices per tile in submission order
+	uint32_t tilesX{ 0 };
+	uint32_t tilesY{ 0 };
+};
@@ -0,0 +1,59 @@
+/*
+* Declares the texture helpers that load images, build mip chains on the CPU, and create GL textures and samplers
+* with their full mip chain allocated
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// 8-bit RGBA pixels in CPU memory, rows top to bottom
+struct Image {
+	int width{ 0 };
+	int height{ 0 };
+	std::vector<uint8_t> pixels;
+};
+
+// every level of a texture, level 0 is the full size image
+struct MipChain {
+	std::vector<Image> levels;
+};
+
+namespace Texture {
+	// number of levels down to 1x1 for a texture of this size
+	int MipLevelCount(int width, int height);
+
+	bool LoadImage(const std::filesystem::path& path, Image& image);
+
+	// writes the image as a PNG with stb_image_write
+	bool SaveImage(const std::filesystem::path& path, const Image& image);
+
+	// magenta and black checker so missing textures are easy to spot
+	Image PlaceholderImage();
+
+	// bilinear lookup with repeat wrapping and no mips, for the CPU renderers. Row 0 is at v = 0 like the GL upload
+	glm::vec3 SampleBilinear(const Image& image, glm::vec2 uv);
+
+	// blends the bilinear lookups of the two levels around lod, like a GL_LINEAR_MIPMAP_LINEAR sampler
+	glm::vec3 SampleTrilinear(const MipChain& chain, glm::vec2 uv, float lod);
+
+	// Downsamples each level from the previous one with stb_image_resize2. The pixels are treated as sRGB,
+	// so filtering happens in linear space and mips do not darken
+	MipChain BuildMipChain(const Image& base);
+
+	// allocates every level and fills them with glGenerateMipmap
+	GLuint Create(const Image& image);
+
+	// allocates every level and uploads the precomputed levels one by one
+	GLuint Create(const MipChain& chain);
+
+	// trilinear filtering with the highest anisotropy the driver allows, up to maxAnisotropy
+	GLuint CreateSampler(float maxAnisotropy = 16.0f);
+
+	bool HasExtension(const char* name);
+}
@@ -0,0 +1,67 @@
+/*
+* Declares the block compression helpers. Mip chains are encoded to BC1 (opaque) or BC3 (with alpha) with the
+* vendored stb_dxt encoder, cached on disk, and uploaded with glCompressedTexSubImage2D
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include <glad/glad.h>
+#include <texture.h>
+#include <thread_pool.h>
+
+// S3TC formats come from GL_EXT_texture_compression_s3tc, which glad was generated without
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+enum class BlockFormat : uint32_t {
+	BC1 = 1, // 8 bytes per 4x4 block, 4 bits per pixel
+	BC3 = 3 // 16 bytes per 4x4 block, 8 bits per pixel
+};
+
+// one mip level, blocks stored row by row
+struct CompressedLevel {
+	int width{ 0 };
+	int height{ 0 };
+	std::vector<uint8_t> blocks;
+};
+
+struct CompressedTexture {
+	BlockFormat format{ BlockFormat::BC1 };
+	std::vector<CompressedLevel> levels;
+	float psnr{ 0.0f }; // quality of level 0 against the RGBA8 source, in dB
+	double encodeMs{ 0.0 };
+};
+
+namespace TextureCompression {
+	bool IsSupported(); // needs a current GL context
+
+	size_t BlockBytes(BlockFormat format);
+	GLenum GLFormat(BlockFormat format);
+
+	// BC3 when any pixel of level 0 is not fully opaque, BC1 otherwise
+	bool HasAlpha(const Image& image);
+
+	// Encodes every level, splitting the 4x4 blocks across the pool. The PSNR of level 0 is measured by decoding it again
+	CompressedTexture Compress(const MipChain& chain, ThreadPool& pool);
+
+	// decodes a level back to RGBA8, used for the quality report
+	Image Decompress(const CompressedLevel& level, BlockFormat format);
+
+	// The cache lives in <working dir>/cache. Entries are named by a hash of the canonical source path, size, and
+	// modification time, so textures with the same file name in different folders never share one
+	std::filesystem::path CachePath(const std::filesystem::path& source);
+	uint64_t SourceStamp(const std::filesystem::path& source);
+	// writes to a temporary file and renames it into place, so a reader never sees a half written entry
+	bool SaveCache(const std::filesystem::path& cachePath, const CompressedTexture& texture, uint64_t sourceStamp);
+	bool LoadCache(const std::filesystem::path& cachePath, CompressedTexture& texture, uint64_t sourceStamp);
+
+	GLuint Create(const CompressedTexture& texture);
+}
@@ -0,0 +1,121 @@
+/*
+* Defines the texture manager class that owns every texture in the scene. Textures are keyed by path so each
+* image is loaded once no matter how many materials use it, and failed loads share a cached placeholder.
+* Images can be decoded on worker threads and streamed to the GPU a little every frame. When the driver supports S3TC,
+* decoded images are block compressed on the workers and the result is cached on disk for the next run
+*
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <pixel_buffer_ring.h>
+#include <texture.h>
+#include <texture_compression.h>
+#include <thread_pool.h>
+
+// stable reference to a managed texture, the default handle is the placeholder
+struct TextureHandle {
+	uint32_t index{ 0 };
+};
+
+class TextureManager {
+public:
+	// creates the placeholder texture, needs a current GL context. Compression is turned off when the driver lacks S3TC
+	void Init(ThreadPool& workerPool, bool compress = true);
+	void Destroy();
+
+	// returns the existing handle when the path was loaded before
+	TextureHandle Load(const std::filesystem::path& path);
+
+	// decodes on a worker thread and returns right away, the placeholder is used until the upload finishes
+	TextureHandle LoadAsync(const std::filesystem::path& path);
+
+	// uploads decoded images through the pixel buffer ring until budgetMs is spent, call once per frame
+	void Update(double budgetMs);
+
+	// waits for every pending texture and uploads it without a time budget
+	void Flush();
+
+	bool HasPending() const;
+	GLuint Get(TextureHandle handle) const;
+
+	// prints load time and GPU memory for every texture, with encode time and quality for compressed ones
+	void PrintReport() const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Entry {
+		std::string path;
+		GLuint texture{ 0 };
+		bool loaded{ false }; // false means the placeholder is used
+		bool pending{ false }; // still decoding or uploading
+		Clock::time_point requested;
+		double decodeMs{ 0.0 };
+		double loadMs{ 0.0 }; // from the request until the texture is usable
+		size_t bytes{ 0 };
+		size_t uncompressedBytes{ 0 }; // what the RGBA8 chain would have used
+		bool compressed{ false };
+		bool cached{ false }; // blocks came from the disk cache
+		BlockFormat format{ BlockFormat::BC1 };
+		double encodeMs{ 0.0 };
+		float psnr{ 0.0f };
+	};
+
+	// result handed from a worker thread back to the main thread
+	struct DecodedImage {
+		uint32_t index{ 0 };
+		bool ok{ false };
+		double decodeMs{ 0.0 };
+		MipChain chain; // empty when the blocks are used instead
+		bool compressed{ false };
+		bool cached{ false };
+		size_t uncompressedBytes{ 0 };
+		CompressedTexture blocks;
+	};
+
+	// texture being streamed, a band of rows is uploaded per step. Compressed levels advance 4 rows per block row
+	struct UploadJob {
+		uint32_t index{ 0 };
+		GLuint texture{ 0 };
+		MipChain chain;
+		CompressedTexture blocks;
+		bool compressed{ false };
+		size_t level{ 0 };
+		int row{ 0 };
+	};
+
+	std::string canonicalKey(const std::filesystem::path& path) const;
+	uint32_t addEntry(const std::string& key);
+	void finishEntry(uint32_t index, GLuint texture, size_t bytes);
+	void startUploads();
+	bool uploadStep(UploadJob& job); // returns true once every level is on the GPU
+	void uploadRows(UploadJob& job);
+	void uploadBlockRows(UploadJob& job);
+
+private:
+	ThreadPool* pool{ nullptr };
+	PixelBufferRing pixelRing;
+	bool compression{ false };
+
+	std::vector<Entry> entries; // entries[0] is the placeholder
+	std::unordered_map<std::string, uint32_t> handlesByPath;
+
+	// decoded images waiting for the main thread, shared with the workers
+	mutable std::mutex decodedMutex;
+	std::condition_variable decodedReady;
+	std::vector<DecodedImage> decoded;
+	uint32_t decodesInFlight{ 0 };
+
+	std::deque<UploadJob> uploads; // main thread only
+};
@@ -0,0 +1,47 @@
+/*
+* Defines the thread pool class that runs background work such as image decoding on worker threads
+*
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+	// zero threads means one per hardware thread
+	explicit ThreadPool(size_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void Submit(std::function<void()> task);
+
+	// blocks until every submitted task has finished
+	void Wait();
+
+	// Runs body(begin, end) over [0, count) in chunks. The calling thread works on chunks too and only waits for
+	// chunks already started, so it is safe to call from inside a task even when every worker is busy
+	void ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& body);
+
+	size_t ThreadCount() const { return workers.size(); }
+
+private:
+	void workerLoop();
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable allDone;
+	size_t activeTasks{ 0 };
+	bool stopping{ false };
+};
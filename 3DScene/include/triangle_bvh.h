@@ -0,0 +1,62 @@
+/*
+* Defines the per mesh triangle BVH used for picking and camera collision. The object BVH is built over the
+* triangle boxes with leaves of up to four triangles, each leaf is stored as one block of four triangles in
+* structure of arrays form so a ray is tested against all of them at once with Möller-Trumbore
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include <bvh.h>
+#include <objects.h>
+
+struct RayHit {
+	float distance{ std::numeric_limits<float>::infinity() };
+	uint32_t triangle{ ~0u }; // index of the triangle's first index divided by 3
+	float u{ 0.0f }; // barycentrics of the hit relative to the second and third vertex
+	float v{ 0.0f };
+};
+
+class TriangleBvh {
+public:
+	void Build(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+
+	// closest triangle along the ray within ray.tMax, both faces count
+	bool Intersect(const Ray& ray, RayHit& hit) const;
+
+	// true as soon as any triangle is found within ray.tMax, cheaper than the closest hit for occlusion and collision
+	bool Occluded(const Ray& ray) const;
+
+	size_t TriangleCount() const { return triangleCount; }
+	const MeshBounds& Bounds() const { return bounds; }
+	bool Empty() const { return blocks.empty(); }
+
+	// instruction set the four wide kernel uses in this build
+	static const char* SimdName();
+
+private:
+	// four triangles as v0 and the two edges from it, padding lanes are degenerate and never hit
+	struct Triangle4 {
+		float v0x[4], v0y[4], v0z[4];
+		float e1x[4], e1y[4], e1z[4];
+		float e2x[4], e2y[4], e2z[4];
+		uint32_t triangle[4];
+	};
+
+	// hit mask of the four lanes, distances and barycentrics of the hit lanes are written out
+	static int intersect4(const Triangle4& block, const Ray& ray, float* distance, float* u, float* v);
+
+	template <bool AnyHit>
+	bool traverse(const Ray& ray, RayHit& hit) const;
+
+	Bvh bvh;
+	std::vector<Triangle4> blocks;
+	std::vector<uint32_t> leafBlocks; // first block of a leaf, indexed by the leaf's first item
+	size_t triangleCount{ 0 };
+	MeshBounds bounds;
+};
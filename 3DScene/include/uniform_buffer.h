@@ -0,0 +1,77 @@
+/*
+* Defines the uniform buffer classes. UniformBuffer holds data shared by every shader program for a frame,
+* UniformRing holds one record per drawn object and is uploaded once per frame
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// fixed binding points, every shader program with these blocks is hooked up to them when it is linked
+enum UniformBinding : GLuint {
+	FrameBinding = 0,
+	ObjectBinding = 1
+};
+
+// returns the binding point for a uniform block name, or -1 if the block is not one of ours
+GLint UniformBlockBinding(std::string_view blockName);
+
+// layout (std140) uniform FrameData in shader.vert and shader.frag, vec3s are padded to vec4
+struct FrameUniforms {
+	glm::mat4 projection{ 1.f };
+	glm::mat4 view{ 1.f };
+	glm::vec4 viewPos{ 0.f };
+	glm::vec4 keyLightDir{ 0.f };
+	glm::vec4 keyLightColor{ 0.f };
+};
+
+// layout (std140) uniform ObjectData in shader.vert
+struct ObjectUniforms {
+	glm::mat4 model{ 1.f };
+	glm::mat4 normalMatrix{ 1.f }; // inverse transpose of model, computed once on the CPU instead of per vertex
+	glm::uvec4 vertexFormat{ 0u }; // x is 1 when normals are octahedral encoded
+};
+
+class UniformBuffer {
+public:
+	void Create(GLsizeiptr size);
+	void Destroy();
+
+	void Update(const void* data, GLsizeiptr size, GLintptr offset = 0);
+	void BindBase(GLuint bindingPoint);
+
+private:
+	GLuint buffer{ 0 };
+	GLsizeiptr bufferSize{ 0 };
+};
+
+// Per-object records written into one buffer and uploaded with a single call per frame. The buffer is split
+// into a segment per frame in flight so the GPU can still read last frame's records while new ones are written.
+// The capacity is only a starting size, every pushed record gets its own slot
+class UniformRing {
+public:
+	void Create(GLsizeiptr recordSize, uint32_t capacity, uint32_t framesInFlight = 3);
+	void Destroy();
+
+	void BeginFrame();
+	uint32_t Push(const void* record); // returns the slot to bind when drawing, the ring grows when it is full
+	void Upload();
+	void Bind(GLuint bindingPoint, uint32_t slot); // bind after Upload, a Push that grows the ring moves the segments
+
+private:
+	void grow();
+
+	GLuint buffer{ 0 };
+	GLsizeiptr recordSize{ 0 };
+	GLsizeiptr stride{ 0 }; // record size rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	uint32_t capacity{ 0 };
+	uint32_t frames{ 0 };
+	uint32_t frameIndex{ 0 };
+	uint32_t count{ 0 };
+	std::vector<uint8_t> staging;
+};
@@ -0,0 +1,104 @@
+/*
+* Defines the vertex layout system. Meshes are authored with the Vertex struct from objects.h and packed into a
+* layout chosen per mesh, and the layout tells Mesh how to set up its vertex attributes
+*
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <bounds.h>
+#include <objects.h>
+
+// attribute locations used by the shaders, location 1 was the unused vertex color
+enum VertexLocation : GLuint {
+	PositionLocation = 0,
+	NormalLocation = 2,
+	UvLocation = 3,
+	InstanceModelLocation = 4, // four vec4 columns, 4 to 7
+	InstanceMaterialLocation = 8
+};
+
+enum class PositionFormat : uint8_t {
+	Float3, // 12 bytes
+	Half3 // 8 bytes with padding, scaled into the mesh bounds and expanded by Mesh::Dequantize
+};
+
+enum class NormalFormat : uint8_t {
+	Float3, // 12 bytes
+	Oct16 // 4 bytes, octahedral encoding in two snorm16 values, decoded in the vertex shader
+};
+
+enum class UvFormat : uint8_t {
+	Float2, // 8 bytes
+	Half2, // 4 bytes
+	Unorm16 // 4 bytes, only for coordinates in [0, 1], falls back to Half2 otherwise
+};
+
+struct VertexFormat {
+	PositionFormat position{ PositionFormat::Float3 };
+	NormalFormat normal{ NormalFormat::Float3 };
+	UvFormat uv{ UvFormat::Float2 };
+
+	bool operator==(const VertexFormat&) const = default;
+};
+
+namespace VertexFormats {
+	constexpr VertexFormat Standard{ PositionFormat::Float3, NormalFormat::Float3, UvFormat::Float2 }; // 32 bytes
+	constexpr VertexFormat Compact{ PositionFormat::Half3, NormalFormat::Oct16, UvFormat::Half2 }; // 16 bytes
+}
+
+// one glVertexAttribPointer call
+struct VertexAttribute {
+	GLuint location{ 0 };
+	GLint components{ 0 };
+	GLenum type{ GL_FLOAT };
+	GLboolean normalized{ GL_FALSE };
+	uint32_t offset{ 0 };
+};
+
+struct VertexLayout {
+	VertexFormat format;
+	std::vector<VertexAttribute> attributes;
+	uint32_t stride{ 0 };
+};
+
+// packed vertex data owned elsewhere, such as a section of a memory mapped baked mesh
+struct PackedVertexView {
+	VertexLayout layout;
+	std::span<const uint8_t> data;
+	uint32_t count{ 0 };
+	glm::vec3 dequantScale{ 1.0f };
+	glm::vec3 dequantOffset{ 0.0f };
+	MeshBounds bounds;
+	BoundingSphere sphere;
+};
+
+// vertex data in its GPU layout, ready for glBufferData
+struct PackedVertices {
+	VertexLayout layout;
+	std::vector<uint8_t> data;
+	uint32_t count{ 0 };
+
+	// quantized positions are stored as (position - dequantOffset) / dequantScale
+	glm::vec3 dequantScale{ 1.0f };
+	glm::vec3 dequantOffset{ 0.0f };
+
+	// object space bounds of the unpacked positions
+	MeshBounds bounds;
+	BoundingSphere sphere;
+
+	PackedVertexView View() const { return { layout, data, count, dequantScale, dequantOffset, bounds, sphere }; }
+};
+
+namespace VertexPacking {
+	VertexLayout MakeLayout(const VertexFormat& format);
+	PackedVertices Pack(std::span<const Vertex> vertices, VertexFormat format);
+
+	uint32_t OctEncode(glm::vec3 normal); // two snorm16 values, x in the low half
+	glm::vec3 OctDecode(uint32_t encoded);
+}
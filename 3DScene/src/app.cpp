@@ -11,22 +11,75 @@
 
 #include "app.h"
 #include "camera.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <benchmarks.h>
+#include <frame_pacer.h>
+#include <frame_stats.h>
+#include <gl_state.h>
+#include <input.h>
+#include <mesh_file.h>
+#include <mesh_optimizer.h>
 #include <iostream>
 #include <objects.h>
 #include <vector>
 #include <glm/gtc/matrix_transform.hpp>
-#include <stb_image.h> 
+#include <texture.h>
 
 
-Camera camera(glm::vec3(0.0f, 1.f, 3.0f)); // Camera object
+// scene meshes in draw order, baked under assets/meshes/<name>.mesh by --bake-meshes
+static std::vector<MeshSource> sceneMeshSources()
+{
+	// the sphere sits after the cylinder in the combined index list
+	const ShapeGenerators::GeneratedMesh& both = Shapes::both();
+	uint32_t cylinderIndexCount = static_cast<uint32_t>(ShapeGenerators::CylinderCounts(Shapes::bothSegments).indices);
+	uint32_t sphereIndexCount = static_cast<uint32_t>(both.indices.size()) - cylinderIndexCount;
+
+	return {
+		{ "sphere_cylinder", both.vertices, both.indices, { { 0, cylinderIndexCount, {} }, { cylinderIndexCount, sphereIndexCount, {} } },
+			[] { return MeshLod::SphereCylinderChain(0.1f, 1.0f, 0.15f, Shapes::bothSegments); } },
+		{ "plane", ShapesTwo::planeVertices, ShapesTwo::planeIndices, {}, {} },
+		{ "pyramid", ShapesThree::pyramidVertices, ShapesThree::pyramidElements, {}, {} },
+		{ "cube", ShapesFour::cubeVertices, ShapesFour::cubeElements, {}, {} }
+	};
+}
+
+// scenes with at least this many objects are culled through the BVH instead of the flat sphere sweep
+static constexpr size_t BvhCullThreshold = 256;
+
+// background of the GL renderer and the path tracer
+static constexpr glm::vec3 ClearColor(0.71f, 0.71f, 0.61f);
+
+// closest the camera gets to any surface
+static constexpr float CameraCollisionRadius = 0.1f;
+
+static Path bakedMeshDirectory()
+{
+	return std::filesystem::current_path() / "assets" / "meshes";
+}
 
-// Mouse position tracking
-float lastX = 400, lastY = 300;
-bool firstMouse = true;
+// the GL meshes and the geometry arena upload these packed streams straight from a baked file's mapping
+static constexpr VertexFormat BakedVertexFormats[] = { VertexFormats::Compact, GeometryArena::Format };
+
+// welds and optimizes a scene mesh, triangles stay inside their submesh so baked and generated meshes end up the same
+static void optimizeMeshSource(const MeshSource& source, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	vertices.assign(source.vertices.begin(), source.vertices.end());
+	indices.assign(source.indices.begin(), source.indices.end());
+	MeshOptimizer::WeldVertices(vertices, indices);
+
+	std::vector<MeshOptimizer::IndexRange> ranges;
+	for (const Submesh& submesh : source.submeshes) {
+		ranges.push_back({ submesh.indexOffset, submesh.indexCount });
+	}
+	MeshOptimizer::Optimize(vertices, indices, ranges);
+}
 
 // light source setup
 App::App(std::string WindowTitle, int width, int height)
-	: appName{ WindowTitle }, _width{ width }, _height{ height }, _camera(glm::vec3(0.0f, 0.0f, 3.0f)),
+	: appName{ WindowTitle }, _width{ width }, _height{ height }, _camera(glm::vec3(0.0f, 1.0f, 3.0f)),
 	keyLightDir(glm::vec3(0.0f, 0.3f, 0.3f)), // sunlight coming from an angle
 	keyLightColor(glm::vec3(1.0f, 0.9f, 0.8f)), // color of sunlight
 	keyLightIntensity(1.5f) // brightness of the light source
@@ -35,108 +88,508 @@ App::App(std::string WindowTitle, int width, int height)
 }
 
 
-void App::Run() {
+void App::Run(const FrameLoopOptions& loopOptions) {
 	if (!openWindow()) {
 		return;
 	}
 
+	auto startTime = std::chrono::steady_clock::now();
+	bool firstFrame = true;
+
 	initializeCameraControls();
 	running = true;
 	setupScene();
 
-	float lastFrame = 0.0f;
+	FramePacer::ApplyVsync(loopOptions.vsync);
+	FramePacer pacer(loopOptions);
+	FrameStats stats;
+	uint32_t frame = 0;
+
+	// camera input and the scene advance in fixed steps, rendering blends the last two steps
+	glm::vec3 previousPosition = _camera.Position;
 
 	while (running) {
-		float currentFrame = glfwGetTime();
-		float deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
+		double frameSeconds = pacer.BeginFrame();
+		input.Poll(window);
 
 		if (glfwWindowShouldClose(window)) {
 			running = false;
 			break;
 		}
 
-		handleCameraMovement(deltaTime);
+		GLState::ResetFrameCounters();
+		auto cpuStart = std::chrono::steady_clock::now();
+
+		float step = static_cast<float>(pacer.FixedStep());
+		for (uint32_t steps = pacer.Steps(); steps > 0; --steps) {
+			previousPosition = _camera.Position;
+			handleCameraMovement(step);
+			update();
+		}
+
+		// stream decoded textures for a couple of milliseconds each frame
+		textures.Update(2.0);
+
+		// events that arrived during the simulation still make this frame
+		input.Poll(window);
+		InputClock::time_point oldestInput = applyInput();
+
+		glm::vec3 simulatedPosition = _camera.Position;
+		_camera.Position = glm::mix(previousPosition, simulatedPosition, static_cast<float>(pacer.Alpha()));
+		draw();
+		_camera.Position = simulatedPosition;
+
+		auto cpuEnd = std::chrono::steady_clock::now();
+		GLState::Counters glCalls = GLState::FrameCounters();
+		stats.Record(frame, std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count(), glCalls.issued, glCalls.elided, glCalls.draws);
+		stats.SetCulling(frame, cullStats.visible, cullStats.culled, cullStats.ms);
+		if (frame > 0) {
+			stats.SetFrameTime(frame, frameSeconds * 1000.0);
+		}
+
+		glfwSwapBuffers(window);
+		if (oldestInput != InputClock::time_point{}) {
+			inputLatency.Submit(frame, oldestInput);
+		}
+		inputLatency.Collect(stats);
+		++frame;
+
+		pacer.WaitForNextFrame();
+
+		if (firstFrame) {
+			std::cout << "Time to first frame: " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() << " ms" << std::endl;
+			firstFrame = false;
+		}
+	}
+
+	inputLatency.Collect(stats, true);
+	inputLatency.Destroy();
+
+	stats.PrintSummary();
+	if (!loopOptions.statsPath.empty()) {
+		stats.Write(loopOptions.statsPath);
+	}
+
+	glfwTerminate();
+}
+
+// Renders a fixed number of frames into an offscreen framebuffer while the camera follows a scripted path.
+// Used as the benchmark harness on machines without a display or GPU
+bool App::RunHeadless(const HeadlessOptions& options)
+{
+	if (!openWindow(true)) {
+		return false;
+	}
+
+	if (!createOffscreenTarget()) {
+		glfwTerminate();
+		return false;
+	}
+
+	running = true;
+	setupScene();
+
+	// benchmark frames should not include texture streaming
+	textures.Flush();
+
+	FrameStats stats;
+	GpuTimer gpuTimer;
+	gpuTimer.Init(stats);
+
+	auto previousStart = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < options.frames; ++frame) {
+		// a motionless mouse event at the top of every frame probes input latency without moving the scripted camera
+		input.Push(InputEvent{});
+		applyCameraPath(frame, options.frames);
+
+		GLState::ResetFrameCounters();
+		auto cpuStart = std::chrono::steady_clock::now();
+		gpuTimer.Begin(frame);
+
 		update();
+		InputClock::time_point oldestInput = applyInput();
 		draw();
+
+		gpuTimer.End();
+		auto cpuEnd = std::chrono::steady_clock::now();
+		inputLatency.Submit(frame, oldestInput);
+
+		GLState::Counters glCalls = GLState::FrameCounters();
+		stats.Record(frame, std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count(), glCalls.issued, glCalls.elided, glCalls.draws);
+		stats.SetCulling(frame, cullStats.visible, cullStats.culled, cullStats.ms);
+		if (frame > 0) {
+			stats.SetFrameTime(frame, std::chrono::duration<double, std::milli>(cpuStart - previousStart).count());
+		}
+		previousStart = cpuStart;
+		gpuTimer.Collect();
+		inputLatency.Collect(stats);
 	}
 
+	// wait for the last frames to finish on the GPU so every row has a GPU time
+	gpuTimer.Collect(true);
+	gpuTimer.Destroy();
+	inputLatency.Collect(stats, true);
+	inputLatency.Destroy();
+
+	stats.PrintSummary();
+	bool written = stats.Write(options.outputPath);
+
+	destroyOffscreenTarget();
 	glfwTerminate();
+	return written;
 }
 
-void App::initializeCameraControls() {
-	glfwSetCursorPosCallback(window, [](GLFWwindow* window, double xpos, double ypos) {
-		if (firstMouse) {
-			lastX = xpos;
-			lastY = ypos;
-			firstMouse = false;
+// Renders the first frame of the headless camera path with the CPU path tracer, no GL context is created
+bool App::RunPathTrace(const PathTraceOptions& options)
+{
+	buildSceneGraph();
+	scene.Update();
+
+	PathTracer tracer;
+	std::vector<MeshSource> sources = sceneMeshSources();
+	setupPathTracer(tracer, sources);
+
+	Image image;
+	PathTraceStats stats = tracer.Render(workers, options, image);
+	std::cout << "Path traced " << options.width << "x" << options.height << " at " << options.samples << " samples per pixel in "
+		<< stats.ms << " ms on " << stats.threads << " threads, " << stats.SamplesPerSecond() / 1.0e6 << " Msamples/s" << std::endl;
+	return Texture::SaveImage(options.outputPath, image);
+}
+
+// Rasterizes the first frame of the headless camera path on the CPU, no GL context is created
+bool App::RunRasterize(const RasterOptions& options)
+{
+	buildSceneGraph();
+	scene.Update();
+
+	SoftRasterizer rasterizer;
+	std::vector<MeshSource> sources = sceneMeshSources();
+	setupSoftRasterizer(rasterizer, sources);
+
+	applyCameraPath(0, 1);
+	Image image;
+	RasterStats stats = rasterizer.Render(workers, rasterFrame(options.width, options.height), options.width, options.height, image);
+	std::cout << "Rasterized " << options.width << "x" << options.height << " with " << SoftRasterizer::SimdName() << " in " << stats.totalMs << " ms ("
+		<< stats.triangles << " triangles, " << stats.blocksSkipped << " of " << stats.blocksTested << " blocks skipped by depth)" << std::endl;
+	return Texture::SaveImage(options.outputPath, image);
+}
+
+// decoded texture of every object for the CPU renderers, missing files get the placeholder like in the texture manager
+std::vector<Image> App::loadObjectImages() const
+{
+	Path texturePath = std::filesystem::current_path() / "assets" / "textures";
+	std::vector<Image> images(objects.size());
+	for (size_t i = 0; i < objects.size(); ++i) {
+		if (!Texture::LoadImage(texturePath / objects[i].textureFile, images[i])) {
+			std::cerr << "Failed to load texture at path: " << (texturePath / objects[i].textureFile).string() << ", using placeholder" << std::endl;
+			images[i] = Texture::PlaceholderImage();
 		}
+	}
+	return images;
+}
+
+void App::setupSoftRasterizer(SoftRasterizer& rasterizer, const std::vector<MeshSource>& sources)
+{
+	for (const auto& source : sources) {
+		rasterizer.AddMesh(source.vertices, source.indices);
+	}
+
+	std::vector<Image> images = loadObjectImages();
+	for (size_t i = 0; i < objects.size(); ++i) {
+		rasterizer.AddObject(static_cast<uint32_t>(objects[i].mesh), scene.World(objects[i].node), rasterizer.AddTexture(images[i]));
+	}
+}
+
+// the FrameData the GL renderer would upload for the current camera
+RasterFrame App::rasterFrame(uint32_t width, uint32_t height) const
+{
+	RasterFrame frame;
+	frame.projection = projectionMatrix(static_cast<float>(width) / static_cast<float>(height));
+	frame.view = _camera.GetViewMatrix();
+	frame.viewPos = _camera.Position;
+	frame.keyLightDir = keyLightDir;
+	frame.keyLightColor = keyLightColor;
+	frame.clearColor = ClearColor;
+	return frame;
+}
+
+glm::mat4 App::projectionMatrix(float aspectRatio) const
+{
+	if (_isOrthographic) {
+		// Orthographic projection
+		return glm::ortho(-aspectRatio, aspectRatio, -1.0f, 1.0f, 0.1f, 100.0f);
+	}
+	// Perspective projection
+	return glm::perspective(glm::radians(75.f), aspectRatio, 0.1f, 100.f);
+}
+
+// fills the tracer with the scene meshes, the objects placed by the scene graph, their textures, and the key light
+void App::setupPathTracer(PathTracer& tracer, const std::vector<MeshSource>& sources)
+{
+	for (const auto& source : sources) {
+		tracer.AddMesh(source.vertices, source.indices);
+	}
+
+	std::vector<Image> images = loadObjectImages();
+	for (size_t i = 0; i < objects.size(); ++i) {
+		tracer.AddObject(static_cast<uint32_t>(objects[i].mesh), scene.World(objects[i].node), tracer.AddTexture(std::move(images[i])));
+	}
+
+	// same view as the first headless frame, so the GL frame and the traced image can be compared
+	applyCameraPath(0, 1);
+	PathTraceCamera view;
+	view.position = _camera.Position;
+	view.front = _camera.Front;
+	view.up = _camera.Up;
+	tracer.SetCamera(view);
+
+	PathTraceLighting lighting;
+	lighting.keyLightDir = keyLightDir;
+	lighting.keyLightColor = keyLightColor;
+	lighting.background = ClearColor;
+	tracer.SetLighting(lighting);
+}
+
+// Opens the same hidden context as headless runs and runs a microbenchmark against the loaded scene
+bool App::RunBenchmark(const std::string& name)
+{
+	if (!openWindow(true)) {
+		return false;
+	}
+
+	if (!createOffscreenTarget()) {
+		glfwTerminate();
+		return false;
+	}
+
+	setupScene();
+	textures.Flush();
+
+	bool found = true;
+	if (name == "uniforms") {
+		Benchmarks::UniformLookup(100000);
+	}
+	else if (name == "instancing") {
+		draw(); // fills FrameData with the camera
+		Benchmarks::Instancing(meshes[2], shader, instancedShader);
+	}
+	else if (name == "multidraw") {
+		if (!GeometryArena::IsSupported()) {
+			std::cerr << "Multi-draw indirect needs OpenGL 4.3" << std::endl;
+			found = false;
+		}
+		else {
+			draw(); // fills FrameData with the camera
+			Benchmarks::MultiDraw(sceneMeshSources(), shader, instancedShader);
+		}
+	}
+	else if (name == "bvh") {
+		Benchmarks::BvhBuild(100000);
+	}
+	else if (name == "pathtrace") {
+		PathTracer tracer;
+		std::vector<MeshSource> sources = sceneMeshSources();
+		setupPathTracer(tracer, sources);
+		Benchmarks::PathTraceScaling(tracer);
+	}
+	else if (name == "softraster") {
+		SoftRasterizer rasterizer;
+		std::vector<MeshSource> sources = sceneMeshSources();
+		setupSoftRasterizer(rasterizer, sources);
+
+		// the headless camera path at 1080p
+		const uint32_t frameCount = 60;
+		std::vector<RasterFrame> frames;
+		for (uint32_t frame = 0; frame < frameCount; ++frame) {
+			applyCameraPath(frame, frameCount);
+			frames.push_back(rasterFrame(1920, 1080));
+		}
+		Benchmarks::SoftRaster(rasterizer, workers, frames, 1920, 1080);
+	}
+	else if (name == "meshopt") {
+		Benchmarks::MeshOptimization();
+	}
+	else if (name == "lod") {
+		Benchmarks::LevelOfDetail(10000, 200);
+	}
+	else if (name == "shapes") {
+		Benchmarks::ShapeGeneration(workers);
+	}
+	else if (name == "raycast") {
+		Benchmarks::TriangleRaycast(200000);
+	}
+	else if (name == "culling") {
+		Benchmarks::FrustumCulling(100);
+	}
+	else if (name == "scenegraph") {
+		Benchmarks::SceneGraphUpdate(100);
+	}
+	else if (name == "vertexformat") {
+		Benchmarks::VertexFormats(Shapes::both().vertices, Shapes::both().indices, 2000);
+	}
+	else if (name == "meshload") {
+		Benchmarks::MeshLoad(sceneMeshSources(), std::filesystem::current_path() / "cache" / "meshes", 200);
+	}
+	else {
+		std::cerr << "Unknown benchmark: " << name << std::endl;
+		found = false;
+	}
+
+	destroyOffscreenTarget();
+	glfwTerminate();
+	return found;
+}
 
-		float xoffset = xpos - lastX;
-		float yoffset = lastY - ypos; 
+// one full orbit around the objects over the length of the run
+void App::applyCameraPath(uint32_t frame, uint32_t frameCount)
+{
+	const glm::vec3 target(0.5f, 0.0f, 0.25f);
+	const float radius = 3.0f;
+	const float height = 1.0f;
 
-		lastX = xpos;
-		lastY = ypos;
+	float angle = 2.0f * 3.1415926f * static_cast<float>(frame) / static_cast<float>(std::max(frameCount, 1u));
+	_camera.Position = target + glm::vec3(radius * std::cos(angle), height, radius * std::sin(angle));
+	_camera.LookAt(target);
+}
 
-		camera.ProcessMouseMovement(xoffset, yoffset);
+// the callbacks only queue events, applyInput hands them to the camera right before drawing
+void App::initializeCameraControls() {
+	glfwSetCursorPosCallback(window, [](GLFWwindow* window, double xpos, double ypos) {
+		reinterpret_cast<App*>(glfwGetWindowUserPointer(window))->input.PushCursor(xpos, ypos);
 		});
 
 	glfwSetScrollCallback(window, [](GLFWwindow* window, double xoffset, double yoffset) {
-		// this will adjust the camera movement speed based on yoffset
-		camera.MovementSpeed += static_cast<float>(yoffset);
-		if (camera.MovementSpeed < 1.0f)
-			camera.MovementSpeed = 1.0f;
-		if (camera.MovementSpeed > 10.0f)
-			camera.MovementSpeed = 10.0f;
+		InputEvent event;
+		event.type = InputEvent::Type::Scroll;
+		event.x = xoffset;
+		event.y = yoffset;
+		reinterpret_cast<App*>(glfwGetWindowUserPointer(window))->input.Push(event);
 		});
 
-	glfwSetScrollCallback(window, [](GLFWwindow* window, double xoffset, double yoffset) {
-		// this will adjust the camera movement speed based on yoffset
-		camera.ProcessMouseScroll(static_cast<float>(yoffset));
+	glfwSetMouseButtonCallback(window, [](GLFWwindow* window, int button, int action, int) {
+		InputEvent event;
+		event.type = InputEvent::Type::MouseButton;
+		event.code = button;
+		event.action = action;
+		reinterpret_cast<App*>(glfwGetWindowUserPointer(window))->input.Push(event);
+		});
+
+	// movement samples the key state, key events are queued so presses count toward input latency
+	glfwSetKeyCallback(window, [](GLFWwindow* window, int key, int, int action, int) {
+		InputEvent event;
+		event.type = InputEvent::Type::Key;
+		event.code = key;
+		event.action = action;
+		reinterpret_cast<App*>(glfwGetWindowUserPointer(window))->input.Push(event);
 		});
 
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 }
-// camera movement with WSAD, QE, and P keys
-void App::handleCameraMovement(float deltaTime) {
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		camera.ProcessKeyboard(FORWARD, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		camera.ProcessKeyboard(BACKWARD, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		camera.ProcessKeyboard(LEFT, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		camera.ProcessKeyboard(RIGHT, deltaTime);
 
+// late latch: mouse look and clicks are applied after the simulation steps, just before the frame is drawn
+InputClock::time_point App::applyInput()
+{
+	inputEvents.clear();
+	InputClock::time_point oldest = input.Drain(inputEvents);
+	for (const auto& event : inputEvents) {
+		switch (event.type) {
+		case InputEvent::Type::MouseMove:
+			_camera.ProcessMouseMovement(static_cast<float>(event.x), static_cast<float>(event.y));
+			break;
+		case InputEvent::Type::Scroll:
+			_camera.ProcessMouseScroll(static_cast<float>(event.y));
+			break;
+		case InputEvent::Type::MouseButton:
+			// the cursor is captured, so the left button picks whatever is under the center of the screen
+			if (event.code == GLFW_MOUSE_BUTTON_LEFT && event.action == GLFW_PRESS) {
+				pickObject();
+			}
+			break;
+		case InputEvent::Type::Key:
+			// one press toggles once, however many simulation steps ran this frame
+			if (event.code == GLFW_KEY_P && event.action == GLFW_PRESS) {
+				_isOrthographic = !_isOrthographic;
+			}
+			break;
+		}
+	}
+	return oldest;
+}
 
-	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-		camera.Position += glm::vec3(0.0f, deltaTime * camera.MovementSpeed, 0.0f);
-	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-		camera.Position -= glm::vec3(0.0f, deltaTime * camera.MovementSpeed, 0.0f);
-
-	// Projection mode with P key
-	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
-		_isOrthographic = !_isOrthographic;
+// camera movement with WSAD and QE keys, P toggles the projection in applyInput
+void App::handleCameraMovement(float deltaTime) {
+	glm::vec3 previousPosition = _camera.Position;
+	if (input.KeyDown(GLFW_KEY_W))
+		_camera.ProcessKeyboard(FORWARD, deltaTime);
+	if (input.KeyDown(GLFW_KEY_S))
+		_camera.ProcessKeyboard(BACKWARD, deltaTime);
+	if (input.KeyDown(GLFW_KEY_A))
+		_camera.ProcessKeyboard(LEFT, deltaTime);
+	if (input.KeyDown(GLFW_KEY_D))
+		_camera.ProcessKeyboard(RIGHT, deltaTime);
+
+
+	if (input.KeyDown(GLFW_KEY_Q))
+		_camera.Position += glm::vec3(0.0f, deltaTime * _camera.MovementSpeed, 0.0f);
+	if (input.KeyDown(GLFW_KEY_E))
+		_camera.Position -= glm::vec3(0.0f, deltaTime * _camera.MovementSpeed, 0.0f);
+
+	// the camera stops short of any surface between where it was and where it wants to go
+	glm::vec3 motion = _camera.Position - previousPosition;
+	float length = glm::length(motion);
+	if (length > 0.0f) {
+		Ray ray;
+		ray.origin = previousPosition;
+		ray.direction = motion / length;
+		ray.tMax = length + CameraCollisionRadius;
+
+		SceneHit hit;
+		if (rayScene.Intersect(ray, hit)) {
+			_camera.Position = previousPosition + ray.direction * std::max(0.0f, hit.hit.distance - CameraCollisionRadius);
+		}
 	}
+
 	// Exit the scene when Escape key is pressed
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
 		glfwSetWindowShouldClose(window, true);
 	}
 }
 
-bool App::openWindow()
+bool App::openWindow(bool headless)
 {
 	//GLFW and window setup
-	glfwInit();
+	if (!glfwInit()) {
+		std::cerr << "Failed to initialize GLFW" << std::endl;
+		return false;
+	}
+	// 4.3 brings multi-draw indirect for the geometry arena, 4.2 is enough for everything else
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-	window = glfwCreateWindow(800, 600, "3D Scene by Elizabeth Robles", nullptr, nullptr);
+	if (headless) {
+		// headless runs never show the window, try a software OSMesa context first so no GPU is needed
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+		window = glfwCreateWindow(_width, _height, appName.c_str(), nullptr, nullptr);
+
+		// GLFW builds without OSMesa fall back to a hidden native window (llvmpipe when LIBGL_ALWAYS_SOFTWARE is set)
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_NATIVE_CONTEXT_API);
+	}
+
+	if (!window) {
+		window = glfwCreateWindow(_width, _height, "3D Scene by Elizabeth Robles", nullptr, nullptr);
+	}
+
+	if (!window) {
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+		window = glfwCreateWindow(_width, _height, "3D Scene by Elizabeth Robles", nullptr, nullptr);
+	}
 
 	if (!window) {
 		std::cerr << "Failed to create window" << std::endl;
 		glfwTerminate();
+		return false;
 	}
 
 	glfwMakeContextCurrent(window);
@@ -157,30 +610,175 @@ bool App::openWindow()
 		return false;
 	}
 
-	glEnable(GL_DEPTH_TEST);
+	// new context, nothing the state cache remembers is valid anymore
+	GLState::Invalidate();
+	GLState::SetDepthTest(true);
 
 	return true;
 }
 
+// creates the color and depth renderbuffers that headless frames are drawn into
+bool App::createOffscreenTarget()
+{
+	glGenFramebuffers(1, &offscreenFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+
+	glGenRenderbuffers(1, &offscreenColor);
+	glBindRenderbuffer(GL_RENDERBUFFER, offscreenColor);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, _width, _height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColor);
+
+	glGenRenderbuffers(1, &offscreenDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, offscreenDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, _width, _height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreenDepth);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+		destroyOffscreenTarget();
+		return false;
+	}
+
+	glViewport(0, 0, _width, _height);
+	return true;
+}
+
+void App::destroyOffscreenTarget()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteRenderbuffers(1, &offscreenColor);
+	glDeleteRenderbuffers(1, &offscreenDepth);
+	glDeleteFramebuffers(1, &offscreenFBO);
+	offscreenColor = offscreenDepth = offscreenFBO = 0;
+}
+
+bool App::BakeMeshes(const Path& directory)
+{
+	bool ok = true;
+	for (const auto& source : sceneMeshSources()) {
+		// baked meshes load without any processing, so they are welded and optimized here
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		optimizeMeshSource(source, vertices, indices);
+
+		Path path = directory / (source.name + ".mesh");
+		uint64_t sourceHash = MeshFile::SourceHash(source.vertices, source.indices, source.submeshes);
+		if (MeshFile::Write(path, vertices, indices, source.submeshes, sourceHash, BakedVertexFormats)) {
+			std::cout << "Baked " << path.string() << std::endl;
+		}
+		else {
+			ok = false;
+		}
+	}
+	return ok;
+}
+
 // Sets up the scene and includes meshes, shaders, transformations, and textures
 void App::setupScene()
 {
-	// mesh for the sphere and cylinder object
-	meshes.emplace_back(Shapes::bothVertices, Shapes::bothIndices);
+	// sphere and cylinder, plane, pyramid, and cube. Baked meshes upload their packed streams straight from the
+	// file mapping, the built in shapes are used for any mesh that has not been baked
+	Path meshDirectory = bakedMeshDirectory();
+	useGeometryArena = GeometryArena::IsSupported();
+	if (useGeometryArena) {
+		geometry.Create(1u << 16, 1u << 18);
+	}
+
+	std::vector<std::vector<LodLevel>> coarserLevels;
+	for (const auto& source : sceneMeshSources()) {
+		// baked meshes were optimized and packed when they were baked, only their authored vertices are read here for
+		// the ray scene and the LOD builder. The built in shapes are optimized once here for the GL mesh, the arena, and the ray scene.
+		// A bake of an older version of the shape is skipped so it never shadows the current geometry
+		MeshFile baked;
+		std::vector<Vertex> optimizedVertices;
+		std::vector<uint32_t> optimizedIndices;
+		std::span<const Vertex> vertices;
+		std::span<const uint32_t> indices;
+		if (baked.Open(meshDirectory / (source.name + ".mesh"), MeshFile::SourceHash(source.vertices, source.indices, source.submeshes))) {
+			vertices = baked.Vertices();
+			indices = baked.Indices();
+		}
+		else {
+			optimizeMeshSource(source, optimizedVertices, optimizedIndices);
 
-	// mesh for the plane
-	meshes.emplace_back(ShapesTwo::planeVertices, ShapesTwo::planeIndices);
+			MeshOptimizer::CacheStats before = MeshOptimizer::AnalyzeVertexCache(source.indices, static_cast<uint32_t>(source.vertices.size()));
+			MeshOptimizer::CacheStats after = MeshOptimizer::AnalyzeVertexCache(optimizedIndices, static_cast<uint32_t>(optimizedVertices.size()));
+			std::cout << "Mesh " << source.name << ": " << source.vertices.size() << " -> " << optimizedVertices.size() << " vertices, ACMR "
+				<< before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
 
-	//mesh for the pyramid
-	meshes.emplace_back(ShapesThree::pyramidVertices, ShapesThree::pyramidElements); 
+			vertices = optimizedVertices;
+			indices = optimizedIndices;
+		}
 
-	//mesh for the cube
-	meshes.emplace_back(ShapesFour::cubeVertices, ShapesFour::cubeElements); 
+		PackedVertexView packed;
+		if (baked.PackedStream(VertexFormats::Compact, packed)) {
+			meshes.emplace_back(packed, indices);
+		}
+		else {
+			meshes.emplace_back(vertices, indices);
+		}
+		rayScene.AddMesh(vertices, indices);
+		if (useGeometryArena) {
+			arenaMeshes.push_back(baked.PackedStream(GeometryArena::Format, packed) ? geometry.Add(packed, indices) : geometry.Add(vertices, indices));
+		}
+		coarserLevels.push_back(source.coarserLevels ? source.coarserLevels() : MeshLod::BuildChain(vertices, indices));
+	}
+
+	// levels of detail go after the scene meshes so a scene mesh index is also its full detail level.
+	// Picking, collision, and the CPU renderers keep using full detail
+	for (size_t mesh = 0; mesh < coarserLevels.size(); ++mesh) {
+		MeshLodChain chain{ { mesh }, { 0.0f } };
+		for (LodLevel& level : coarserLevels[mesh]) {
+			MeshOptimizer::WeldVertices(level.vertices, level.indices);
+			MeshOptimizer::Optimize(level.vertices, level.indices);
+			chain.meshes.push_back(meshes.size());
+			chain.errors.push_back(level.error);
+			meshes.emplace_back(level.vertices, level.indices);
+			if (useGeometryArena) {
+				arenaMeshes.push_back(geometry.Add(level.vertices, level.indices));
+			}
+		}
+		lodChains.push_back(std::move(chain));
+	}
+	if (useGeometryArena) {
+		geometry.PrintReport();
+	}
 
 	//loads shaders from .frag and .vert files
 	Path shaderPath = std::filesystem::current_path() / "assets" / "shaders";
 	shader = Shader(shaderPath / "shader.vert", shaderPath / "shader.frag");
+	instancedShader = Shader(shaderPath / "shader_instanced.vert", shaderPath / "shader.frag");
+
+	// camera and lighting live in one buffer for every program, model matrices in a per-object ring
+	frameUniforms.Create(sizeof(FrameUniforms));
+	frameUniforms.BindBase(FrameBinding);
+	objectUniforms.Create(sizeof(ObjectUniforms), 256);
+
+	buildSceneGraph();
+
+	// trilinear + anisotropic filtering for every texture on unit 0
+	textureSampler = Texture::CreateSampler();
+	GLState::BindSampler(0, textureSampler);
+
+	// every texture is loaded once through the manager and decoded on the worker threads,
+	// objects draw with the placeholder until their texture has been streamed in
+	Path texturePath = std::filesystem::current_path() / "assets" / "textures";
+	textures.Init(workers);
+	for (auto& object : objects) {
+		object.texture = textures.LoadAsync(texturePath / object.textureFile);
+	}
+
+	// the ray scene starts out with the initial world matrices
+	scene.Update();
+	for (const auto& object : objects) {
+		rayScene.AddObject(static_cast<uint32_t>(object.mesh), scene.World(object.node));
+	}
+	rayScene.Update();
+}
 
+// builds the scene graph and the list of objects placed in it, needs no GL context
+void App::buildSceneGraph()
+{
 	/*
 	* 
 	* Define transformations for each object
@@ -202,8 +800,11 @@ void App::setupScene()
 	glm::vec3 spongePosition(-1.0f, -0.5f + spongeBottomOffset, 0.5f); // Raise the bottom to sit on the plane
 	glm::mat4 spongeTranslation = glm::translate(glm::mat4(1.0f), spongePosition);
 
+	// the objects are children of the plane, so moving the plane moves everything on it
+	planeNode = scene.AddNode(glm::mat4(1.0f));
+
 	// Combining the transformations
-	spongeTransform = glm::translate(glm::mat4(1.0f), spongePosition) * spongeRotation * spongeScale;
+	spongeNode = scene.AddNode(spongeTranslation * spongeRotation * spongeScale, planeNode);
 
 
 	// Scaling down pyramid
@@ -211,160 +812,171 @@ void App::setupScene()
 	float pyramidHeight = 1.0f; // height of the pyramid before scaling
 	float pyramidBottomOffset = (pyramidHeight * pyramidScaleFactor) / 2.0f; // Half the height after scaling
 	glm::mat4 pyramidScale = glm::scale(glm::mat4(1.0f), glm::vec3(pyramidScaleFactor, pyramidScaleFactor, pyramidScaleFactor));
-	pyramidTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, -0.5f + pyramidBottomOffset, 0.5f)) * pyramidScale;
+	pyramidNode = scene.AddNode(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, -0.5f + pyramidBottomOffset, 0.5f)) * pyramidScale, planeNode);
 
 	// not scaling this object
-	sphereCylinderTransform = glm::translate(glm::mat4(1.0f), glm::vec3(1.5f, 0.0f, 0.0f));
-
-	// Load the wood tiles texture
-	{
-		Path texturePath = std::filesystem::current_path() / "assets" / "textures";
-		auto woodtilesPath = (texturePath / "woodtiles.jpg").string();
-
-		int woodtilesWidth, woodtilesHeight, woodtilesChannels;
-		unsigned char* woodtilesData = stbi_load(woodtilesPath.c_str(), &woodtilesWidth, &woodtilesHeight, &woodtilesChannels, STBI_rgb_alpha);
-
-		glGenTextures(1, &woodtilesTexture);
-		glBindTexture(GL_TEXTURE_2D, woodtilesTexture);
-
-		if (woodtilesData) {
-			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, woodtilesWidth, woodtilesHeight);
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, woodtilesWidth, woodtilesHeight, GL_RGBA, GL_UNSIGNED_BYTE, woodtilesData);
-			glGenerateMipmap(GL_TEXTURE_2D);
-		}
-		else {
-			std::cerr << "Failed to load texture at path: " << woodtilesPath << std::endl;
-		}
-		stbi_image_free(woodtilesData);
-	}
-
-	// Load the silver texture for the cap/pink body
-	{
-		Path texturePath = std::filesystem::current_path() / "assets" / "textures";
-		auto silverPath = (texturePath / "silver.jpg").string();
-
-		int silverWidth, silverHeight, silverChannels;
-		unsigned char* silverData = stbi_load(silverPath.c_str(), &silverWidth, &silverHeight, &silverChannels, STBI_rgb_alpha);
-
-		glGenTextures(1, &silverTexture);
-		glBindTexture(GL_TEXTURE_2D, silverTexture);
+	sphereCylinderNode = scene.AddNode(glm::translate(glm::mat4(1.0f), glm::vec3(1.5f, 0.0f, 0.0f)), planeNode);
+
+	objects = {
+		{ "sphere and cylinder", 0, sphereCylinderNode, "silver.jpg" }, // silver texture for the cap/pink body
+		{ "plane", 1, planeNode, "woodtiles.jpg" },
+		{ "pyramid", 2, pyramidNode, "quartz.jpg" },
+		{ "sponge", 3, spongeNode, "sponge.png" }
+	};
+}
 
-		if (silverData) {
-			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, silverWidth, silverHeight);
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, silverWidth, silverHeight, GL_RGBA, GL_UNSIGNED_BYTE, silverData);
-			glGenerateMipmap(GL_TEXTURE_2D);
-		}
-		else {
-			std::cerr << "Failed to load texture at path: " << silverPath << std::endl;
-		}
-		stbi_image_free(silverData);
+void App::updateObjectBounds()
+{
+	for (size_t i = 0; i < objects.size(); ++i) {
+		rayScene.SetTransform(static_cast<uint32_t>(i), scene.World(objects[i].node));
 	}
+	rayScene.Update();
+}
 
-	{
-		// Load the quartz texture
-		Path texturePath = std::filesystem::current_path() / "assets" / "textures";
-		auto quartzPath = (texturePath / "quartz.jpg").string();
-
-		int width, height, numChannels;
-		unsigned char* quartzData = stbi_load(quartzPath.c_str(), &width, &height, &numChannels, STBI_rgb_alpha);
-
-		glGenTextures(1, &quartzTexture);
-		glBindTexture(GL_TEXTURE_2D, quartzTexture);
-
-		if (quartzData) {
-			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, quartzData);
-			glGenerateMipmap(GL_TEXTURE_2D);
-		}
-		else {
-			std::cerr << "Failed to load texture at path: " << quartzPath << std::endl;
-		}
-		stbi_image_free(quartzData);
+void App::pickObject()
+{
+	Ray ray;
+	ray.origin = _camera.Position;
+	ray.direction = _camera.Front;
 
+	SceneHit hit;
+	if (rayScene.Intersect(ray, hit)) {
+		std::cout << "Picked " << objects[hit.object].name << " at " << hit.hit.distance << std::endl;
 	}
-
-	{
-		// Load the sponge texture
-		Path texturePath = std::filesystem::current_path() / "assets" / "textures";
-		auto spongePath = (texturePath / "sponge.png").string();
-
-		int width, height, numChannels;
-		unsigned char* spongeData = stbi_load(spongePath.c_str(), &width, &height, &numChannels, STBI_rgb_alpha);
-
-		glGenTextures(1, &spongeTexture);
-		glBindTexture(GL_TEXTURE_2D, spongeTexture);
-
-		if (spongeData) {
-			glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, spongeData);
-			glGenerateMipmap(GL_TEXTURE_2D);
-		}
-		else {
-			std::cerr << "Failed to load texture at path: " << spongePath << std::endl;
-		}
-		stbi_image_free(spongeData);
+	else {
+		std::cout << "Picked nothing" << std::endl;
 	}
-
 }
 
 bool App::update()
 {
+	// world matrices of anything moved since the last frame, the BVH follows them
+	if (scene.Update() > 0) {
+		updateObjectBounds();
+	}
 	return false;
 }
 
 // draw() renders the scene
 bool App::draw()
 {
-	glClearColor(0.71f, 0.71f, 0.61f, 1.0f); 
+	glClearColor(ClearColor.r, ClearColor.g, ClearColor.b, 1.0f); 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 
-	glm::mat4 projection;
-	if (_isOrthographic) {
-		// Orthographic projection
-		float aspectRatio = static_cast<float>(_width) / static_cast<float>(_height);
-		projection = glm::ortho(-aspectRatio, aspectRatio, -1.0f, 1.0f, 0.1f, 100.0f);
-	}
-	else {
-		// Perspective projection
-		projection = glm::perspective(glm::radians(75.f), static_cast<float>(_width) / static_cast<float>(_height), 0.1f, 100.f);
-	}
+	glm::mat4 projection = projectionMatrix(static_cast<float>(_width) / static_cast<float>(_height));
 
-	glm::mat4 view = camera.GetViewMatrix();
+	glm::mat4 view = _camera.GetViewMatrix();
 	shader.Bind();
 
-	// Set light properties
-	shader.SetVec3("keyLightDir", keyLightDir);
-	shader.SetVec3("keyLightColor", keyLightColor);
-	shader.SetVec3("viewPos", camera.Position); // pass the camera position for specular lighting
-	shader.SetMat4("projection", projection);
-	shader.SetMat4("view", view);
-
-	if (!meshes.empty()) {
-		// Sphere and cylinder
-		shader.SetMat4("model", sphereCylinderTransform);
-		glBindTexture(GL_TEXTURE_2D, silverTexture); // bind texture to each object
-		meshes[0].Draw();
+	// Set camera and light properties, one upload for every program
+	FrameUniforms frame;
+	frame.projection = projection;
+	frame.view = view;
+	frame.viewPos = glm::vec4(_camera.Position, 1.0f); // pass the camera position for specular lighting
+	frame.keyLightDir = glm::vec4(keyLightDir, 0.0f);
+	frame.keyLightColor = glm::vec4(keyLightColor, 0.0f);
+	frameUniforms.Update(&frame, sizeof(frame));
+
+	if (!objects.empty()) {
+		// mesh, transform, and texture of every object
+		struct DrawItem {
+			size_t mesh; // index into meshes and arenaMeshes
+			glm::mat4 transform;
+			GLuint texture;
+		};
+		std::vector<DrawItem> items;
+		items.reserve(objects.size());
+		for (const auto& object : objects) {
+			items.push_back({ object.mesh, scene.World(object.node), textures.Get(object.texture) });
+		}
 
-		// Plane
-		glBindTexture(GL_TEXTURE_2D, woodtilesTexture);
-		shader.SetMat4("model", glm::mat4(1.0f)); 
-		meshes[1].Draw();
+		// only objects that touch the view frustum are drawn. A flat sweep over the spheres wins for a
+		// handful of objects, larger scenes walk the BVH and skip whole groups that are off screen
+		Frustum frustum = Frustum::FromMatrix(projection * view);
+		if (items.size() < BvhCullThreshold) {
+			culler.Clear();
+			for (const auto& item : items) {
+				culler.Add(TransformSphere(meshes[item.mesh].Sphere(), item.transform));
+			}
+			cullStats = culler.Cull(frustum, visibleItems);
+		}
+		else {
+			auto cullStart = std::chrono::steady_clock::now();
+			visibleItems.clear();
+			rayScene.ObjectBvh().QueryFrustum(frustum, visibleItems);
+			std::sort(visibleItems.begin(), visibleItems.end());
+			cullStats.tested = static_cast<uint32_t>(items.size());
+			cullStats.visible = static_cast<uint32_t>(visibleItems.size());
+			cullStats.culled = cullStats.tested - cullStats.visible;
+			cullStats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cullStart).count();
+		}
 
-		// Pyramid
-		shader.SetMat4("model", pyramidTransform);
-		glBindTexture(GL_TEXTURE_2D, quartzTexture);
-		meshes[2].Draw();
+		// every visible object draws the coarsest level whose error projects to under a pixel
+		for (uint32_t index : visibleItems) {
+			SceneObject& object = objects[index];
+			const MeshLodChain& chain = lodChains[object.mesh];
+			if (chain.meshes.size() < 2) {
+				continue;
+			}
+			BoundingSphere bounds = TransformSphere(meshes[object.mesh].Sphere(), items[index].transform);
+			float distance = glm::length(bounds.center - _camera.Position) - bounds.radius;
+			float pixelsPerUnit = MeshLod::PixelsPerUnit(projection, static_cast<float>(_height), distance) * MaxScale(items[index].transform);
+			object.lod = MeshLod::SelectLevel(chain.errors, pixelsPerUnit, object.lod);
+			items[index].mesh = chain.meshes[object.lod];
+		}
 
-		// Sponge
-		shader.SetMat4("model", spongeTransform);
-		glBindTexture(GL_TEXTURE_2D, spongeTexture);
-		meshes[3].Draw();
-	}
+		if (useGeometryArena) {
+			// one bucket per texture, every object that shares a texture goes out in a single multi-draw
+			std::vector<GLuint> bucketTextures(items.size());
+			uint32_t bucketCount = 0;
+			geometry.BeginFrame();
+			for (uint32_t index : visibleItems) {
+				const DrawItem& item = items[index];
+				uint32_t bucket = static_cast<uint32_t>(std::find(bucketTextures.begin(), bucketTextures.begin() + bucketCount, item.texture) - bucketTextures.begin());
+				if (bucket == bucketCount) {
+					bucketTextures[bucketCount++] = item.texture;
+				}
+				geometry.Record(bucket, arenaMeshes[item.mesh], item.transform);
+			}
+			geometry.Upload();
+
+			// the model matrices come from the instance buffer, ObjectData only describes the vertex format
+			objectUniforms.BeginFrame();
+			ObjectUniforms arenaData;
+			arenaData.vertexFormat.x = geometry.HasOctNormals() ? 1u : 0u;
+			uint32_t slot = objectUniforms.Push(&arenaData);
+			objectUniforms.Upload();
+			objectUniforms.Bind(ObjectBinding, slot);
+
+			instancedShader.Bind();
+			for (uint32_t bucket = 0; bucket < bucketCount; ++bucket) {
+				GLState::BindTexture(0, GL_TEXTURE_2D, bucketTextures[bucket]);
+				geometry.Submit(bucket);
+			}
+			return false;
+		}
 
+		// write every model matrix first so they go to the GPU in one upload
+		objectUniforms.BeginFrame();
+		std::vector<uint32_t> slots(items.size());
+		for (uint32_t index : visibleItems) {
+			// dequantization is folded into the model matrix, the normal matrix comes from the transform alone
+			ObjectUniforms object;
+			const Mesh& mesh = meshes[items[index].mesh];
+			object.model = items[index].transform * mesh.Dequantize();
+			object.normalMatrix = glm::transpose(glm::inverse(items[index].transform));
+			object.vertexFormat.x = mesh.HasOctNormals() ? 1u : 0u;
+			slots[index] = objectUniforms.Push(&object);
+		}
+		objectUniforms.Upload();
 
-	glfwSwapBuffers(window);
-	glfwPollEvents();
+		for (uint32_t index : visibleItems) {
+			objectUniforms.Bind(ObjectBinding, slots[index]);
+			GLState::BindTexture(0, GL_TEXTURE_2D, items[index].texture); // bind texture to each object
+			meshes[items[index].mesh].Draw();
+		}
+	}
 
 	return false;
 }
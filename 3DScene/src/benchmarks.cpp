@@ -0,0 +1,910 @@
+/*
+*
+* Defines the microbenchmarks used to measure individual parts of the renderer
+*
+*/
+
+#include <benchmarks.h>
+#include <bvh.h>
+#include <mesh_lod.h>
+#include <mesh_optimizer.h>
+#include <objects.h>
+#include <shape_generators.h>
+#include <thread>
+#include <triangle_bvh.h>
+#include <frustum_culling.h>
+#include <gl_state.h>
+#include <instance_buffer.h>
+#include <uniform_buffer.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <iostream>
+#include <string>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double elapsedNs(Clock::time_point start, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::nano>(end - start).count();
+	}
+
+	// the per-frame uniforms draw() used to upload before they moved into the FrameData and ObjectData blocks
+	const char* const frameUniforms[] = { "keyLightDir", "keyLightColor", "viewPos", "projection", "view", "model" };
+
+	// the scene shaders keep these in uniform blocks now, so the benchmark links a program that still has them as plain uniforms
+	const char* const uniformBenchVertex = R"(#version 330 core
+layout (location = 0) in vec3 position;
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+uniform vec3 viewPos;
+out vec3 offset;
+void main() {
+    offset = viewPos;
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
+)";
+	const char* const uniformBenchFragment = R"(#version 330 core
+in vec3 offset;
+uniform vec3 keyLightDir;
+uniform vec3 keyLightColor;
+out vec4 FragColor;
+void main() {
+    FragColor = vec4(keyLightColor * max(dot(offset, keyLightDir), 0.0), 1.0);
+}
+)";
+
+	// the sphere generator objects.h had before ShapeGenerators, kept as the reference: vectors grown with push_back
+	// and sin/cos recomputed for every vertex
+	void baselineSphere(float radius, int segments, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		for (int y = 0; y <= segments; ++y) {
+			for (int x = 0; x <= segments; ++x) {
+				float xSection = static_cast<float>(x) / segments;
+				float ySection = static_cast<float>(y) / segments;
+
+				float xCoordinate = std::cos(xSection * 2.0f * 3.1415926f) * std::sin(ySection * 3.1415926f);
+				float yCoordinate = std::cos(ySection * 3.1415926f);
+				float zCoordinate = std::sin(xSection * 2.0f * 3.1415926f) * std::sin(ySection * 3.1415926f);
+
+				Vertex vertex;
+				vertex.Position = glm::vec3(xCoordinate, yCoordinate, zCoordinate) * radius;
+				vertex.Color = glm::vec3(0.75f, 0.75f, 0.75f);
+				vertex.Uv = glm::vec2(xSection, ySection * 0.25f);
+				vertex.Normal = glm::normalize(glm::vec3(xCoordinate, yCoordinate, zCoordinate));
+				vertices.push_back(vertex);
+			}
+		}
+
+		for (int y = 0; y < segments; ++y) {
+			for (int x = 0; x < segments; ++x) {
+				uint32_t topLeft = (y + 1) * (segments + 1) + x;
+				uint32_t bottomLeft = y * (segments + 1) + x;
+				uint32_t topRight = topLeft + 1;
+				uint32_t bottomRight = bottomLeft + 1;
+
+				indices.push_back(topLeft);
+				indices.push_back(bottomLeft);
+				indices.push_back(topRight);
+				indices.push_back(bottomLeft);
+				indices.push_back(bottomRight);
+				indices.push_back(topRight);
+			}
+		}
+	}
+}
+
+void Benchmarks::UniformLookup(uint32_t iterations)
+{
+	Shader shader{ std::string(uniformBenchVertex), std::string(uniformBenchFragment) };
+	shader.Bind();
+	const glm::mat4 matrix(1.0f);
+	const glm::vec3 vector(0.5f);
+	const size_t uniformCount = std::size(frameUniforms);
+
+	// old path: build a std::string and ask the driver for the location on every call
+	auto start = Clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		for (size_t u = 0; u < uniformCount; ++u) {
+			std::string name = frameUniforms[u];
+			GLint location = glGetUniformLocation(shader.Program(), name.c_str());
+			if (u < 3) {
+				glUniform3fv(location, 1, glm::value_ptr(vector));
+			}
+			else {
+				glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+			}
+		}
+	}
+	double driverNs = elapsedNs(start, Clock::now());
+
+	// cached table: string_view lookup in the uniform map, no allocation or driver round trip
+	start = Clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		for (size_t u = 0; u < uniformCount; ++u) {
+			if (u < 3) {
+				shader.SetVec3(frameUniforms[u], vector);
+			}
+			else {
+				shader.SetMat4(frameUniforms[u], matrix);
+			}
+		}
+	}
+	double cachedNs = elapsedNs(start, Clock::now());
+
+	// pre-resolved handles, resolved once before the loop
+	GLint locations[std::size(frameUniforms)];
+	for (size_t u = 0; u < uniformCount; ++u) {
+		locations[u] = shader.UniformLocation(frameUniforms[u]);
+	}
+	start = Clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		for (size_t u = 0; u < uniformCount; ++u) {
+			if (u < 3) {
+				shader.SetVec3(locations[u], vector);
+			}
+			else {
+				shader.SetMat4(locations[u], matrix);
+			}
+		}
+	}
+	double handleNs = elapsedNs(start, Clock::now());
+
+	double calls = static_cast<double>(iterations) * uniformCount;
+	std::cout << "Uniform upload, " << calls << " calls" << std::endl;
+	std::cout << "  glGetUniformLocation per call: " << driverNs / calls << " ns/call" << std::endl;
+	std::cout << "  cached name lookup:            " << cachedNs / calls << " ns/call" << std::endl;
+	std::cout << "  pre-resolved handle:           " << handleNs / calls << " ns/call" << std::endl;
+
+	GLState::ForgetProgram(shader.Program());
+	glDeleteProgram(shader.Program());
+}
+
+void Benchmarks::MeshLoad(const std::vector<MeshSource>& sources, const std::filesystem::path& directory, uint32_t iterations)
+{
+	const VertexFormat formats[] = { VertexFormats::Compact };
+	size_t totalBytes = 0;
+	for (const auto& source : sources) {
+		if (!MeshFile::Write(directory / (source.name + ".mesh"), source.vertices, source.indices, source.submeshes, 0, formats)) {
+			return;
+		}
+		totalBytes += source.vertices.size() * sizeof(Vertex) + source.indices.size() * sizeof(uint32_t);
+	}
+
+	// glFinish makes both paths pay for the upload instead of leaving it queued in the driver.
+	// The in-memory path packs the vertices on every load, the baked path uploads the packed stream from the mapping
+	auto start = Clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		for (const auto& source : sources) {
+			Mesh mesh(source.vertices, source.indices);
+			glFinish();
+			mesh.Destroy();
+		}
+	}
+	double memoryNs = elapsedNs(start, Clock::now());
+
+	double mapNs = 0.0;
+	start = Clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		for (const auto& source : sources) {
+			auto openStart = Clock::now();
+			MeshFile file;
+			if (!file.Open(directory / (source.name + ".mesh"))) {
+				return;
+			}
+			mapNs += elapsedNs(openStart, Clock::now());
+
+			PackedVertexView packed;
+			if (!file.PackedStream(VertexFormats::Compact, packed)) {
+				return;
+			}
+			Mesh mesh(packed, file.Indices());
+			glFinish();
+			mesh.Destroy();
+		}
+	}
+	double bakedNs = elapsedNs(start, Clock::now());
+
+	double loads = static_cast<double>(iterations) * sources.size();
+	std::cout << "Mesh load, " << sources.size() << " meshes x " << iterations << " iterations, " << totalBytes / 1024 << " KiB per pass" << std::endl;
+	std::cout << "  pack in-memory vectors and upload: " << memoryNs / loads / 1000.0 << " us/mesh" << std::endl;
+	std::cout << "  mapped packed stream to GL:        " << bakedNs / loads / 1000.0 << " us/mesh (open, map, and validate " << mapNs / loads / 1000.0 << " us)" << std::endl;
+}
+
+void Benchmarks::VertexFormats(std::span<const Vertex> vertices, std::span<const uint32_t> indices, uint32_t iterations)
+{
+	struct Candidate {
+		const char* name;
+		VertexFormat format;
+	};
+	const Candidate candidates[] = {
+		{ "standard", VertexFormats::Standard },
+		{ "compact", VertexFormats::Compact },
+		{ "compact, unorm16 uv", { PositionFormat::Half3, NormalFormat::Oct16, UvFormat::Unorm16 } }
+	};
+
+	std::cout << "Vertex formats, " << vertices.size() << " vertices, authored Vertex is " << sizeof(Vertex) << " bytes ("
+		<< vertices.size() * sizeof(Vertex) / 1024.0 << " KiB)" << std::endl;
+
+	for (const auto& candidate : candidates) {
+		PackedVertices packed = VertexPacking::Pack(vertices, candidate.format);
+
+		// read the packed data back the way the vertex shader does to measure the precision lost
+		float positionError = 0.0f, normalError = 0.0f;
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			const uint8_t* record = packed.data.data() + i * packed.layout.stride;
+			glm::vec3 position, normal;
+			if (candidate.format.position == PositionFormat::Half3) {
+				uint16_t halves[3];
+				std::memcpy(halves, record, sizeof(halves));
+				position = glm::vec3(glm::unpackHalf1x16(halves[0]), glm::unpackHalf1x16(halves[1]), glm::unpackHalf1x16(halves[2]));
+				position = position * packed.dequantScale + packed.dequantOffset;
+			}
+			else {
+				std::memcpy(&position, record, sizeof(position));
+			}
+
+			const uint8_t* normalRecord = record + packed.layout.attributes[1].offset;
+			if (candidate.format.normal == NormalFormat::Oct16) {
+				uint32_t oct;
+				std::memcpy(&oct, normalRecord, sizeof(oct));
+				normal = VertexPacking::OctDecode(oct);
+			}
+			else {
+				std::memcpy(&normal, normalRecord, sizeof(normal));
+			}
+
+			positionError = std::max(positionError, glm::length(position - vertices[i].Position));
+			if (glm::length(vertices[i].Normal) > 0.0f) {
+				float cosine = glm::clamp(glm::dot(glm::normalize(normal), glm::normalize(vertices[i].Normal)), -1.0f, 1.0f);
+				normalError = std::max(normalError, glm::degrees(std::acos(cosine)));
+			}
+		}
+
+		Mesh mesh(packed, indices);
+		mesh.Draw();
+		glFinish();
+		auto start = Clock::now();
+		for (uint32_t i = 0; i < iterations; ++i) {
+			mesh.Draw();
+		}
+		glFinish();
+		double drawNs = elapsedNs(start, Clock::now());
+		mesh.Destroy();
+
+		std::cout << "  " << candidate.name << ": " << packed.layout.stride << " bytes/vertex, " << packed.data.size() / 1024.0 << " KiB ("
+			<< 100.0 * packed.layout.stride / sizeof(Vertex) << "% of authored), max position error " << positionError
+			<< ", max normal error " << normalError << " deg, " << drawNs / iterations / 1000.0 << " us/draw" << std::endl;
+	}
+}
+
+void Benchmarks::Instancing(Mesh& mesh, Shader& shader, Shader& instancedShader)
+{
+	const uint32_t counts[] = { 1, 10, 100, 1000, 10000, 100000 };
+	const uint32_t maxCount = counts[std::size(counts) - 1];
+	const uint32_t repeats = 3;
+
+	// small copies on a grid in front of the default camera
+	std::vector<InstanceData> instances(maxCount);
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(maxCount))));
+	for (uint32_t i = 0; i < maxCount; ++i) {
+		glm::vec3 position(-2.0f + 4.0f * (i % side) / side, 0.0f, -3.0f + 3.0f * (i / side) / side);
+		instances[i].model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.01f));
+		instances[i].material = i % 4;
+	}
+
+	UniformRing objects;
+	objects.Create(sizeof(ObjectUniforms), maxCount + 1, 1);
+	InstanceBuffer instanceBuffer;
+	instanceBuffer.Create(maxCount);
+
+	// the first draw with each program compiles its variants in some drivers, keep that out of the timings
+	objects.BeginFrame();
+	ObjectUniforms warmup;
+	warmup.model = mesh.Dequantize();
+	objects.Bind(ObjectBinding, objects.Push(&warmup));
+	objects.Upload();
+	instanceBuffer.Update(std::span<const InstanceData>(instances.data(), 1));
+	shader.Bind();
+	mesh.Draw();
+	instancedShader.Bind();
+	mesh.DrawInstanced(instanceBuffer, 1);
+	glFinish();
+
+	std::cout << "Instancing, " << repeats << " repeats per count" << std::endl;
+	for (uint32_t count : counts) {
+		// one uniform record and draw call per copy, like App::draw
+		shader.Bind();
+		glFinish();
+		auto start = Clock::now();
+		for (uint32_t r = 0; r < repeats; ++r) {
+			objects.BeginFrame();
+			for (uint32_t i = 0; i < count; ++i) {
+				ObjectUniforms object;
+				object.model = instances[i].model * mesh.Dequantize();
+				object.normalMatrix = glm::transpose(glm::inverse(instances[i].model));
+				object.vertexFormat.x = mesh.HasOctNormals() ? 1u : 0u;
+				objects.Push(&object);
+			}
+			objects.Upload();
+			for (uint32_t i = 0; i < count; ++i) {
+				objects.Bind(ObjectBinding, i);
+				mesh.Draw();
+			}
+			glFinish();
+		}
+		double separateNs = elapsedNs(start, Clock::now()) / repeats;
+
+		// the transforms go up as one array and are drawn with a single call
+		instancedShader.Bind();
+		glFinish();
+		start = Clock::now();
+		for (uint32_t r = 0; r < repeats; ++r) {
+			objects.BeginFrame();
+			ObjectUniforms meshData;
+			meshData.model = mesh.Dequantize();
+			meshData.vertexFormat.x = mesh.HasOctNormals() ? 1u : 0u;
+			objects.Bind(ObjectBinding, objects.Push(&meshData));
+			objects.Upload();
+
+			instanceBuffer.Update(std::span<const InstanceData>(instances.data(), count));
+			mesh.DrawInstanced(instanceBuffer, count);
+			glFinish();
+		}
+		double instancedNs = elapsedNs(start, Clock::now()) / repeats;
+
+		std::cout << "  " << count << " instances: separate draws " << separateNs / 1.0e6 << " ms (" << count << " calls), instanced "
+			<< instancedNs / 1.0e6 << " ms (1 call), " << separateNs / instancedNs << "x" << std::endl;
+	}
+
+	instanceBuffer.Destroy();
+	objects.Destroy();
+}
+
+void Benchmarks::MultiDraw(const std::vector<MeshSource>& sources, Shader& shader, Shader& instancedShader)
+{
+	const uint32_t counts[] = { 100, 1000, 10000 };
+	const uint32_t maxCount = counts[std::size(counts) - 1];
+	const uint32_t bucketCount = 2; // stands in for two program and texture combinations
+	const uint32_t repeats = 3;
+
+	std::vector<Mesh> meshes;
+	GeometryArena arena;
+	arena.Create(1u << 16, 1u << 18, maxCount);
+	std::vector<ArenaMesh> arenaMeshes;
+	for (const auto& source : sources) {
+		meshes.emplace_back(source.vertices, source.indices); // same triangle order as the arena copy
+		arenaMeshes.push_back(arena.Add(source.vertices, source.indices));
+	}
+
+	std::vector<glm::mat4> transforms(maxCount);
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(maxCount))));
+	for (uint32_t i = 0; i < maxCount; ++i) {
+		glm::vec3 position(-2.0f + 4.0f * (i % side) / side, 0.0f, -3.0f + 3.0f * (i / side) / side);
+		transforms[i] = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.01f));
+	}
+
+	UniformRing objects;
+	objects.Create(sizeof(ObjectUniforms), maxCount + 1, 1);
+
+	std::cout << "Multi-draw indirect, " << sources.size() << " meshes in " << bucketCount << " buckets, " << repeats << " repeats per count" << std::endl;
+	for (uint32_t count : counts) {
+		// a uniform record, VAO bind, and draw call per object, grouped by bucket like a sorted render queue
+		shader.Bind();
+		glFinish();
+		GLState::ResetFrameCounters();
+		auto start = Clock::now();
+		for (uint32_t r = 0; r < repeats; ++r) {
+			objects.BeginFrame();
+			for (uint32_t i = 0; i < count; ++i) {
+				const Mesh& mesh = meshes[i % meshes.size()];
+				ObjectUniforms object;
+				object.model = transforms[i] * mesh.Dequantize();
+				object.normalMatrix = glm::transpose(glm::inverse(transforms[i]));
+				object.vertexFormat.x = mesh.HasOctNormals() ? 1u : 0u;
+				objects.Push(&object);
+			}
+			objects.Upload();
+			for (uint32_t bucket = 0; bucket < bucketCount; ++bucket) {
+				for (uint32_t i = bucket; i < count; i += bucketCount) {
+					objects.Bind(ObjectBinding, i);
+					meshes[i % meshes.size()].Draw();
+				}
+			}
+			glFinish();
+		}
+		double separateNs = elapsedNs(start, Clock::now()) / repeats;
+		uint32_t separateDraws = GLState::FrameCounters().draws / repeats;
+
+		instancedShader.Bind();
+		glFinish();
+		GLState::ResetFrameCounters();
+		start = Clock::now();
+		for (uint32_t r = 0; r < repeats; ++r) {
+			arena.BeginFrame();
+			for (uint32_t i = 0; i < count; ++i) {
+				arena.Record(i % bucketCount, arenaMeshes[i % arenaMeshes.size()], transforms[i]);
+			}
+			arena.Upload();
+
+			objects.BeginFrame();
+			ObjectUniforms arenaData;
+			arenaData.vertexFormat.x = arena.HasOctNormals() ? 1u : 0u;
+			objects.Bind(ObjectBinding, objects.Push(&arenaData));
+			objects.Upload();
+
+			for (uint32_t bucket = 0; bucket < bucketCount; ++bucket) {
+				arena.Submit(bucket);
+			}
+			glFinish();
+		}
+		double arenaNs = elapsedNs(start, Clock::now()) / repeats;
+		uint32_t arenaDraws = GLState::FrameCounters().draws / repeats;
+
+		std::cout << "  " << count << " objects: per object " << separateNs / 1.0e6 << " ms (" << separateDraws << " draws), arena "
+			<< arenaNs / 1.0e6 << " ms (" << arenaDraws << " draws), " << separateNs / arenaNs << "x" << std::endl;
+	}
+
+	// fill the arena with copies, then free every other one to show how the free space breaks up and recombines
+	std::vector<ArenaMesh> copies;
+	for (uint32_t i = 0; i < 32; ++i) {
+		const MeshSource& source = sources[i % sources.size()];
+		copies.push_back(arena.Add(source.vertices, source.indices));
+	}
+	std::cout << "  after adding " << copies.size() << " copies: ";
+	arena.PrintReport();
+	for (size_t i = 0; i < copies.size(); i += 2) {
+		arena.Remove(copies[i]);
+	}
+	std::cout << "  after removing every other copy: ";
+	arena.PrintReport();
+	for (size_t i = 1; i < copies.size(); i += 2) {
+		arena.Remove(copies[i]);
+	}
+	std::cout << "  after removing the rest: ";
+	arena.PrintReport();
+
+	objects.Destroy();
+	arena.Destroy();
+	for (auto& mesh : meshes) {
+		mesh.Destroy();
+	}
+}
+
+void Benchmarks::SceneGraphUpdate(uint32_t frames)
+{
+	// 500 roots, each with 10 children that carry 9 leaves each
+	const uint32_t roots = 500, children = 10, leaves = 9;
+	SceneGraph graph;
+	graph.Reserve(roots * (1 + children * (1 + leaves)));
+
+	std::vector<NodeId> rootNodes, childNodes;
+	for (uint32_t r = 0; r < roots; ++r) {
+		NodeId root = graph.AddNode(glm::translate(glm::mat4(1.0f), glm::vec3(r % 25, 0.0f, r / 25)));
+		rootNodes.push_back(root);
+		for (uint32_t c = 0; c < children; ++c) {
+			NodeId child = graph.AddNode(glm::rotate(glm::mat4(1.0f), glm::radians(36.0f * c), glm::vec3(0, 1, 0)), root);
+			childNodes.push_back(child);
+			for (uint32_t l = 0; l < leaves; ++l) {
+				graph.AddNode(glm::translate(glm::mat4(1.0f), glm::vec3(0.1f * l, 0.0f, 0.0f)), child);
+			}
+		}
+	}
+
+	std::cout << "Scene graph, " << graph.Size() << " nodes, " << frames << " frames" << std::endl;
+
+	// every node recomputed every frame
+	auto start = Clock::now();
+	for (uint32_t frame = 0; frame < frames; ++frame) {
+		graph.UpdateAll();
+	}
+	double fullNs = elapsedNs(start, Clock::now()) / frames;
+	std::cout << "  recompute all:           " << fullNs / 1.0e6 << " ms/frame, " << fullNs / graph.Size() << " ns/node" << std::endl;
+
+	// a few moving parts, the rest of the scene stays put
+	struct Case {
+		const char* name;
+		const std::vector<NodeId>* nodes;
+		uint32_t step; // animate every step-th node of the list
+	};
+	const Case cases[] = {
+		{ "10% of children moving", &childNodes, 10 },
+		{ "every child moving", &childNodes, 1 },
+		{ "every root moving", &rootNodes, 1 }
+	};
+	for (const auto& test : cases) {
+		uint32_t updated = 0;
+		start = Clock::now();
+		for (uint32_t frame = 0; frame < frames; ++frame) {
+			glm::mat4 spin = glm::rotate(glm::mat4(1.0f), 0.01f * frame, glm::vec3(0, 1, 0));
+			for (size_t i = 0; i < test.nodes->size(); i += test.step) {
+				NodeId node = (*test.nodes)[i];
+				graph.SetLocal(node, spin * graph.Local(node));
+			}
+			updated = graph.Update();
+		}
+		double dirtyNs = elapsedNs(start, Clock::now()) / frames;
+		std::cout << "  " << test.name << ": " << dirtyNs / 1.0e6 << " ms/frame, " << updated << " nodes recomputed" << std::endl;
+	}
+}
+
+void Benchmarks::FrustumCulling(uint32_t frames)
+{
+	const uint32_t counts[] = { 1000, 10000, 100000 };
+
+	// objects scattered around a camera at the origin looking down -z
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+	glm::mat4 projection = glm::perspective(glm::radians(75.f), 800.0f / 600.0f, 0.1f, 100.f);
+
+	std::cout << "Frustum culling, " << frames << " frames per count, SIMD path is " << FrustumCuller::SimdName() << std::endl;
+	for (uint32_t count : counts) {
+		FrustumCuller culler;
+		culler.Reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			culler.Add({ glm::vec3(position(random), position(random), position(random)), size(random) });
+		}
+
+		std::vector<uint32_t> visible;
+		double scalarMs = 0.0, simdMs = 0.0;
+		CullStats stats;
+		for (uint32_t frame = 0; frame < frames; ++frame) {
+			// the camera turns a little every frame
+			glm::mat4 view = glm::rotate(glm::mat4(1.0f), 0.05f * frame, glm::vec3(0.0f, 1.0f, 0.0f));
+			Frustum frustum = Frustum::FromMatrix(projection * view);
+			CullStats scalar = culler.Cull(frustum, visible, CullMode::Scalar);
+			stats = culler.Cull(frustum, visible, CullMode::Simd);
+			scalarMs += scalar.ms;
+			simdMs += stats.ms;
+			if (scalar.visible != stats.visible) {
+				std::cerr << "Scalar and SIMD culling disagree: " << scalar.visible << " vs " << stats.visible << " visible" << std::endl;
+			}
+		}
+
+		std::cout << "  " << count << " objects: " << stats.visible << " visible, " << stats.culled << " culled, scalar "
+			<< scalarMs / frames << " ms/frame, SIMD " << simdMs / frames << " ms/frame, " << scalarMs / simdMs << "x" << std::endl;
+	}
+}
+
+void Benchmarks::BvhBuild(uint32_t rays)
+{
+	const uint32_t counts[] = { 10000, 100000, 1000000 };
+	glm::mat4 projection = glm::perspective(glm::radians(75.f), 800.0f / 600.0f, 0.1f, 100.f);
+
+	std::cout << "BVH, " << sizeof(BvhNode) << " byte nodes, " << rays << " rays per count" << std::endl;
+	for (uint32_t count : counts) {
+		// the volume grows with the count so the density stays about the same
+		std::mt19937 random(1234);
+		float extent = 10.0f * std::cbrt(static_cast<float>(count));
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> size(0.1f, 2.0f);
+		std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+
+		std::vector<MeshBounds> bounds(count);
+		for (auto& box : bounds) {
+			glm::vec3 center(position(random), position(random), position(random));
+			glm::vec3 half(size(random), size(random), size(random));
+			box = { center - half, center + half };
+		}
+
+		Bvh bvh;
+		auto start = Clock::now();
+		bvh.Build(bounds);
+		double buildMs = elapsedNs(start, Clock::now()) / 1.0e6;
+
+		// every object moves a little, the refit keeps the tree shape
+		for (auto& box : bounds) {
+			glm::vec3 offset(step(random), step(random), step(random));
+			box.min += offset;
+			box.max += offset;
+		}
+		start = Clock::now();
+		bvh.Refit(bounds);
+		double refitMs = elapsedNs(start, Clock::now()) / 1.0e6;
+
+		// the same frustum swept over every box for comparison
+		Frustum frustum = Frustum::FromMatrix(projection);
+		std::vector<uint32_t> visible;
+		start = Clock::now();
+		bvh.QueryFrustum(frustum, visible);
+		double queryMs = elapsedNs(start, Clock::now()) / 1.0e6;
+
+		size_t sweepVisible = 0;
+		start = Clock::now();
+		for (const auto& box : bounds) {
+			glm::vec3 center = box.Center(), extents = box.Extents();
+			bool inside = true;
+			for (const auto& plane : frustum.planes) {
+				if (glm::dot(glm::vec3(plane), center) + plane.w < -glm::dot(glm::abs(glm::vec3(plane)), extents)) {
+					inside = false;
+					break;
+				}
+			}
+			sweepVisible += inside ? 1 : 0;
+		}
+		double sweepMs = elapsedNs(start, Clock::now()) / 1.0e6;
+		if (sweepVisible != visible.size()) {
+			std::cerr << "BVH and sweep culling disagree: " << visible.size() << " vs " << sweepVisible << " visible" << std::endl;
+		}
+
+		// rays from random points toward random points, like picking from a camera inside the scene
+		std::vector<Ray> queries(rays);
+		for (auto& ray : queries) {
+			ray.origin = glm::vec3(position(random), position(random), position(random));
+			ray.direction = glm::normalize(glm::vec3(position(random), position(random), position(random)) - ray.origin);
+		}
+		uint32_t hits = 0;
+		start = Clock::now();
+		for (const auto& ray : queries) {
+			uint32_t item;
+			float distance;
+			hits += bvh.Raycast(ray, bounds, item, distance) ? 1 : 0;
+		}
+		double rayMs = elapsedNs(start, Clock::now()) / 1.0e6;
+
+		std::cout << "  " << count << " objects, " << bvh.Nodes().size() << " nodes: build " << buildMs << " ms, refit " << refitMs
+			<< " ms, frustum " << queryMs << " ms (sweep " << sweepMs << " ms, " << visible.size() << " visible), "
+			<< rays / (rayMs / 1000.0) / 1.0e6 << " Mrays/s (" << hits << " hits)" << std::endl;
+	}
+}
+
+void Benchmarks::TriangleRaycast(uint32_t rays)
+{
+	const int segmentCounts[] = { 32, 128, 512, 1024 };
+
+	std::cout << "Triangle raycast, " << TriangleBvh::SimdName() << " kernel, " << rays << " rays per mesh" << std::endl;
+	for (int segments : segmentCounts) {
+		std::vector<Vertex> vertices = Shapes::conjoinBothVertices(0.1f, 1.0f, segments, 0.15f, segments);
+		std::vector<uint32_t> indices = Shapes::conjoinBothIndices(segments, segments);
+
+		TriangleBvh bvh;
+		auto start = Clock::now();
+		bvh.Build(vertices, indices);
+		double buildMs = elapsedNs(start, Clock::now()) / 1.0e6;
+
+		// rays from a sphere around the mesh aimed at random points inside its box, so most of them hit
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f), along(0.0f, 1.0f);
+		glm::vec3 center = bvh.Bounds().Center();
+		glm::vec3 extents = bvh.Bounds().Extents();
+		float radius = glm::length(extents) * 2.0f;
+		std::vector<Ray> queries(rays);
+		for (auto& ray : queries) {
+			glm::vec3 direction(unit(random), unit(random), unit(random));
+			ray.origin = center + glm::normalize(direction + glm::vec3(0.0f, 1.0e-4f, 0.0f)) * radius;
+			glm::vec3 target = center + extents * glm::vec3(unit(random), unit(random), unit(random));
+			ray.direction = glm::normalize(target - ray.origin);
+		}
+
+		uint32_t closestHits = 0, anyHits = 0;
+		start = Clock::now();
+		for (const auto& ray : queries) {
+			RayHit hit;
+			closestHits += bvh.Intersect(ray, hit) ? 1 : 0;
+		}
+		double closestMs = elapsedNs(start, Clock::now()) / 1.0e6;
+
+		start = Clock::now();
+		for (const auto& ray : queries) {
+			anyHits += bvh.Occluded(ray) ? 1 : 0;
+		}
+		double anyMs = elapsedNs(start, Clock::now()) / 1.0e6;
+		if (closestHits != anyHits) {
+			std::cerr << "Closest and any hit disagree: " << closestHits << " vs " << anyHits << " hits" << std::endl;
+		}
+
+		std::cout << "  " << bvh.TriangleCount() << " triangles: build " << buildMs << " ms, closest hit " << rays / (closestMs / 1000.0) / 1.0e6
+			<< " Mrays/s, any hit " << rays / (anyMs / 1000.0) / 1.0e6 << " Mrays/s, " << closestHits << " hits" << std::endl;
+	}
+}
+
+void Benchmarks::PathTraceScaling(PathTracer& tracer)
+{
+	PathTraceOptions options;
+	options.width = 320;
+	options.height = 240;
+	options.samples = 4;
+
+	size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << "Path tracer scaling, " << options.width << "x" << options.height << " at " << options.samples << " samples per pixel, "
+		<< hardwareThreads << " hardware threads" << std::endl;
+
+	// the calling thread works on tiles too, so a pool of n workers renders on n + 1 threads
+	double baseline = 0.0;
+	Image image;
+	for (size_t workers = 1;; workers = std::min(workers * 2, hardwareThreads)) {
+		ThreadPool pool(workers);
+		PathTraceStats stats = tracer.Render(pool, options, image);
+		double samplesPerSecond = stats.SamplesPerSecond();
+		if (baseline == 0.0) {
+			baseline = samplesPerSecond;
+		}
+		std::cout << "  " << stats.threads << " threads: " << stats.ms << " ms, " << samplesPerSecond / 1.0e6 << " Msamples/s, "
+			<< samplesPerSecond / baseline << "x" << std::endl;
+		if (workers == hardwareThreads) {
+			break;
+		}
+	}
+}
+
+void Benchmarks::SoftRaster(SoftRasterizer& rasterizer, ThreadPool& pool, std::span<const RasterFrame> frames, uint32_t width, uint32_t height)
+{
+	Image image;
+	RasterStats total;
+	for (const auto& frame : frames) {
+		RasterStats stats = rasterizer.Render(pool, frame, width, height, image);
+		total.vertexMs += stats.vertexMs;
+		total.binMs += stats.binMs;
+		total.rasterMs += stats.rasterMs;
+		total.totalMs += stats.totalMs;
+		total.triangles += stats.triangles;
+		total.blocksTested += stats.blocksTested;
+		total.blocksSkipped += stats.blocksSkipped;
+	}
+
+	double count = static_cast<double>(frames.size());
+	std::cout << "Software rasterizer, " << width << "x" << height << ", " << SoftRasterizer::SimdName() << ", " << pool.ThreadCount() + 1 << " threads, "
+		<< frames.size() << " frames" << std::endl;
+	std::cout << "  " << total.totalMs / count << " ms/frame (" << 1000.0 * count / total.totalMs << " fps): vertex " << total.vertexMs / count
+		<< " ms, bin " << total.binMs / count << " ms, raster " << total.rasterMs / count << " ms, " << total.triangles / count << " triangles, "
+		<< 100.0 * total.blocksSkipped / std::max<uint64_t>(total.blocksTested, 1) << "% of blocks skipped by depth" << std::endl;
+}
+
+void Benchmarks::ShapeGeneration(ThreadPool& pool)
+{
+	const int segmentCounts[] = { 256, 1024, 4096 };
+
+	std::cout << "Sphere generation, " << pool.ThreadCount() << " worker threads" << std::endl;
+	for (int segments : segmentCounts) {
+		ShapeGenerators::ShapeCounts counts = ShapeGenerators::SphereCounts(segments);
+
+		auto start = Clock::now();
+		{
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			baselineSphere(1.0f, segments, vertices, indices);
+		}
+		double baselineMs = elapsedNs(start, Clock::now()) / 1.0e6;
+
+		// the exact size wrappers, includes allocating and zeroing the vectors
+		start = Clock::now();
+		{
+			std::vector<Vertex> vertices = Shapes::makeSphereVertices(1.0f, segments);
+			std::vector<uint32_t> indices = Shapes::makeSphereIndices(segments);
+		}
+		double allocatingMs = elapsedNs(start, Clock::now()) / 1.0e6;
+
+		// the buffers are touched once first so page faults are not counted
+		std::vector<Vertex> vertices(counts.vertices);
+		std::vector<uint32_t> indices(counts.indices);
+
+		start = Clock::now();
+		ShapeGenerators::WriteSphereVertices(vertices, 1.0f, segments);
+		ShapeGenerators::WriteSphereIndices(indices, segments);
+		double serialMs = elapsedNs(start, Clock::now()) / 1.0e6;
+
+		start = Clock::now();
+		ShapeGenerators::WriteSphereVertices(vertices, 1.0f, segments, glm::vec3(0.0f), &pool);
+		ShapeGenerators::WriteSphereIndices(indices, segments, 0, &pool);
+		double parallelMs = elapsedNs(start, Clock::now()) / 1.0e6;
+
+		std::cout << "  " << segments << "x" << segments << ": " << counts.vertices << " vertices, " << counts.indices / 3 << " triangles, "
+			<< (counts.vertices * sizeof(Vertex) + counts.indices * sizeof(uint32_t)) / (1024 * 1024) << " MiB: push_back baseline " << baselineMs
+			<< " ms, exact size " << allocatingMs << " ms, reused buffers " << serialMs << " ms, parallel " << parallelMs << " ms" << std::endl;
+	}
+}
+
+void Benchmarks::LevelOfDetail(uint32_t objectCount, uint32_t frames)
+{
+	// the quadric simplifier on a mesh with no parametric levels
+	const ShapeGenerators::GeneratedMesh& sphere = ShapeGenerators::Sphere(1.0f, 128);
+	auto start = Clock::now();
+	std::vector<LodLevel> simplified = MeshLod::BuildChain(sphere.vertices, sphere.indices, 6);
+	double simplifyMs = elapsedNs(start, Clock::now()) / 1.0e6;
+
+	std::cout << "Level of detail, simplified a " << sphere.indices.size() / 3 << " triangle sphere in " << simplifyMs << " ms:";
+	for (const LodLevel& level : simplified) {
+		std::cout << " " << level.indices.size() / 3 << " (error " << level.error << ")";
+	}
+	std::cout << std::endl;
+
+	// the scene's sphere and cylinder with its parametric chain
+	const ShapeGenerators::GeneratedMesh& both = Shapes::both();
+	std::vector<LodLevel> levels = MeshLod::SphereCylinderChain(0.1f, 1.0f, 0.15f, Shapes::bothSegments);
+	std::vector<float> errors{ 0.0f };
+	std::vector<size_t> triangles{ both.indices.size() / 3 };
+	for (const LodLevel& level : levels) {
+		errors.push_back(level.error);
+		triangles.push_back(level.indices.size() / 3);
+	}
+
+	// objects scattered up to 200 units in front of a camera that dollies back and forth, at 1080p with the scene's 75 degree lens
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> across(-60.0f, 60.0f), ahead(-200.0f, 0.0f), scale(0.5f, 3.0f);
+	struct Object {
+		glm::vec3 position;
+		float scale;
+		uint32_t lod;
+		uint32_t lodNoHysteresis;
+	};
+	std::vector<Object> objects(objectCount);
+	for (auto& object : objects) {
+		object = { glm::vec3(across(random), across(random) * 0.1f, ahead(random)), scale(random), 0, 0 };
+	}
+
+	glm::mat4 projection = glm::perspective(glm::radians(75.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+	const float radius = 0.6f; // about the mesh's bounding sphere
+	double fullTriangles = 0.0, lodTriangles = 0.0;
+	uint64_t switches = 0, switchesNoHysteresis = 0;
+	std::vector<uint64_t> levelUses(errors.size(), 0);
+	for (uint32_t frame = 0; frame < frames; ++frame) {
+		glm::vec3 camera(0.0f, 1.0f, 10.0f - 2.0f * std::sin(frame * 0.1f));
+		for (auto& object : objects) {
+			float distance = glm::length(object.position - camera) - radius * object.scale;
+			float pixelsPerUnit = MeshLod::PixelsPerUnit(projection, 1080.0f, distance) * object.scale;
+
+			uint32_t level = MeshLod::SelectLevel(errors, pixelsPerUnit, object.lod);
+			switches += frame > 0 && level != object.lod;
+			object.lod = level;
+
+			// with the current level pinned above every candidate, selection has no memory
+			uint32_t plain = MeshLod::SelectLevel(errors, pixelsPerUnit, static_cast<uint32_t>(errors.size()));
+			switchesNoHysteresis += frame > 0 && plain != object.lodNoHysteresis;
+			object.lodNoHysteresis = plain;
+
+			fullTriangles += static_cast<double>(triangles[0]);
+			lodTriangles += static_cast<double>(triangles[level]);
+			++levelUses[level];
+		}
+	}
+
+	std::cout << "  " << objectCount << " objects over " << frames << " frames, triangles/frame " << fullTriangles / frames << " full detail, "
+		<< lodTriangles / frames << " with levels (" << fullTriangles / std::max(lodTriangles, 1.0) << "x fewer), level switches "
+		<< switches << " with hysteresis, " << switchesNoHysteresis << " without" << std::endl;
+	std::cout << "  level use:";
+	for (size_t level = 0; level < levelUses.size(); ++level) {
+		std::cout << " " << level << ": " << triangles[level] << " triangles, " << 100.0 * levelUses[level] / (static_cast<double>(objectCount) * frames) << "%";
+	}
+	std::cout << std::endl;
+}
+
+void Benchmarks::MeshOptimization()
+{
+	const int segmentCounts[] = { 32, 128, 512 };
+
+	std::cout << "Mesh optimization, FIFO cache of " << MeshOptimizer::ReportCacheSize << " vertices" << std::endl;
+	for (int segments : segmentCounts) {
+		const ShapeGenerators::GeneratedMesh& mesh = ShapeGenerators::SphereCylinder(0.1f, 1.0f, segments, 0.15f, segments);
+		std::vector<Vertex> vertices = mesh.vertices;
+		std::vector<uint32_t> indices = mesh.indices;
+
+		auto start = Clock::now();
+		size_t welded = MeshOptimizer::WeldVertices(vertices, indices);
+		double weldMs = elapsedNs(start, Clock::now()) / 1.0e6;
+		MeshOptimizer::CacheStats before = MeshOptimizer::AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+
+		start = Clock::now();
+		MeshOptimizer::OptimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+		double cacheMs = elapsedNs(start, Clock::now()) / 1.0e6;
+		MeshOptimizer::CacheStats cacheOnly = MeshOptimizer::AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+
+		start = Clock::now();
+		MeshOptimizer::OptimizeOverdraw(indices, vertices);
+		MeshOptimizer::OptimizeVertexFetch(vertices, indices);
+		double restMs = elapsedNs(start, Clock::now()) / 1.0e6;
+		MeshOptimizer::CacheStats after = MeshOptimizer::AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+
+		std::cout << "  " << segments << " segments, " << indices.size() / 3 << " triangles: ACMR " << before.acmr << " -> " << cacheOnly.acmr
+			<< " (" << after.acmr << " with overdraw clusters), ATVR " << before.atvr << " -> " << after.atvr
+			<< ", welded " << welded << " of " << mesh.vertices.size() << " vertices in " << weldMs << " ms, vertex cache " << cacheMs
+			<< " ms, overdraw and fetch " << restMs << " ms, " << (vertices.size() <= 65536 ? 2 : 4) << " byte indices" << std::endl;
+	}
+}
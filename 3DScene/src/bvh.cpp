@@ -0,0 +1,278 @@
+/*
+*
+* Defines the binned SAH build, refit, and frustum and ray traversal of the bounding volume hierarchy
+*
+*/
+
+#include <bvh.h>
+#include <algorithm>
+
+namespace {
+	constexpr uint32_t BinCount = 12;
+	constexpr float TraversalCost = 1.0f; // visiting a node, relative to testing one item
+	constexpr float Infinity = std::numeric_limits<float>::infinity();
+
+	struct Bin {
+		glm::vec3 min{ Infinity };
+		glm::vec3 max{ -Infinity };
+		uint32_t count{ 0 };
+	};
+
+	float surfaceArea(const glm::vec3& min, const glm::vec3& max)
+	{
+		glm::vec3 size = max - min;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+}
+
+float IntersectBounds(const Ray& ray, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max)
+{
+	glm::vec3 t0 = (min - ray.origin) * inverseDirection;
+	glm::vec3 t1 = (max - ray.origin) * inverseDirection;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, ray.tMax));
+	return enter <= exit ? enter : Infinity;
+}
+
+void Bvh::Build(std::span<const MeshBounds> itemBounds, uint32_t maxLeafSize, uint32_t testWidth)
+{
+	nodes.clear();
+	items.resize(itemBounds.size());
+	if (itemBounds.empty()) {
+		return;
+	}
+
+	std::vector<glm::vec3> centroids(itemBounds.size());
+	for (size_t i = 0; i < itemBounds.size(); ++i) {
+		items[i] = static_cast<uint32_t>(i);
+		centroids[i] = itemBounds[i].Center();
+	}
+
+	// a binary tree with n leaves has 2n - 1 nodes
+	nodes.reserve(2 * itemBounds.size());
+	BvhNode& root = nodes.emplace_back();
+	root.leftOrFirst = 0;
+	root.count = static_cast<uint32_t>(itemBounds.size());
+	split(0, itemBounds, centroids, std::max(maxLeafSize, 1u), std::max(testWidth, 1u));
+	nodes.shrink_to_fit();
+}
+
+void Bvh::split(uint32_t rootIndex, std::span<const MeshBounds> itemBounds, std::span<const glm::vec3> centroids, uint32_t maxLeafSize, uint32_t testWidth)
+{
+	// testing a leaf costs one call per testWidth items, a wide kernel pays the same for a full leaf as for one item
+	auto testCost = [testWidth](uint32_t count) {
+		return static_cast<float>((count + testWidth - 1) / testWidth);
+	};
+
+	std::vector<std::pair<uint32_t, uint32_t>> pending{ { rootIndex, 0 } };
+	while (!pending.empty()) {
+		auto [nodeIndex, depth] = pending.back();
+		pending.pop_back();
+
+		uint32_t first = nodes[nodeIndex].leftOrFirst;
+		uint32_t count = nodes[nodeIndex].count;
+
+		glm::vec3 nodeMin(Infinity), nodeMax(-Infinity);
+		glm::vec3 centroidMin(Infinity), centroidMax(-Infinity);
+		for (uint32_t i = first; i < first + count; ++i) {
+			const MeshBounds& bounds = itemBounds[items[i]];
+			nodeMin = glm::min(nodeMin, bounds.min);
+			nodeMax = glm::max(nodeMax, bounds.max);
+			centroidMin = glm::min(centroidMin, centroids[items[i]]);
+			centroidMax = glm::max(centroidMax, centroids[items[i]]);
+		}
+		nodes[nodeIndex].min = nodeMin;
+		nodes[nodeIndex].max = nodeMax;
+
+		if (count <= 1) {
+			continue;
+		}
+
+		// pick the cheapest of the bin boundaries on all three axes
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		float bestCost = Infinity;
+		for (int axis = 0; axis < 3; ++axis) {
+			float extent = centroidMax[axis] - centroidMin[axis];
+			if (extent <= 0.0f) {
+				continue;
+			}
+
+			Bin bins[BinCount];
+			float scale = BinCount / extent;
+			for (uint32_t i = first; i < first + count; ++i) {
+				uint32_t bin = std::min(BinCount - 1, static_cast<uint32_t>((centroids[items[i]][axis] - centroidMin[axis]) * scale));
+				bins[bin].min = glm::min(bins[bin].min, itemBounds[items[i]].min);
+				bins[bin].max = glm::max(bins[bin].max, itemBounds[items[i]].max);
+				++bins[bin].count;
+			}
+
+			// sweep from both ends so each boundary's cost comes from prefix and suffix boxes
+			float leftArea[BinCount - 1], rightArea[BinCount - 1];
+			uint32_t leftCount[BinCount - 1], rightCount[BinCount - 1];
+			glm::vec3 leftMin(Infinity), leftMax(-Infinity), rightMin(Infinity), rightMax(-Infinity);
+			uint32_t leftSum = 0, rightSum = 0;
+			for (uint32_t i = 0; i < BinCount - 1; ++i) {
+				leftSum += bins[i].count;
+				leftCount[i] = leftSum;
+				leftMin = glm::min(leftMin, bins[i].min);
+				leftMax = glm::max(leftMax, bins[i].max);
+				leftArea[i] = leftSum > 0 ? surfaceArea(leftMin, leftMax) : 0.0f;
+
+				uint32_t j = BinCount - 1 - i;
+				rightSum += bins[j].count;
+				rightCount[j - 1] = rightSum;
+				rightMin = glm::min(rightMin, bins[j].min);
+				rightMax = glm::max(rightMax, bins[j].max);
+				rightArea[j - 1] = rightSum > 0 ? surfaceArea(rightMin, rightMax) : 0.0f;
+			}
+
+			for (uint32_t i = 0; i < BinCount - 1; ++i) {
+				if (leftCount[i] == 0 || rightCount[i] == 0) {
+					continue;
+				}
+				float cost = leftArea[i] * testCost(leftCount[i]) + rightArea[i] * testCost(rightCount[i]);
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = i;
+				}
+			}
+		}
+
+		// keep the leaf when splitting would not be cheaper than testing every item, and stop at the
+		// depth the traversal stacks are sized for
+		float nodeArea = surfaceArea(nodeMin, nodeMax);
+		float leafCost = nodeArea * testCost(count);
+		bool splitPays = bestAxis >= 0 && nodeArea * TraversalCost + bestCost < leafCost;
+		if ((count <= maxLeafSize && !splitPays) || depth + 1 >= MaxDepth) {
+			continue;
+		}
+
+		uint32_t leftItems = 0;
+		if (bestAxis >= 0) {
+			float scale = BinCount / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+			auto middle = std::partition(items.begin() + first, items.begin() + first + count, [&](uint32_t item) {
+				uint32_t bin = std::min(BinCount - 1, static_cast<uint32_t>((centroids[item][bestAxis] - centroidMin[bestAxis]) * scale));
+				return bin <= bestSplit;
+			});
+			leftItems = static_cast<uint32_t>(middle - (items.begin() + first));
+		}
+		else {
+			// every centroid is the same point, split the range in half so leaves stay small
+			leftItems = count / 2;
+		}
+
+		uint32_t leftIndex = static_cast<uint32_t>(nodes.size());
+		BvhNode left, right;
+		left.leftOrFirst = first;
+		left.count = leftItems;
+		right.leftOrFirst = first + leftItems;
+		right.count = count - leftItems;
+		nodes.push_back(left);
+		nodes.push_back(right);
+
+		nodes[nodeIndex].leftOrFirst = leftIndex;
+		nodes[nodeIndex].count = 0;
+		pending.push_back({ leftIndex + 1, depth + 1 });
+		pending.push_back({ leftIndex, depth + 1 });
+	}
+}
+
+void Bvh::Refit(std::span<const MeshBounds> itemBounds)
+{
+	// children always follow their parent, so walking backwards sees them first
+	for (size_t i = nodes.size(); i-- > 0;) {
+		BvhNode& node = nodes[i];
+		glm::vec3 nodeMin(Infinity), nodeMax(-Infinity);
+		if (node.IsLeaf()) {
+			for (uint32_t j = node.leftOrFirst; j < node.leftOrFirst + node.count; ++j) {
+				nodeMin = glm::min(nodeMin, itemBounds[items[j]].min);
+				nodeMax = glm::max(nodeMax, itemBounds[items[j]].max);
+			}
+		}
+		else {
+			const BvhNode& left = nodes[node.leftOrFirst];
+			const BvhNode& right = nodes[node.leftOrFirst + 1];
+			nodeMin = glm::min(left.min, right.min);
+			nodeMax = glm::max(left.max, right.max);
+		}
+		node.min = nodeMin;
+		node.max = nodeMax;
+	}
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+	if (nodes.empty()) {
+		return;
+	}
+
+	// each entry carries the planes its box still straddles, subtrees fully inside a plane stop testing it
+	struct Entry {
+		uint32_t node;
+		uint32_t planeMask;
+	};
+	Entry stack[MaxDepth + 1];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { 0, 0x3f };
+
+	while (stackSize > 0) {
+		Entry entry = stack[--stackSize];
+		const BvhNode& node = nodes[entry.node];
+
+		glm::vec3 center = (node.min + node.max) * 0.5f;
+		glm::vec3 extents = (node.max - node.min) * 0.5f;
+		uint32_t planeMask = entry.planeMask;
+		bool outside = false;
+		for (uint32_t p = 0; p < 6; ++p) {
+			if (!(planeMask & (1u << p))) {
+				continue;
+			}
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+			float reach = glm::dot(glm::abs(glm::vec3(plane)), extents);
+			if (distance < -reach) {
+				outside = true;
+				break;
+			}
+			if (distance >= reach) {
+				planeMask &= ~(1u << p);
+			}
+		}
+		if (outside) {
+			continue;
+		}
+
+		if (node.IsLeaf()) {
+			visible.insert(visible.end(), items.begin() + node.leftOrFirst, items.begin() + node.leftOrFirst + node.count);
+		}
+		else {
+			stack[stackSize++] = { node.leftOrFirst + 1, planeMask };
+			stack[stackSize++] = { node.leftOrFirst, planeMask };
+		}
+	}
+}
+
+bool Bvh::Raycast(const Ray& ray, std::span<const MeshBounds> itemBounds, uint32_t& item, float& distance) const
+{
+	bool hit = false;
+	glm::vec3 inverseDirection = 1.0f / ray.direction;
+	TraverseRay(ray, [&](uint32_t first, uint32_t count, const Ray& current) {
+		float closest = Infinity;
+		for (uint32_t i = first; i < first + count; ++i) {
+			const MeshBounds& bounds = itemBounds[items[i]];
+			float t = IntersectBounds(current, inverseDirection, bounds.min, bounds.max);
+			if (t < closest) {
+				closest = t;
+				item = items[i];
+				distance = t;
+				hit = true;
+			}
+		}
+		return closest;
+	});
+	return hit;
+}
@@ -0,0 +1,106 @@
+/*
+*
+* Defines the frame pacer used by the interactive loop
+*
+*/
+
+#include <frame_pacer.h>
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <GLFW/glfw3.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+namespace {
+	// sleeps end up to this late, the rest of the wait is spent spinning
+	constexpr std::chrono::microseconds SpinMargin(1500);
+}
+
+FramePacer::FramePacer(const FrameLoopOptions& loopOptions)
+	: options(loopOptions)
+{
+	options.fixedStep = std::max(options.fixedStep, 1.0e-4);
+	options.maxStepsPerFrame = std::max(options.maxStepsPerFrame, 1u);
+#if defined(_WIN32)
+	// the default scheduler tick is 15.6 ms, far too coarse to sleep within a frame
+	if (options.frameCap > 0.0) {
+		timerPeriodRaised = timeBeginPeriod(1) == TIMERR_NOERROR;
+	}
+#endif
+}
+
+FramePacer::~FramePacer()
+{
+#if defined(_WIN32)
+	// the period is system wide, it has to be handed back once the loop is done
+	if (timerPeriodRaised) {
+		timeEndPeriod(1);
+	}
+#endif
+}
+
+VsyncMode FramePacer::ApplyVsync(VsyncMode mode)
+{
+	if (mode == VsyncMode::Adaptive && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+		std::cerr << "Adaptive vsync is not supported, using vsync" << std::endl;
+		mode = VsyncMode::On;
+	}
+
+	glfwSwapInterval(mode == VsyncMode::Off ? 0 : mode == VsyncMode::On ? 1 : -1);
+	return mode;
+}
+
+double FramePacer::BeginFrame()
+{
+	Clock::time_point now = Clock::now();
+	double delta = started ? std::chrono::duration<double>(now - frameStart).count() : 0.0;
+	frameStart = now;
+	if (!started) {
+		nextFrame = now;
+		started = true;
+	}
+
+	accumulator += delta;
+	return delta;
+}
+
+uint32_t FramePacer::Steps()
+{
+	uint32_t steps = static_cast<uint32_t>(accumulator / options.fixedStep);
+	if (steps > options.maxStepsPerFrame) {
+		steps = options.maxStepsPerFrame;
+		accumulator = 0.0;
+	}
+	else {
+		accumulator -= steps * options.fixedStep;
+	}
+	return steps;
+}
+
+void FramePacer::WaitForNextFrame()
+{
+	if (options.frameCap <= 0.0) {
+		return;
+	}
+
+	// frames are scheduled on a fixed grid so a late frame does not push every later one back
+	auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.frameCap));
+	nextFrame += interval;
+	Clock::time_point now = Clock::now();
+	if (nextFrame < now) {
+		nextFrame = now;
+		return;
+	}
+
+	if (nextFrame - now > SpinMargin) {
+		std::this_thread::sleep_for(nextFrame - now - SpinMargin);
+	}
+	while (Clock::now() < nextFrame) {
+		std::this_thread::yield();
+	}
+}
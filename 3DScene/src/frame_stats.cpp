@@ -0,0 +1,240 @@
+/*
+*
+* Defines the frame statistics and GPU timer classes used to benchmark the scene
+*
+*/
+
+#include <frame_stats.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+// adds the CPU time of a frame, the GPU time is filled in once its query is read back
+void FrameStats::Record(uint32_t frame, double cpuMs, uint32_t glCalls, uint32_t glCallsElided, uint32_t drawCalls)
+{
+	FrameSample sample;
+	sample.frame = frame;
+	sample.cpuMs = cpuMs;
+	sample.glCalls = glCalls;
+	sample.glCallsElided = glCallsElided;
+	sample.drawCalls = drawCalls;
+	samples.push_back(sample);
+}
+
+void FrameStats::SetGpuTime(uint32_t frame, double gpuMs)
+{
+	// results arrive a few frames late so search from the back
+	for (auto it = samples.rbegin(); it != samples.rend(); ++it) {
+		if (it->frame == frame) {
+			it->gpuMs = gpuMs;
+			return;
+		}
+	}
+}
+
+void FrameStats::SetCulling(uint32_t frame, uint32_t visible, uint32_t culled, double cullMs)
+{
+	for (auto it = samples.rbegin(); it != samples.rend(); ++it) {
+		if (it->frame == frame) {
+			it->objectsVisible = visible;
+			it->objectsCulled = culled;
+			it->cullMs = cullMs;
+			return;
+		}
+	}
+}
+
+void FrameStats::SetFrameTime(uint32_t frame, double frameMs)
+{
+	for (auto it = samples.rbegin(); it != samples.rend(); ++it) {
+		if (it->frame == frame) {
+			it->frameMs = frameMs;
+			return;
+		}
+	}
+}
+
+void FrameStats::SetInputLatency(uint32_t frame, double latencyMs)
+{
+	for (auto it = samples.rbegin(); it != samples.rend(); ++it) {
+		if (it->frame == frame) {
+			it->inputLatencyMs = latencyMs;
+			return;
+		}
+	}
+}
+
+// nearest rank percentile, a frame time spike shows up as the value of a real frame rather than an average of two
+double FrameStats::Percentile(double FrameSample::* field, double percent) const
+{
+	std::vector<double> values;
+	values.reserve(samples.size());
+	for (const auto& sample : samples) {
+		if (sample.*field >= 0.0) {
+			values.push_back(sample.*field);
+		}
+	}
+	if (values.empty()) {
+		return -1.0;
+	}
+
+	size_t rank = static_cast<size_t>(std::ceil(std::clamp(percent, 0.0, 100.0) / 100.0 * values.size()));
+	size_t index = rank > 0 ? rank - 1 : 0;
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+bool FrameStats::Write(const std::string& path) const
+{
+	bool isJson = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+	return isJson ? writeJson(path) : writeCsv(path);
+}
+
+bool FrameStats::writeCsv(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file) {
+		std::cerr << "Failed to open benchmark output: " << path << std::endl;
+		return false;
+	}
+
+	file << "frame,cpu_ms,gpu_ms,gl_calls,gl_calls_elided,draw_calls,visible,culled,cull_ms,frame_ms,input_latency_ms\n";
+	for (const auto& sample : samples) {
+		file << sample.frame << ',' << sample.cpuMs << ',' << sample.gpuMs << ',' << sample.glCalls << ',' << sample.glCallsElided << ',' << sample.drawCalls
+			<< ',' << sample.objectsVisible << ',' << sample.objectsCulled << ',' << sample.cullMs << ',' << sample.frameMs << ',' << sample.inputLatencyMs << '\n';
+	}
+	return true;
+}
+
+bool FrameStats::writeJson(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file) {
+		std::cerr << "Failed to open benchmark output: " << path << std::endl;
+		return false;
+	}
+
+	file << "{\n  \"frames\": [\n";
+	for (size_t i = 0; i < samples.size(); ++i) {
+		const auto& sample = samples[i];
+		file << "    { \"frame\": " << sample.frame << ", \"cpu_ms\": " << sample.cpuMs << ", \"gpu_ms\": " << sample.gpuMs
+			<< ", \"gl_calls\": " << sample.glCalls << ", \"gl_calls_elided\": " << sample.glCallsElided << ", \"draw_calls\": " << sample.drawCalls
+			<< ", \"visible\": " << sample.objectsVisible << ", \"culled\": " << sample.objectsCulled << ", \"cull_ms\": " << sample.cullMs << ", \"frame_ms\": " << sample.frameMs
+			<< ", \"input_latency_ms\": " << sample.inputLatencyMs << " }";
+		file << (i + 1 < samples.size() ? ",\n" : "\n");
+	}
+	file << "  ],\n  \"percentiles\": {\n";
+	const char* names[] = { "cpu_ms", "gpu_ms", "frame_ms", "input_latency_ms" };
+	double FrameSample::* fields[] = { &FrameSample::cpuMs, &FrameSample::gpuMs, &FrameSample::frameMs, &FrameSample::inputLatencyMs };
+	for (size_t i = 0; i < 4; ++i) {
+		file << "    \"" << names[i] << "\": { \"p50\": " << Percentile(fields[i], 50.0) << ", \"p95\": " << Percentile(fields[i], 95.0)
+			<< ", \"p99\": " << Percentile(fields[i], 99.0) << " }" << (i + 1 < 4 ? ",\n" : "\n");
+	}
+	file << "  }\n}\n";
+	return true;
+}
+
+// prints average, min, and max of the recorded timings and the frame time percentiles
+void FrameStats::PrintSummary() const
+{
+	if (samples.empty()) {
+		return;
+	}
+
+	double cpuTotal = 0.0, gpuTotal = 0.0;
+	double cpuMin = samples[0].cpuMs, cpuMax = samples[0].cpuMs;
+	size_t gpuCount = 0;
+	double glCalls = 0.0, glCallsElided = 0.0, drawCalls = 0.0;
+	double visible = 0.0, culled = 0.0, cullMs = 0.0;
+	for (const auto& sample : samples) {
+		drawCalls += sample.drawCalls;
+		visible += sample.objectsVisible;
+		culled += sample.objectsCulled;
+		cullMs += sample.cullMs;
+		glCalls += sample.glCalls;
+		glCallsElided += sample.glCallsElided;
+		cpuTotal += sample.cpuMs;
+		cpuMin = std::min(cpuMin, sample.cpuMs);
+		cpuMax = std::max(cpuMax, sample.cpuMs);
+		if (sample.gpuMs >= 0.0) {
+			gpuTotal += sample.gpuMs;
+			++gpuCount;
+		}
+	}
+
+	std::cout << samples.size() << " frames, CPU avg " << cpuTotal / samples.size() << " ms (min " << cpuMin << ", max " << cpuMax << ")";
+	if (gpuCount > 0) {
+		std::cout << ", GPU avg " << gpuTotal / gpuCount << " ms";
+	}
+	std::cout << ", GL state calls/frame " << glCalls / samples.size() << " issued, " << glCallsElided / samples.size() << " elided";
+	std::cout << ", draw calls/frame " << drawCalls / samples.size();
+	std::cout << ", objects/frame " << visible / samples.size() << " visible, " << culled / samples.size() << " culled in "
+		<< cullMs / samples.size() << " ms";
+
+	// the tail matters more than the average for how smooth the frame rate feels
+	double FrameSample::* paced = Percentile(&FrameSample::frameMs, 50.0) >= 0.0 ? &FrameSample::frameMs : &FrameSample::cpuMs;
+	std::cout << ", " << (paced == &FrameSample::frameMs ? "frame" : "CPU") << " time p50 " << Percentile(paced, 50.0) << " ms, p95 "
+		<< Percentile(paced, 95.0) << " ms, p99 " << Percentile(paced, 99.0) << " ms";
+	if (Percentile(&FrameSample::inputLatencyMs, 50.0) >= 0.0) {
+		std::cout << ", input latency p50 " << Percentile(&FrameSample::inputLatencyMs, 50.0) << " ms, p99 " << Percentile(&FrameSample::inputLatencyMs, 99.0) << " ms";
+	}
+	std::cout << std::endl;
+}
+
+void GpuTimer::Init(FrameStats& frameStats)
+{
+	stats = &frameStats;
+	glGenQueries(static_cast<GLsizei>(QueryCount), queries.data());
+}
+
+void GpuTimer::Destroy()
+{
+	glDeleteQueries(static_cast<GLsizei>(QueryCount), queries.data());
+	queries.fill(0);
+	pending.fill(false);
+}
+
+void GpuTimer::Begin(uint32_t frame)
+{
+	// the ring has wrapped around, this slot's result is needed before it can be reused
+	if (pending[current]) {
+		read(current);
+	}
+
+	queryFrames[current] = frame;
+	glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+}
+
+void GpuTimer::End()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[current] = true;
+	current = (current + 1) % QueryCount;
+}
+
+void GpuTimer::Collect(bool wait)
+{
+	for (size_t slot = 0; slot < QueryCount; ++slot) {
+		if (!pending[slot]) {
+			continue;
+		}
+
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available || wait) {
+			read(slot);
+		}
+	}
+}
+
+void GpuTimer::read(size_t slot)
+{
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+	pending[slot] = false;
+
+	if (stats) {
+		stats->SetGpuTime(queryFrames[slot], static_cast<double>(elapsed) / 1.0e6);
+	}
+}
@@ -0,0 +1,200 @@
+/*
+*
+* Defines frustum plane extraction and the scalar and SIMD sphere culling loops
+*
+*/
+
+#include <frustum_culling.h>
+#include <chrono>
+
+#if defined(__AVX__)
+#define CULL_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULL_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+	constexpr size_t Padding = 8;
+
+	size_t paddedSize(size_t size)
+	{
+		return (size + Padding - 1) / Padding * Padding;
+	}
+
+#if defined(CULL_SSE) || defined(CULL_AVX)
+	// appends the index of every set bit of the lane mask
+	void appendLanes(int mask, size_t base, size_t count, std::vector<uint32_t>& visible)
+	{
+		for (size_t lane = 0; mask != 0; ++lane, mask >>= 1) {
+			if ((mask & 1) && base + lane < count) {
+				visible.push_back(static_cast<uint32_t>(base + lane));
+			}
+		}
+	}
+#endif
+}
+
+Frustum Frustum::FromMatrix(const glm::mat4& m)
+{
+	// rows of the matrix, glm stores columns
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	Frustum frustum;
+	frustum.planes = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2 };
+
+	// normalized so the plane distance is in world units and can be compared to a radius
+	for (auto& plane : frustum.planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
+
+bool Frustum::Intersects(const BoundingSphere& sphere) const
+{
+	for (const auto& plane : planes) {
+		if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void FrustumCuller::Clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	radius.clear();
+	count = 0;
+}
+
+void FrustumCuller::Reserve(size_t sphereCount)
+{
+	size_t padded = paddedSize(sphereCount);
+	centerX.reserve(padded);
+	centerY.reserve(padded);
+	centerZ.reserve(padded);
+	radius.reserve(padded);
+}
+
+uint32_t FrustumCuller::Add(const BoundingSphere& worldSphere)
+{
+	uint32_t index = static_cast<uint32_t>(count++);
+	size_t padded = paddedSize(count);
+	if (padded != centerX.size()) {
+		centerX.resize(padded, 0.0f);
+		centerY.resize(padded, 0.0f);
+		centerZ.resize(padded, 0.0f);
+		radius.resize(padded, 0.0f);
+	}
+	Set(index, worldSphere);
+	return index;
+}
+
+void FrustumCuller::Set(uint32_t index, const BoundingSphere& worldSphere)
+{
+	centerX[index] = worldSphere.center.x;
+	centerY[index] = worldSphere.center.y;
+	centerZ[index] = worldSphere.center.z;
+	radius[index] = worldSphere.radius;
+}
+
+const char* FrustumCuller::SimdName()
+{
+#if defined(CULL_AVX)
+	return "AVX, 8 wide";
+#elif defined(CULL_SSE)
+	return "SSE, 4 wide";
+#else
+	return "scalar";
+#endif
+}
+
+void FrustumCuller::cullScalar(const Frustum& frustum, size_t begin, std::vector<uint32_t>& visible) const
+{
+	for (size_t i = begin; i < count; ++i) {
+		bool inside = true;
+		for (const auto& plane : frustum.planes) {
+			if (plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w < -radius[i]) {
+				inside = false;
+				break;
+			}
+		}
+		if (inside) {
+			visible.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+CullStats FrustumCuller::Cull(const Frustum& frustum, std::vector<uint32_t>& visible, CullMode mode) const
+{
+	auto start = std::chrono::steady_clock::now();
+	visible.clear();
+
+	size_t simdEnd = 0;
+	if (mode == CullMode::Simd) {
+#if defined(CULL_AVX)
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; ++p) {
+			planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+		}
+
+		// the arrays are padded, so the last group reads zeros that appendLanes drops
+		for (size_t i = 0; i < count; i += 8) {
+			__m256 x = _mm256_loadu_ps(&centerX[i]);
+			__m256 y = _mm256_loadu_ps(&centerY[i]);
+			__m256 z = _mm256_loadu_ps(&centerZ[i]);
+			__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radius[i]));
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p) {
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+					_mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+			}
+			appendLanes(_mm256_movemask_ps(inside), i, count, visible);
+		}
+		simdEnd = count;
+#elif defined(CULL_SSE)
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; ++p) {
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+
+		for (size_t i = 0; i < count; i += 4) {
+			__m128 x = _mm_loadu_ps(&centerX[i]);
+			__m128 y = _mm_loadu_ps(&centerY[i]);
+			__m128 z = _mm_loadu_ps(&centerZ[i]);
+			__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+					_mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+			appendLanes(_mm_movemask_ps(inside), i, count, visible);
+		}
+		simdEnd = count;
+#endif
+	}
+	cullScalar(frustum, simdEnd, visible);
+
+	CullStats stats;
+	stats.tested = static_cast<uint32_t>(count);
+	stats.visible = static_cast<uint32_t>(visible.size());
+	stats.culled = stats.tested - stats.visible;
+	stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
@@ -0,0 +1,276 @@
+/*
+*
+* Defines the geometry arena, its allocator, and the multi-draw indirect submission
+*
+*/
+
+#include <geometry_arena.h>
+#include <gl_state.h>
+#include <algorithm>
+#include <iostream>
+
+void ArenaAllocator::Reset(uint32_t totalCount)
+{
+	capacity = totalCount;
+	used = 0;
+	freeBlocks.clear();
+	if (capacity > 0) {
+		freeBlocks.push_back({ 0, capacity });
+	}
+}
+
+bool ArenaAllocator::Allocate(uint32_t count, uint32_t& offset)
+{
+	for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+		if (it->count < count) {
+			continue;
+		}
+
+		offset = it->offset;
+		it->offset += count;
+		it->count -= count;
+		if (it->count == 0) {
+			freeBlocks.erase(it);
+		}
+		used += count;
+		return true;
+	}
+	return false;
+}
+
+void ArenaAllocator::Release(uint32_t offset, uint32_t count)
+{
+	if (count == 0) {
+		return;
+	}
+
+	auto next = std::lower_bound(freeBlocks.begin(), freeBlocks.end(), offset,
+		[](const Block& block, uint32_t value) { return block.offset < value; });
+	auto inserted = freeBlocks.insert(next, { offset, count });
+	used -= count;
+
+	// merge with the following block, then with the previous one
+	auto after = inserted + 1;
+	if (after != freeBlocks.end() && inserted->offset + inserted->count == after->offset) {
+		inserted->count += after->count;
+		freeBlocks.erase(after);
+	}
+	if (inserted != freeBlocks.begin()) {
+		auto before = inserted - 1;
+		if (before->offset + before->count == inserted->offset) {
+			before->count += inserted->count;
+			freeBlocks.erase(inserted);
+		}
+	}
+}
+
+float ArenaAllocator::Fragmentation() const
+{
+	uint32_t totalFree = 0, largest = 0;
+	for (const auto& block : freeBlocks) {
+		totalFree += block.count;
+		largest = std::max(largest, block.count);
+	}
+	return totalFree == 0 ? 0.0f : 1.0f - static_cast<float>(largest) / totalFree;
+}
+
+bool GeometryArena::IsSupported()
+{
+	return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void GeometryArena::Create(uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t instanceCapacity)
+{
+	layout = VertexPacking::MakeLayout(Format);
+	vertexSpace.Reset(vertexCapacity);
+	indexSpace.Reset(indexCapacity);
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &vertexBuffer);
+	glGenBuffers(1, &indexBuffer);
+	glGenBuffers(1, &indirectBuffer);
+
+	GLState::BindVertexArray(VAO);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertexCapacity) * layout.stride, nullptr, GL_STATIC_DRAW);
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indexCapacity) * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+
+	for (const auto& attribute : layout.attributes) {
+		glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized, static_cast<GLsizei>(layout.stride),
+			reinterpret_cast<const void*>(static_cast<uintptr_t>(attribute.offset)));
+		glEnableVertexAttribArray(attribute.location);
+	}
+
+	// growing the instance buffer keeps its name, so these attributes stay valid
+	instanceBuffer.Create(instanceCapacity);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, instanceBuffer.Buffer());
+	for (GLuint column = 0; column < 4; ++column) {
+		GLuint location = InstanceModelLocation + column;
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			reinterpret_cast<const void*>(offsetof(InstanceData, model) + sizeof(glm::vec4) * column));
+		glVertexAttribDivisor(location, 1);
+		glEnableVertexAttribArray(location);
+	}
+	glVertexAttribIPointer(InstanceMaterialLocation, 1, GL_UNSIGNED_INT, sizeof(InstanceData),
+		reinterpret_cast<const void*>(offsetof(InstanceData, material)));
+	glVertexAttribDivisor(InstanceMaterialLocation, 1);
+	glEnableVertexAttribArray(InstanceMaterialLocation);
+}
+
+void GeometryArena::Destroy()
+{
+	instanceBuffer.Destroy();
+	GLState::ForgetVertexArray(VAO);
+	GLState::ForgetBuffer(vertexBuffer);
+	GLState::ForgetBuffer(indexBuffer);
+	GLState::ForgetBuffer(indirectBuffer);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &vertexBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+	glDeleteBuffers(1, &indirectBuffer);
+	VAO = vertexBuffer = indexBuffer = indirectBuffer = 0;
+	indirectCapacity = 0;
+	buckets.clear();
+}
+
+ArenaMesh GeometryArena::Add(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+	return Add(VertexPacking::Pack(vertices, Format).View(), indices);
+}
+
+ArenaMesh GeometryArena::Add(const PackedVertexView& vertices, std::span<const uint32_t> indices)
+{
+	ArenaMesh mesh;
+	if (vertices.layout.format != Format) {
+		std::cerr << "Geometry arena meshes must be packed in the arena's vertex format" << std::endl;
+		return mesh;
+	}
+
+	uint32_t vertexCount = vertices.count;
+	uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+	if (!vertexSpace.Allocate(vertexCount, mesh.vertexOffset)) {
+		std::cerr << "Geometry arena is out of vertex space (" << vertexCount << " vertices requested)" << std::endl;
+		return ArenaMesh{};
+	}
+	if (!indexSpace.Allocate(indexCount, mesh.indexOffset)) {
+		std::cerr << "Geometry arena is out of index space (" << indexCount << " indices requested)" << std::endl;
+		vertexSpace.Release(mesh.vertexOffset, vertexCount);
+		return ArenaMesh{};
+	}
+	mesh.vertexCount = vertexCount;
+	mesh.indexCount = indexCount;
+
+	// indices stay relative to the mesh, the command's baseVertex moves them to the mesh's vertices
+	GLState::BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(mesh.vertexOffset) * layout.stride, static_cast<GLsizeiptr>(vertices.data.size()), vertices.data.data());
+
+	// the element binding belongs to the VAO, so bind it before touching the index buffer
+	GLState::BindVertexArray(VAO);
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLintptr>(mesh.indexOffset) * sizeof(uint32_t), static_cast<GLsizeiptr>(indices.size_bytes()), indices.data());
+	return mesh;
+}
+
+void GeometryArena::Remove(const ArenaMesh& mesh)
+{
+	if (!mesh.Valid()) {
+		return;
+	}
+	vertexSpace.Release(mesh.vertexOffset, mesh.vertexCount);
+	indexSpace.Release(mesh.indexOffset, mesh.indexCount);
+}
+
+void GeometryArena::BeginFrame()
+{
+	for (auto& bucket : buckets) {
+		bucket.commands.clear();
+	}
+	instances.clear();
+}
+
+void GeometryArena::Record(uint32_t bucket, const ArenaMesh& mesh, const glm::mat4& model, uint32_t material)
+{
+	if (!mesh.Valid()) {
+		return;
+	}
+	if (bucket >= buckets.size()) {
+		buckets.resize(bucket + 1);
+	}
+
+	DrawElementsIndirectCommand command;
+	command.count = mesh.indexCount;
+	command.instanceCount = 1;
+	command.firstIndex = mesh.indexOffset;
+	command.baseVertex = static_cast<int32_t>(mesh.vertexOffset);
+	command.baseInstance = static_cast<uint32_t>(instances.size());
+	buckets[bucket].commands.push_back(command);
+
+	InstanceData instance;
+	instance.model = model;
+	instance.material = material;
+	instances.push_back(instance);
+}
+
+void GeometryArena::Upload()
+{
+	commandStaging.clear();
+	for (auto& bucket : buckets) {
+		bucket.firstCommand = commandStaging.size();
+		commandStaging.insert(commandStaging.end(), bucket.commands.begin(), bucket.commands.end());
+	}
+	if (commandStaging.empty()) {
+		return;
+	}
+
+	instanceBuffer.Update(instances);
+
+	GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+	GLsizeiptr bytes = static_cast<GLsizeiptr>(commandStaging.size() * sizeof(DrawElementsIndirectCommand));
+	if (commandStaging.size() > indirectCapacity) {
+		indirectCapacity = std::max(commandStaging.size(), indirectCapacity * 2);
+	}
+	// orphaned every frame so the driver never waits on last frame's commands
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, static_cast<GLsizeiptr>(indirectCapacity * sizeof(DrawElementsIndirectCommand)), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, bytes, commandStaging.data());
+}
+
+void GeometryArena::Submit(uint32_t bucket)
+{
+	if (bucket >= buckets.size() || buckets[bucket].commands.empty()) {
+		return;
+	}
+
+	const Bucket& entry = buckets[bucket];
+	GLState::BindVertexArray(VAO);
+	GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+		reinterpret_cast<const void*>(entry.firstCommand * sizeof(DrawElementsIndirectCommand)),
+		static_cast<GLsizei>(entry.commands.size()), sizeof(DrawElementsIndirectCommand));
+	GLState::CountDraw();
+}
+
+ArenaStats GeometryArena::Stats() const
+{
+	ArenaStats stats;
+	stats.vertexCapacity = vertexSpace.Capacity();
+	stats.vertexUsed = vertexSpace.Used();
+	stats.indexCapacity = indexSpace.Capacity();
+	stats.indexUsed = indexSpace.Used();
+	stats.freeBlocks = vertexSpace.FreeBlockCount() + indexSpace.FreeBlockCount();
+	stats.vertexFragmentation = vertexSpace.Fragmentation();
+	stats.indexFragmentation = indexSpace.Fragmentation();
+	return stats;
+}
+
+void GeometryArena::PrintReport() const
+{
+	ArenaStats stats = Stats();
+	auto percent = [](uint32_t used, uint32_t capacity) { return capacity == 0 ? 0.0 : 100.0 * used / capacity; };
+
+	std::cout << "Geometry arena: vertices " << stats.vertexUsed << "/" << stats.vertexCapacity << " (" << percent(stats.vertexUsed, stats.vertexCapacity)
+		<< "%, " << (stats.vertexCapacity * layout.stride) / 1024 << " KiB), indices " << stats.indexUsed << "/" << stats.indexCapacity << " ("
+		<< percent(stats.indexUsed, stats.indexCapacity) << "%), " << stats.freeBlocks << " free blocks, fragmentation "
+		<< stats.vertexFragmentation * 100.0f << "% vertex, " << stats.indexFragmentation * 100.0f << "% index" << std::endl;
+}
@@ -0,0 +1,262 @@
+/*
+*
+* Defines the GL state cache that filters out redundant binds and capability changes
+*
+*/
+
+#include <gl_state.h>
+#include <array>
+#include <cstddef>
+
+namespace {
+	// value that never matches a real object name, so the first call after Invalidate always reaches the driver
+	constexpr GLuint Unknown = ~0u;
+	constexpr size_t TextureUnitCount = 32;
+	constexpr size_t UniformBindingCount = 16;
+
+	enum class Capability : uint8_t { Unknown, Enabled, Disabled };
+
+	// buffer targets whose binding is tracked, any other target is passed straight through
+	constexpr GLenum BufferTargets[] = {
+		GL_ARRAY_BUFFER,
+		GL_ELEMENT_ARRAY_BUFFER,
+		GL_UNIFORM_BUFFER,
+		GL_PIXEL_UNPACK_BUFFER,
+		GL_DRAW_INDIRECT_BUFFER,
+		GL_SHADER_STORAGE_BUFFER
+	};
+	constexpr size_t BufferTargetCount = std::size(BufferTargets);
+
+	// range bound to an indexed uniform buffer binding point
+	struct BufferRange {
+		GLuint buffer{ Unknown };
+		GLintptr offset{ 0 };
+		GLsizeiptr size{ 0 };
+	};
+
+	struct State {
+		GLuint program{ Unknown };
+		GLuint vao{ Unknown };
+		std::array<GLuint, BufferTargetCount> buffers{};
+		std::array<BufferRange, UniformBindingCount> uniformRanges{};
+		GLuint activeUnit{ Unknown };
+		std::array<GLuint, TextureUnitCount> textures2D{};
+		std::array<GLuint, TextureUnitCount> samplers{};
+		Capability depthTest{ Capability::Unknown };
+		Capability blend{ Capability::Unknown };
+		GLState::Counters counters;
+
+		State()
+		{
+			buffers.fill(Unknown);
+			textures2D.fill(Unknown);
+			samplers.fill(Unknown);
+		}
+	};
+
+	State state;
+
+	// returns true when the call has to be issued, counting it either way
+	bool changes(GLuint& cached, GLuint value)
+	{
+		if (cached == value) {
+			++state.counters.elided;
+			return false;
+		}
+		cached = value;
+		++state.counters.issued;
+		return true;
+	}
+
+	bool changes(Capability& cached, bool enabled)
+	{
+		Capability value = enabled ? Capability::Enabled : Capability::Disabled;
+		if (cached == value) {
+			++state.counters.elided;
+			return false;
+		}
+		cached = value;
+		++state.counters.issued;
+		return true;
+	}
+
+	int bufferSlot(GLenum target)
+	{
+		for (size_t i = 0; i < BufferTargetCount; ++i) {
+			if (BufferTargets[i] == target) {
+				return static_cast<int>(i);
+			}
+		}
+		return -1;
+	}
+
+	void setCapability(GLenum cap, Capability& cached, bool enabled)
+	{
+		if (changes(cached, enabled)) {
+			enabled ? glEnable(cap) : glDisable(cap);
+		}
+	}
+}
+
+void GLState::UseProgram(GLuint program)
+{
+	if (changes(state.program, program)) {
+		glUseProgram(program);
+	}
+}
+
+void GLState::BindVertexArray(GLuint vao)
+{
+	if (changes(state.vao, vao)) {
+		glBindVertexArray(vao);
+		// the element buffer binding belongs to the vertex array, so it is unknown after a switch
+		state.buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = Unknown;
+	}
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer)
+{
+	int slot = bufferSlot(target);
+	if (slot < 0) {
+		++state.counters.issued;
+		glBindBuffer(target, buffer);
+		return;
+	}
+
+	if (changes(state.buffers[slot], buffer)) {
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GLState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	bool tracked = target == GL_UNIFORM_BUFFER && index < UniformBindingCount;
+	if (tracked) {
+		BufferRange& range = state.uniformRanges[index];
+		if (range.buffer == buffer && range.offset == offset && range.size == size) {
+			++state.counters.elided;
+			return;
+		}
+		range = { buffer, offset, size };
+	}
+
+	++state.counters.issued;
+	glBindBufferRange(target, index, buffer, offset, size);
+
+	// binding a range also changes the generic binding of the target
+	int slot = bufferSlot(target);
+	if (slot >= 0) {
+		state.buffers[slot] = buffer;
+	}
+}
+
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	bool tracked = target == GL_TEXTURE_2D && unit < TextureUnitCount;
+	if (tracked && state.textures2D[unit] == texture) {
+		++state.counters.elided;
+		return;
+	}
+
+	if (changes(state.activeUnit, unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+
+	++state.counters.issued;
+	glBindTexture(target, texture);
+	if (tracked) {
+		state.textures2D[unit] = texture;
+	}
+}
+
+void GLState::BindSampler(GLuint unit, GLuint sampler)
+{
+	if (unit >= TextureUnitCount) {
+		++state.counters.issued;
+		glBindSampler(unit, sampler);
+		return;
+	}
+
+	if (changes(state.samplers[unit], sampler)) {
+		glBindSampler(unit, sampler);
+	}
+}
+
+void GLState::SetDepthTest(bool enabled)
+{
+	setCapability(GL_DEPTH_TEST, state.depthTest, enabled);
+}
+
+void GLState::SetBlend(bool enabled)
+{
+	setCapability(GL_BLEND, state.blend, enabled);
+}
+
+void GLState::Invalidate()
+{
+	Counters counters = state.counters;
+	state = State();
+	state.counters = counters;
+}
+
+void GLState::ForgetProgram(GLuint program)
+{
+	if (state.program == program) {
+		state.program = Unknown;
+	}
+}
+
+void GLState::ForgetVertexArray(GLuint vao)
+{
+	if (state.vao == vao) {
+		state.vao = Unknown;
+		state.buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = Unknown;
+	}
+}
+
+void GLState::ForgetBuffer(GLuint buffer)
+{
+	for (auto& bound : state.buffers) {
+		if (bound == buffer) {
+			bound = Unknown;
+		}
+	}
+	for (auto& range : state.uniformRanges) {
+		if (range.buffer == buffer) {
+			range = BufferRange();
+		}
+	}
+}
+
+void GLState::ForgetTexture(GLuint texture)
+{
+	for (auto& bound : state.textures2D) {
+		if (bound == texture) {
+			bound = Unknown;
+		}
+	}
+}
+
+void GLState::ForgetSampler(GLuint sampler)
+{
+	for (auto& bound : state.samplers) {
+		if (bound == sampler) {
+			bound = Unknown;
+		}
+	}
+}
+
+void GLState::CountDraw()
+{
+	++state.counters.draws;
+}
+
+GLState::Counters GLState::FrameCounters()
+{
+	return state.counters;
+}
+
+void GLState::ResetFrameCounters()
+{
+	state.counters = Counters();
+}
@@ -0,0 +1,83 @@
+/*
+*
+* Defines the input queue and the input latency probe
+*
+*/
+
+#include <input.h>
+#include <frame_stats.h>
+
+void Input::Push(InputEvent event)
+{
+	event.time = InputClock::now();
+	queue.push_back(event);
+}
+
+void Input::PushCursor(double x, double y)
+{
+	if (firstMouse) {
+		lastX = x;
+		lastY = y;
+		firstMouse = false;
+	}
+
+	InputEvent event;
+	event.type = InputEvent::Type::MouseMove;
+	event.x = x - lastX;
+	event.y = lastY - y;
+	lastX = x;
+	lastY = y;
+	Push(event);
+}
+
+void Input::Poll(GLFWwindow* window)
+{
+	polledWindow = window;
+	glfwPollEvents();
+}
+
+bool Input::KeyDown(int key) const
+{
+	// GLFW keeps the key state current as of the last glfwPollEvents
+	return polledWindow && glfwGetKey(polledWindow, key) == GLFW_PRESS;
+}
+
+InputClock::time_point Input::Drain(std::vector<InputEvent>& events)
+{
+	InputClock::time_point oldest = queue.empty() ? InputClock::time_point{} : queue.front().time;
+	events.insert(events.end(), queue.begin(), queue.end());
+	queue.clear();
+	return oldest;
+}
+
+void InputLatency::Submit(uint32_t frame, InputClock::time_point oldestInput)
+{
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush(); // a fence that never reaches the GPU never signals
+	pending.push_back({ fence, frame, oldestInput });
+}
+
+void InputLatency::Collect(FrameStats& stats, bool wait)
+{
+	size_t done = 0;
+	for (; done < pending.size(); ++done) {
+		// fences signal in submission order, stop at the first one still in flight
+		GLuint64 timeout = wait ? 1000000000ull : 0;
+		GLenum status = glClientWaitSync(pending[done].fence, 0, timeout);
+		if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+			break;
+		}
+
+		stats.SetInputLatency(pending[done].frame, std::chrono::duration<double, std::milli>(InputClock::now() - pending[done].input).count());
+		glDeleteSync(pending[done].fence);
+	}
+	pending.erase(pending.begin(), pending.begin() + done);
+}
+
+void InputLatency::Destroy()
+{
+	for (const auto& entry : pending) {
+		glDeleteSync(entry.fence);
+	}
+	pending.clear();
+}
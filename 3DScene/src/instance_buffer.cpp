@@ -0,0 +1,44 @@
+/*
+*
+* Defines the instance buffer used by instanced mesh draws
+*
+*/
+
+#include <instance_buffer.h>
+#include <gl_state.h>
+#include <algorithm>
+
+void InstanceBuffer::Create(uint32_t instanceCapacity)
+{
+	capacity = std::max<uint32_t>(instanceCapacity, 1);
+	glGenBuffers(1, &buffer);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(capacity * sizeof(InstanceData)), nullptr, GL_DYNAMIC_DRAW);
+}
+
+void InstanceBuffer::Destroy()
+{
+	GLState::ForgetBuffer(buffer);
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+	capacity = 0;
+}
+
+void InstanceBuffer::Update(std::span<const InstanceData> instances, uint32_t firstInstance)
+{
+	GLState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	uint32_t required = firstInstance + static_cast<uint32_t>(instances.size());
+	if (required > capacity) {
+		// the old contents are dropped, callers rewrite every instance after growing
+		capacity = std::max(required, capacity * 2);
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(capacity * sizeof(InstanceData)), nullptr, GL_DYNAMIC_DRAW);
+	}
+	else if (firstInstance == 0 && required == capacity) {
+		// orphan the storage when everything is rewritten so the driver does not wait on draws still reading it
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(capacity * sizeof(InstanceData)), nullptr, GL_DYNAMIC_DRAW);
+	}
+
+	glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(firstInstance * sizeof(InstanceData)),
+		static_cast<GLsizeiptr>(instances.size_bytes()), instances.data());
+}
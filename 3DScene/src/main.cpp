@@ -1,12 +1,206 @@
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 #include <app.h>
 
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#endif
+
+// time from the process being created to main starting, which covers loading and every global constructor.
+// Windows reports the creation time in 100 ns units, Linux only in scheduler ticks
+static double timeBeforeMainMs()
+{
+#if defined(_WIN32)
+	FILETIME creation, exit, kernel, user, now;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+		return -1.0;
+	}
+	GetSystemTimePreciseAsFileTime(&now);
+	ULARGE_INTEGER start{ { creation.dwLowDateTime, creation.dwHighDateTime } };
+	ULARGE_INTEGER end{ { now.dwLowDateTime, now.dwHighDateTime } };
+	return static_cast<double>(end.QuadPart - start.QuadPart) / 1.0e4;
+#else
+	// the 22nd field of /proc/self/stat is the start time in ticks since boot, the command name before it may contain spaces
+	std::ifstream stat("/proc/self/stat");
+	std::string line;
+	if (!std::getline(stat, line) || line.rfind(')') == std::string::npos) {
+		return -1.0;
+	}
+	std::istringstream fields(line.substr(line.rfind(')') + 2));
+	std::string field;
+	for (int i = 3; i <= 22 && fields >> field; ++i) {
+	}
+
+	timespec boot{};
+	clock_gettime(CLOCK_BOOTTIME, &boot);
+	double startMs = std::stod(field) * 1000.0 / sysconf(_SC_CLK_TCK);
+	return boot.tv_sec * 1000.0 + boot.tv_nsec / 1.0e6 - startMs;
+#endif
+}
+
+static void printUsage()
+{
+	std::cerr << "Usage: 3DScene [--vsync off|on|adaptive] [--fps-cap <fps>] [--frame-stats <output.csv|output.json>]\n"
+		<< "       3DScene --headless [frames] [output.csv|output.json]\n"
+		<< "       3DScene --bench <name>\n"
+		<< "       3DScene --bake-meshes [directory]\n"
+		<< "       3DScene --pathtrace [output.png] [samples]\n"
+		<< "       3DScene --rasterize [output.png] [width height]\n"
+		<< "       3DScene --startup" << std::endl;
+}
+
+static void printMissingValue(const std::string& flag)
+{
+	std::cerr << "Missing value for: " << flag << std::endl;
+	printUsage();
+}
+
+// std::stoul and std::stod throw on malformed input and stoul accepts a leading minus, so arguments are checked here
+static bool parseCount(const std::string& text, uint32_t& value)
+{
+	try {
+		size_t used = 0;
+		unsigned long parsed = std::stoul(text, &used);
+		if (used != text.size() || text[0] == '-' || parsed > UINT32_MAX) {
+			throw std::invalid_argument(text);
+		}
+		value = static_cast<uint32_t>(parsed);
+		return true;
+	}
+	catch (const std::logic_error&) {
+		std::cerr << "Expected a whole number, got: " << text << std::endl;
+		printUsage();
+		return false;
+	}
+}
+
+static bool parseRate(const std::string& text, double& value)
+{
+	try {
+		size_t used = 0;
+		double parsed = std::stod(text, &used);
+		if (used != text.size() || !(parsed >= 0.0)) {
+			throw std::invalid_argument(text);
+		}
+		value = parsed;
+		return true;
+	}
+	catch (const std::logic_error&) {
+		std::cerr << "Expected a number of at least 0, got: " << text << std::endl;
+		printUsage();
+		return false;
+	}
+}
+
 int main(int argc, char** argv) {
+	double startupMs = timeBeforeMainMs();
+
+	// --startup prints how long the process took to reach main, nothing else is constructed
+	if (argc > 1 && std::string(argv[1]) == "--startup") {
+		std::cout << "Time before main: " << startupMs << " ms" << std::endl;
+		return 0;
+	}
 
 	App app{ "3D Scene",800, 600 }; //title, width, and height of the App class
 
-	app.Run(); //runs app
+	// --headless [frames] [output.csv|output.json] renders offscreen and writes frame timings
+	if (argc > 1 && std::string(argv[1]) == "--headless") {
+		HeadlessOptions options;
+		if (argc > 2 && !parseCount(argv[2], options.frames)) {
+			return 1;
+		}
+		if (argc > 3) {
+			options.outputPath = argv[3];
+		}
+		return app.RunHeadless(options) ? 0 : 1;
+	}
+
+	// --bench <name> runs a single microbenchmark, e.g. --bench uniforms
+	if (argc > 1 && std::string(argv[1]) == "--bench") {
+		if (argc < 3) {
+			printMissingValue(argv[1]);
+			return 1;
+		}
+		return app.RunBenchmark(argv[2]) ? 0 : 1;
+	}
+
+	// --bake-meshes [directory] converts the built in shapes to baked mesh files, assets/meshes by default
+	if (argc > 1 && std::string(argv[1]) == "--bake-meshes") {
+		Path directory = argc > 2 ? Path(argv[2]) : std::filesystem::current_path() / "assets" / "meshes";
+		return app.BakeMeshes(directory) ? 0 : 1;
+	}
+
+	// --pathtrace [output.png] [samples] renders the scene on the CPU as a reference image
+	if (argc > 1 && std::string(argv[1]) == "--pathtrace") {
+		PathTraceOptions options;
+		if (argc > 2) {
+			options.outputPath = argv[2];
+		}
+		if (argc > 3 && !parseCount(argv[3], options.samples)) {
+			return 1;
+		}
+		return app.RunPathTrace(options) ? 0 : 1;
+	}
+
+	// --rasterize [output.png] [width height] renders the scene with the CPU rasterizer, 1920x1080 by default
+	if (argc > 1 && std::string(argv[1]) == "--rasterize") {
+		RasterOptions options;
+		if (argc > 2) {
+			options.outputPath = argv[2];
+		}
+		if (argc == 4) {
+			std::cerr << "Expected both a width and a height" << std::endl;
+			printUsage();
+			return 1;
+		}
+		if (argc > 4 && (!parseCount(argv[3], options.width) || !parseCount(argv[4], options.height))) {
+			return 1;
+		}
+		return app.RunRasterize(options) ? 0 : 1;
+	}
+
+	// --vsync off|on|adaptive, --fps-cap <fps>, and --frame-stats <output.csv|output.json> configure the interactive loop
+	FrameLoopOptions loopOptions;
+	for (int i = 1; i < argc; i += 2) {
+		std::string flag = argv[i];
+		if (flag != "--vsync" && flag != "--fps-cap" && flag != "--frame-stats") {
+			std::cerr << "Unknown option: " << flag << std::endl;
+			printUsage();
+			return 1;
+		}
+		if (i + 1 >= argc) {
+			printMissingValue(flag);
+			return 1;
+		}
+
+		std::string value = argv[i + 1];
+		if (flag == "--vsync") {
+			if (value != "off" && value != "on" && value != "adaptive") {
+				std::cerr << "Unknown vsync mode: " << value << std::endl;
+				printUsage();
+				return 1;
+			}
+			loopOptions.vsync = value == "off" ? VsyncMode::Off : value == "adaptive" ? VsyncMode::Adaptive : VsyncMode::On;
+		}
+		else if (flag == "--fps-cap") {
+			if (!parseRate(value, loopOptions.frameCap)) {
+				return 1;
+			}
+		}
+		else {
+			loopOptions.statsPath = value;
+		}
+	}
+
+	app.Run(loopOptions); //runs app
 
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -5,43 +5,123 @@
 */
 
 #include <mesh.h>
+#include <gl_state.h>
 #include <iostream>
 
-Mesh::Mesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& elements)
+Mesh::Mesh(std::span<const Vertex> vertices, std::span<const uint32_t> elements, VertexFormat format)
 {
+	upload(VertexPacking::Pack(vertices, format).View(), elements);
+}
+
+Mesh::Mesh(const PackedVertices& vertices, std::span<const uint32_t> elements)
+{
+	upload(vertices.View(), elements);
+}
+
+Mesh::Mesh(const PackedVertexView& vertices, std::span<const uint32_t> elements)
+{
+	upload(vertices, elements);
+}
+
+void Mesh::upload(const PackedVertexView& vertices, std::span<const uint32_t> elements)
+{
+	vertexCount = vertices.count;
+	layout = vertices.layout;
+	dequantScale = vertices.dequantScale;
+	dequantOffset = vertices.dequantOffset;
+	bounds = vertices.bounds;
+	sphere = vertices.sphere;
+
 	//Create a triangle
 	glGenVertexArrays(1, &VAO);
 	glGenBuffers(1, &VBO);
 	glGenBuffers(1, &EBO);
 
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size() * sizeof(Vertex)), vertices.data(), GL_STATIC_DRAW);
+	GLState::BindVertexArray(VAO);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.data.size()), vertices.data.data(), GL_STATIC_DRAW);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(elements.size() * sizeof(uint32_t)), elements.data(), GL_STATIC_DRAW);
+	// half the index memory and upload when every vertex fits in 16 bits
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	if (vertexCount <= 65536) {
+		std::vector<uint16_t> shortElements(elements.begin(), elements.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(shortElements.size() * sizeof(uint16_t)), shortElements.data(), GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_SHORT;
+	}
+	else {
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(elements.size_bytes()), elements.data(), GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_INT;
+	}
 
-	//define vertex attributes
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Position));
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Color));
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Uv));
+	//define vertex attributes from the layout, attributes it leaves out are never enabled
+	for (const auto& attribute : layout.attributes) {
+		glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized, static_cast<GLsizei>(layout.stride),
+			reinterpret_cast<const void*>(static_cast<uintptr_t>(attribute.offset)));
+		glEnableVertexAttribArray(attribute.location);
+	}
 
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glEnableVertexAttribArray(3);
+	elementCount = static_cast<uint32_t>(elements.size());
+}
 
-	elementCount = elements.size();
+glm::mat4 Mesh::Dequantize() const
+{
+	glm::mat4 dequantize(1.0f);
+	dequantize[0][0] = dequantScale.x;
+	dequantize[1][1] = dequantScale.y;
+	dequantize[2][2] = dequantScale.z;
+	dequantize[3] = glm::vec4(dequantOffset, 1.0f);
+	return dequantize;
 }
+
 // binds the vertex array and calls draw elements function
 void Mesh::Draw()
 {
 
-	// bind vertex array
-	glBindVertexArray(VAO);
+	// bind vertex array, skipped when it is already bound
+	GLState::BindVertexArray(VAO);
 
 	// gl draw calls
-	glDrawElements(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, nullptr);
+	glDrawElements(GL_TRIANGLES, elementCount, indexType, nullptr);
+	GLState::CountDraw();
+
+}
+
+void Mesh::DrawInstanced(const InstanceBuffer& instances, uint32_t count, uint32_t firstInstance)
+{
+	GLState::BindVertexArray(VAO);
+
+	// the per-instance attributes live in the VAO, so they only need to be set up when the buffer changes
+	if (instanceSource != instances.Buffer()) {
+		instanceSource = instances.Buffer();
+		GLState::BindBuffer(GL_ARRAY_BUFFER, instanceSource);
+		for (GLuint column = 0; column < 4; ++column) {
+			GLuint location = InstanceModelLocation + column;
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+				reinterpret_cast<const void*>(offsetof(InstanceData, model) + sizeof(glm::vec4) * column));
+			glVertexAttribDivisor(location, 1);
+			glEnableVertexAttribArray(location);
+		}
+		glVertexAttribIPointer(InstanceMaterialLocation, 1, GL_UNSIGNED_INT, sizeof(InstanceData),
+			reinterpret_cast<const void*>(offsetof(InstanceData, material)));
+		glVertexAttribDivisor(InstanceMaterialLocation, 1);
+		glEnableVertexAttribArray(InstanceMaterialLocation);
+	}
 
+	// the base instance offsets the per-instance attributes, so several meshes can share one instance buffer
+	glDrawElementsInstancedBaseInstance(GL_TRIANGLES, static_cast<GLsizei>(elementCount), indexType, nullptr,
+		static_cast<GLsizei>(count), firstInstance);
+	GLState::CountDraw();
+}
+
+void Mesh::Destroy()
+{
+	GLState::ForgetVertexArray(VAO);
+	GLState::ForgetBuffer(VBO);
+	GLState::ForgetBuffer(EBO);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	VAO = VBO = EBO = 0;
+	instanceSource = 0;
+	elementCount = 0;
 }
@@ -0,0 +1,329 @@
+/*
+*
+* Defines the baked mesh reader and writer and the memory mapped file they use
+*
+*/
+
+#include <mesh_file.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + MeshFileAlignment - 1) / MeshFileAlignment * MeshFileAlignment;
+	}
+
+	// a section must lie inside the file and start on a boundary the element type can be read from
+	bool sectionFits(uint64_t offset, uint64_t bytes, size_t fileSize)
+	{
+		return offset % MeshFileAlignment == 0 && offset <= fileSize && bytes <= fileSize - offset;
+	}
+
+	VertexFormat streamFormat(const MeshFileStream& stream)
+	{
+		return { static_cast<PositionFormat>(stream.position), static_cast<NormalFormat>(stream.normal), static_cast<UvFormat>(stream.uv) };
+	}
+
+	bool streamValid(const MeshFileStream& stream, uint32_t vertexCount, size_t fileSize)
+	{
+		if (stream.position > static_cast<uint8_t>(PositionFormat::Half3) || stream.normal > static_cast<uint8_t>(NormalFormat::Oct16)
+			|| stream.uv > static_cast<uint8_t>(UvFormat::Unorm16)) {
+			return false;
+		}
+		return stream.stride == VertexPacking::MakeLayout(streamFormat(stream)).stride
+			&& sectionFits(stream.offset, static_cast<uint64_t>(stream.stride) * vertexCount, fileSize);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	HANDLE fileMapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!fileMapping) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	void* view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(fileMapping);
+		CloseHandle(handle);
+		return false;
+	}
+
+	file = handle;
+	mapping = fileMapping;
+	data = static_cast<const uint8_t*>(view);
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor < 0) {
+		return false;
+	}
+
+	struct stat status {};
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+		close(descriptor);
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	// the mapping keeps the file alive on its own
+	close(descriptor);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+
+	// the whole file is read front to back by the upload
+	madvise(view, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL | MADV_WILLNEED);
+	data = static_cast<const uint8_t*>(view);
+	size = static_cast<size_t>(status.st_size);
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!data) {
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mapping);
+	CloseHandle(file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(data), size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+bool MeshFile::Open(const std::filesystem::path& path, uint64_t sourceHash)
+{
+	Close();
+
+	if (!file.Open(path)) {
+		return false;
+	}
+
+	if (file.Size() < sizeof(MeshFileHeader)) {
+		std::cerr << "Baked mesh is truncated: " << path.string() << std::endl;
+		Close();
+		return false;
+	}
+
+	std::memcpy(&header, file.Data(), sizeof(header));
+	if (header.magic != MeshFileMagic || header.version != MeshFileVersion || header.vertexStride != sizeof(Vertex)) {
+		std::cerr << "Baked mesh has an unknown format, bake it again: " << path.string() << std::endl;
+		Close();
+		return false;
+	}
+
+	if (sourceHash != 0 && header.sourceHash != sourceHash) {
+		std::cerr << "Baked mesh is older than its source, bake it again: " << path.string() << std::endl;
+		Close();
+		return false;
+	}
+
+	uint64_t vertexBytes = static_cast<uint64_t>(header.vertexCount) * sizeof(Vertex);
+	uint64_t indexBytes = static_cast<uint64_t>(header.indexCount) * sizeof(uint32_t);
+	uint64_t submeshBytes = static_cast<uint64_t>(header.submeshCount) * sizeof(Submesh);
+	bool streamsFit = header.streamCount <= MeshFileMaxStreams
+		&& std::all_of(header.streams, header.streams + std::min<size_t>(header.streamCount, MeshFileMaxStreams), [this](const MeshFileStream& stream) {
+			return streamValid(stream, header.vertexCount, file.Size());
+		});
+	if (!sectionFits(header.vertexOffset, vertexBytes, file.Size()) || !sectionFits(header.indexOffset, indexBytes, file.Size())
+		|| !sectionFits(header.submeshOffset, submeshBytes, file.Size()) || !streamsFit) {
+		std::cerr << "Baked mesh sections are out of bounds: " << path.string() << std::endl;
+		Close();
+		return false;
+	}
+
+	// the mapping is page aligned and the sections are aligned within it, so the data can be used in place
+	vertices = { reinterpret_cast<const Vertex*>(file.Data() + header.vertexOffset), header.vertexCount };
+	indices = { reinterpret_cast<const uint32_t*>(file.Data() + header.indexOffset), header.indexCount };
+	submeshes = { reinterpret_cast<const Submesh*>(file.Data() + header.submeshOffset), header.submeshCount };
+
+	// the data goes straight to the GPU, the BVH, and the CPU renderers, so a corrupt index must not get that far
+	bool indicesFit = std::all_of(indices.begin(), indices.end(), [this](uint32_t index) { return index < header.vertexCount; });
+	bool submeshesFit = std::all_of(submeshes.begin(), submeshes.end(), [this](const Submesh& submesh) {
+		return static_cast<uint64_t>(submesh.indexOffset) + submesh.indexCount <= header.indexCount;
+	});
+	if (!indicesFit || !submeshesFit) {
+		std::cerr << "Baked mesh indices are out of bounds: " << path.string() << std::endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool MeshFile::PackedStream(const VertexFormat& format, PackedVertexView& view) const
+{
+	for (uint32_t i = 0; i < header.streamCount; ++i) {
+		const MeshFileStream& stream = header.streams[i];
+		if (streamFormat(stream) != format) {
+			continue;
+		}
+
+		// only the attribute table is built, the vertex data stays in the mapping
+		view.layout = VertexPacking::MakeLayout(format);
+		view.data = { file.Data() + stream.offset, static_cast<size_t>(stream.stride) * header.vertexCount };
+		view.count = header.vertexCount;
+		view.dequantScale = stream.dequantScale;
+		view.dequantOffset = stream.dequantOffset;
+		view.bounds = stream.bounds;
+		view.sphere = stream.sphere;
+		return true;
+	}
+	return false;
+}
+
+void MeshFile::Close()
+{
+	vertices = {};
+	indices = {};
+	submeshes = {};
+	header = MeshFileHeader{};
+	file.Close();
+}
+
+MeshBounds MeshFile::ComputeBounds(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+	MeshBounds bounds;
+	if (indices.empty()) {
+		return bounds;
+	}
+
+	bounds.min = bounds.max = vertices[indices[0]].Position;
+	for (uint32_t index : indices) {
+		bounds.min = glm::min(bounds.min, vertices[index].Position);
+		bounds.max = glm::max(bounds.max, vertices[index].Position);
+	}
+	return bounds;
+}
+
+uint64_t MeshFile::SourceHash(std::span<const Vertex> vertices, std::span<const uint32_t> indices, std::span<const Submesh> submeshes)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const void* bytes, size_t byteCount) {
+		const uint8_t* data = static_cast<const uint8_t*>(bytes);
+		for (size_t i = 0; i < byteCount; ++i) {
+			hash = (hash ^ data[i]) * 1099511628211ull;
+		}
+	};
+
+	uint64_t counts[] = { vertices.size(), indices.size(), submeshes.size() };
+	mix(counts, sizeof(counts));
+	mix(vertices.data(), vertices.size_bytes());
+	mix(indices.data(), indices.size_bytes());
+	// only the ranges, the bounds are filled in while baking
+	for (const Submesh& submesh : submeshes) {
+		mix(&submesh.indexOffset, sizeof(submesh.indexOffset));
+		mix(&submesh.indexCount, sizeof(submesh.indexCount));
+	}
+	return hash;
+}
+
+bool MeshFile::Write(const std::filesystem::path& path, std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+	std::span<const Submesh> submeshes, uint64_t sourceHash, std::span<const VertexFormat> packedFormats)
+{
+	std::vector<Submesh> sections(submeshes.begin(), submeshes.end());
+	if (sections.empty()) {
+		sections.push_back(Submesh{ 0, static_cast<uint32_t>(indices.size()), {} });
+	}
+	for (auto& submesh : sections) {
+		submesh.bounds = ComputeBounds(vertices, indices.subspan(submesh.indexOffset, submesh.indexCount));
+	}
+
+	MeshFileHeader header;
+	header.magic = MeshFileMagic;
+	header.version = MeshFileVersion;
+	header.vertexStride = sizeof(Vertex);
+	header.vertexCount = static_cast<uint32_t>(vertices.size());
+	header.indexCount = static_cast<uint32_t>(indices.size());
+	header.submeshCount = static_cast<uint32_t>(sections.size());
+	header.vertexOffset = alignOffset(sizeof(MeshFileHeader));
+	header.indexOffset = alignOffset(header.vertexOffset + vertices.size_bytes());
+	header.submeshOffset = alignOffset(header.indexOffset + indices.size_bytes());
+	header.sourceHash = sourceHash;
+	header.bounds = ComputeBounds(vertices, indices);
+
+	std::vector<PackedVertices> packedStreams;
+	uint64_t streamOffset = alignOffset(header.submeshOffset + sections.size() * sizeof(Submesh));
+	for (const VertexFormat& format : packedFormats.first(std::min(packedFormats.size(), MeshFileMaxStreams))) {
+		const PackedVertices& packed = packedStreams.emplace_back(VertexPacking::Pack(vertices, format));
+		MeshFileStream& stream = header.streams[header.streamCount++];
+		// the packer can fall back to another format, the stream records what was actually written
+		stream.position = static_cast<uint8_t>(packed.layout.format.position);
+		stream.normal = static_cast<uint8_t>(packed.layout.format.normal);
+		stream.uv = static_cast<uint8_t>(packed.layout.format.uv);
+		stream.stride = packed.layout.stride;
+		stream.offset = streamOffset;
+		stream.dequantScale = packed.dequantScale;
+		stream.dequantOffset = packed.dequantOffset;
+		stream.bounds = packed.bounds;
+		stream.sphere = packed.sphere;
+		streamOffset = alignOffset(streamOffset + packed.data.size());
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out) {
+		std::cerr << "Failed to open baked mesh for writing: " << path.string() << std::endl;
+		return false;
+	}
+
+	// zero padding between sections keeps every section on an aligned offset
+	auto writeAt = [&out](uint64_t offset, const void* bytes, size_t byteCount) {
+		static const char padding[MeshFileAlignment] = {};
+		uint64_t position = static_cast<uint64_t>(out.tellp());
+		out.write(padding, static_cast<std::streamsize>(offset - position));
+		out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(byteCount));
+	};
+
+	writeAt(0, &header, sizeof(header));
+	writeAt(header.vertexOffset, vertices.data(), vertices.size_bytes());
+	writeAt(header.indexOffset, indices.data(), indices.size_bytes());
+	writeAt(header.submeshOffset, sections.data(), sections.size() * sizeof(Submesh));
+	for (size_t i = 0; i < packedStreams.size(); ++i) {
+		writeAt(header.streams[i].offset, packedStreams[i].data.data(), packedStreams[i].data.size());
+	}
+	return static_cast<bool>(out);
+}
@@ -0,0 +1,395 @@
+/*
+*
+* Defines the quadric error simplifier and the level selection used by the renderer
+*
+*/
+
+#include <mesh_lod.h>
+#include <shape_generators.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+	// sum of squared distances to a set of planes, weighted by triangle area
+	struct Quadric {
+		double xx{ 0 }, yy{ 0 }, zz{ 0 }, xy{ 0 }, xz{ 0 }, yz{ 0 }, xw{ 0 }, yw{ 0 }, zw{ 0 }, ww{ 0 };
+		double weight{ 0 };
+
+		void AddPlane(const glm::dvec3& normal, double distance, double planeWeight)
+		{
+			xx += planeWeight * normal.x * normal.x;
+			yy += planeWeight * normal.y * normal.y;
+			zz += planeWeight * normal.z * normal.z;
+			xy += planeWeight * normal.x * normal.y;
+			xz += planeWeight * normal.x * normal.z;
+			yz += planeWeight * normal.y * normal.z;
+			xw += planeWeight * normal.x * distance;
+			yw += planeWeight * normal.y * distance;
+			zw += planeWeight * normal.z * distance;
+			ww += planeWeight * distance * distance;
+			weight += planeWeight;
+		}
+
+		void Add(const Quadric& other)
+		{
+			xx += other.xx; yy += other.yy; zz += other.zz;
+			xy += other.xy; xz += other.xz; yz += other.yz;
+			xw += other.xw; yw += other.yw; zw += other.zw;
+			ww += other.ww;
+			weight += other.weight;
+		}
+
+		// mean squared distance of p to the planes, used to order the collapses. It averages over the planes,
+		// so it is not a bound on how far the surface moved
+		double Error(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double sum = xx * x * x + yy * y * y + zz * z * z + 2.0 * (xy * x * y + xz * x * z + yz * y * z + xw * x + yw * y + zw * z) + ww;
+			return weight > 0.0 ? std::max(sum, 0.0) / weight : 0.0;
+		}
+	};
+
+	struct Collapse {
+		uint32_t from; // vertex that moves
+		uint32_t to; // vertex it moves onto
+		double cost;
+	};
+
+	struct PositionHash {
+		size_t operator()(const glm::vec3& p) const
+		{
+			uint32_t bits[3];
+			std::memcpy(bits, &p, sizeof(bits));
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+
+	uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+	}
+
+	// keeps only the referenced vertices, in first use order
+	LodLevel compact(std::span<const Vertex> vertices, std::vector<uint32_t> indices, float error)
+	{
+		LodLevel level;
+		level.error = error;
+		std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+		for (uint32_t& index : indices) {
+			if (remap[index] == UINT32_MAX) {
+				remap[index] = static_cast<uint32_t>(level.vertices.size());
+				level.vertices.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		level.indices = std::move(indices);
+		return level;
+	}
+
+	// distance from p to the closest point of triangle abc, from Ericson's Real-Time Collision Detection
+	double pointTriangleDistance(const glm::dvec3& p, const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c)
+	{
+		glm::dvec3 ab = b - a, ac = c - a, ap = p - a;
+		double d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		if (d1 <= 0.0 && d2 <= 0.0) {
+			return glm::length(ap);
+		}
+		glm::dvec3 bp = p - b;
+		double d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		if (d3 >= 0.0 && d4 <= d3) {
+			return glm::length(bp);
+		}
+		double vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) {
+			return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+		}
+		glm::dvec3 cp = p - c;
+		double d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		if (d6 >= 0.0 && d5 <= d6) {
+			return glm::length(cp);
+		}
+		double vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) {
+			return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+		}
+		double va = d3 * d6 - d5 * d4;
+		if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0) {
+			return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+		}
+		double denominator = 1.0 / (va + vb + vc);
+		return glm::length(p - (a + ab * (vb * denominator) + ac * (vc * denominator)));
+	}
+
+	// the largest distance between a circle and a polygon with this many segments inscribed in it
+	float chordError(float radius, int segments)
+	{
+		return radius * (1.0f - std::cos(3.1415926f / segments));
+	}
+}
+
+std::vector<uint32_t> MeshLod::Simplify(std::span<const Vertex> vertices, std::span<const uint32_t> indices, size_t targetIndexCount, float& error)
+{
+	std::vector<uint32_t> result(indices.begin(), indices.end());
+	const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+	// vertices that share a position are one point of the surface, the first of them stands for the rest
+	std::vector<uint32_t> position(vertexCount);
+	std::vector<uint32_t> copies(vertexCount, 0);
+	std::unordered_map<glm::vec3, uint32_t, PositionHash> firstAt;
+	firstAt.reserve(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		position[v] = firstAt.try_emplace(vertices[v].Position, v).first->second;
+		++copies[position[v]];
+	}
+
+	// a point with several vertices sits on a UV or normal seam, an edge used by one triangle is an open border.
+	// Moving either would tear the mesh or its texture mapping
+	std::vector<uint8_t> locked(vertexCount, 0);
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		locked[v] = copies[position[v]] > 1;
+	}
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	edgeUses.reserve(result.size());
+	for (size_t i = 0; i < result.size(); i += 3) {
+		for (int e = 0; e < 3; ++e) {
+			++edgeUses[edgeKey(position[result[i + e]], position[result[i + (e + 1) % 3]])];
+		}
+	}
+	for (const auto& [key, uses] : edgeUses) {
+		if (uses == 1) {
+			locked[key >> 32] = 1;
+			locked[key & 0xffffffffu] = 1;
+		}
+	}
+
+	// planes of every triangle around a point
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < result.size(); i += 3) {
+		glm::dvec3 p0 = vertices[result[i]].Position, p1 = vertices[result[i + 1]].Position, p2 = vertices[result[i + 2]].Position;
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double area = glm::length(normal);
+		if (area <= 0.0) {
+			continue;
+		}
+		normal /= area;
+		for (int corner = 0; corner < 3; ++corner) {
+			quadrics[position[result[i + corner]]].AddPlane(normal, -glm::dot(normal, p0), area);
+		}
+	}
+
+	std::vector<Collapse> candidates;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint8_t> touched(vertexCount);
+	std::vector<uint32_t> adjacencyStart(vertexCount + 1), adjacency;
+	std::vector<uint32_t> collapsedOnto(vertexCount); // point each point was moved onto, itself while it is still there
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		collapsedOnto[v] = v;
+	}
+
+	// every pass collapses a set of edges that do not share a neighborhood, then rewrites the triangles
+	while (result.size() > targetIndexCount) {
+		size_t triangleCount = result.size() / 3;
+
+		// triangles around each point, for the flip test
+		std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+		for (uint32_t index : result) {
+			++adjacencyStart[position[index] + 1];
+		}
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			adjacencyStart[v + 1] += adjacencyStart[v];
+		}
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (size_t i = 0; i < result.size(); ++i) {
+			adjacency[fill[position[result[i]]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		candidates.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int e = 0; e < 3; ++e) {
+				uint32_t a = result[i + e], b = result[i + (e + 1) % 3];
+				uint32_t pa = position[a], pb = position[b];
+				if (pa == pb) {
+					continue;
+				}
+				Quadric combined = quadrics[pa];
+				combined.Add(quadrics[pb]);
+				if (!locked[a]) {
+					candidates.push_back({ a, b, combined.Error(vertices[b].Position) });
+				}
+				if (!locked[b]) {
+					candidates.push_back({ b, a, combined.Error(vertices[a].Position) });
+				}
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.cost < rhs.cost; });
+
+		// each collapse removes about two triangles
+		size_t collapseLimit = (triangleCount - targetIndexCount / 3) / 2 + 1;
+		size_t collapses = 0;
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			remap[v] = v;
+		}
+		std::fill(touched.begin(), touched.end(), 0);
+
+		for (const Collapse& collapse : candidates) {
+			if (collapses >= collapseLimit) {
+				break;
+			}
+			uint32_t from = position[collapse.from], to = position[collapse.to];
+			if (touched[from] || touched[to]) {
+				continue;
+			}
+
+			// moving the point must not turn any of its other triangles over
+			glm::vec3 target = vertices[collapse.to].Position;
+			bool flips = false;
+			for (uint32_t a = adjacencyStart[from]; a < adjacencyStart[from + 1] && !flips; ++a) {
+				const uint32_t* triangle = &result[adjacency[a] * 3];
+				glm::vec3 p[3];
+				bool hasTo = false;
+				for (int corner = 0; corner < 3; ++corner) {
+					p[corner] = vertices[triangle[corner]].Position;
+					hasTo |= position[triangle[corner]] == to;
+				}
+				if (hasTo) {
+					continue; // this one collapses away
+				}
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				for (int corner = 0; corner < 3; ++corner) {
+					if (position[triangle[corner]] == from) {
+						p[corner] = target;
+					}
+				}
+				glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+				flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+			}
+			if (flips) {
+				continue;
+			}
+
+			// the neighborhood is frozen for the rest of the pass so the flip tests above stay valid
+			for (uint32_t a = adjacencyStart[from]; a < adjacencyStart[from + 1]; ++a) {
+				for (int corner = 0; corner < 3; ++corner) {
+					touched[position[result[adjacency[a] * 3 + corner]]] = 1;
+				}
+			}
+			remap[collapse.from] = collapse.to;
+			quadrics[to].Add(quadrics[from]);
+			collapsedOnto[from] = to;
+			++collapses;
+		}
+
+		if (collapses == 0) {
+			break;
+		}
+
+		size_t written = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+			if (position[a] == position[b] || position[b] == position[c] || position[a] == position[c]) {
+				continue;
+			}
+			result[written++] = a;
+			result[written++] = b;
+			result[written++] = c;
+		}
+		result.resize(written);
+	}
+
+	// the error is the largest distance from a removed point to the simplified triangles around the point it ended up on.
+	// The remaining vertices are authored ones, so this bounds how far the surface moved at every authored vertex
+	std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+	for (uint32_t index : result) {
+		++adjacencyStart[position[index] + 1];
+	}
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		adjacencyStart[v + 1] += adjacencyStart[v];
+	}
+	adjacency.resize(result.size());
+	std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t i = 0; i < result.size(); ++i) {
+		adjacency[fill[position[result[i]]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	double maxDistance = 0.0;
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		if (position[v] != v || collapsedOnto[v] == v) {
+			continue;
+		}
+		uint32_t survivor = v;
+		while (collapsedOnto[survivor] != survivor) {
+			survivor = collapsedOnto[survivor];
+		}
+
+		glm::dvec3 p = vertices[v].Position;
+		double distance = glm::length(p - glm::dvec3(vertices[survivor].Position));
+		for (uint32_t a = adjacencyStart[survivor]; a < adjacencyStart[survivor + 1]; ++a) {
+			const uint32_t* triangle = &result[adjacency[a] * 3];
+			distance = std::min(distance, pointTriangleDistance(p, vertices[triangle[0]].Position, vertices[triangle[1]].Position, vertices[triangle[2]].Position));
+		}
+		maxDistance = std::max(maxDistance, distance);
+	}
+
+	error = static_cast<float>(maxDistance);
+	return result;
+}
+
+std::vector<LodLevel> MeshLod::BuildChain(std::span<const Vertex> vertices, std::span<const uint32_t> indices, uint32_t maxLevels, float ratio)
+{
+	std::vector<LodLevel> levels;
+	size_t previousCount = indices.size();
+	float previousError = 0.0f;
+	size_t target = indices.size();
+	for (uint32_t level = 0; level < maxLevels; ++level) {
+		// every level starts from the full mesh so its error is measured against the authored surface
+		target = static_cast<size_t>(target / 3 * ratio) * 3;
+		float error = 0.0f;
+		std::vector<uint32_t> simplified = Simplify(vertices, indices, target, error);
+		if (simplified.empty() || simplified.size() > previousCount * 9 / 10) {
+			break;
+		}
+
+		previousCount = simplified.size();
+		previousError = std::max(previousError, error);
+		levels.push_back(compact(vertices, std::move(simplified), previousError));
+	}
+	return levels;
+}
+
+std::vector<LodLevel> MeshLod::SphereCylinderChain(float cylinderRadius, float cylinderHeight, float sphereRadius, int segments, uint32_t maxLevels)
+{
+	std::vector<LodLevel> levels;
+	for (int levelSegments = segments / 2; levelSegments >= 4 && levels.size() < maxLevels; levelSegments /= 2) {
+		ShapeGenerators::ShapeCounts counts = ShapeGenerators::SphereCylinderCounts(levelSegments, levelSegments);
+		LodLevel level;
+		level.vertices.resize(counts.vertices);
+		level.indices.resize(counts.indices);
+		ShapeGenerators::WriteSphereCylinder(level.vertices, level.indices, cylinderRadius, cylinderHeight, levelSegments, sphereRadius, levelSegments);
+		level.error = std::max(chordError(cylinderRadius, levelSegments), chordError(sphereRadius, levelSegments));
+		levels.push_back(std::move(level));
+	}
+	return levels;
+}
+
+float MeshLod::PixelsPerUnit(const glm::mat4& projection, float viewportHeight, float distance)
+{
+	float pixels = projection[1][1] * viewportHeight * 0.5f;
+
+	// a perspective projection has w = -z, an orthographic one keeps the same scale at any depth
+	bool perspective = projection[3][3] == 0.0f;
+	return perspective ? pixels / std::max(distance, 1.0e-3f) : pixels;
+}
+
+uint32_t MeshLod::SelectLevel(std::span<const float> errors, float pixelsPerUnit, uint32_t current)
+{
+	for (size_t level = errors.size(); level-- > 1;) {
+		float limit = level > current ? PixelThreshold * Hysteresis : PixelThreshold;
+		if (errors[level] * pixelsPerUnit <= limit) {
+			return static_cast<uint32_t>(level);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,400 @@
+/*
+*
+* Defines the vertex cache, overdraw, and vertex fetch optimizations
+*
+*/
+
+#include <mesh_optimizer.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+	// Forsyth's linear speed vertex cache optimization, scored against a 32 entry LRU cache
+	constexpr uint32_t ScoreCacheSize = 32;
+	constexpr float CacheDecayPower = 1.5f;
+	constexpr float LastTriangleScore = 0.75f;
+	constexpr float ValenceBoostScale = 2.0f;
+	constexpr float ValenceBoostPower = 0.5f;
+	constexpr uint32_t MaxValence = 32; // valence scores past this are all the same
+
+	struct ScoreTables {
+		std::array<float, ScoreCacheSize> cache{};
+		std::array<float, MaxValence + 1> valence{};
+
+		ScoreTables()
+		{
+			for (uint32_t position = 0; position < ScoreCacheSize; ++position) {
+				// the three vertices of the last triangle get a fixed score so the next triangle does not just reuse them
+				cache[position] = position < 3 ? LastTriangleScore
+					: std::pow(1.0f - static_cast<float>(position - 3) / (ScoreCacheSize - 3), CacheDecayPower);
+			}
+			for (uint32_t count = 1; count <= MaxValence; ++count) {
+				// vertices with few triangles left are boosted so they get finished and stop being needed
+				valence[count] = ValenceBoostScale * std::pow(static_cast<float>(count), -ValenceBoostPower);
+			}
+		}
+	};
+
+	float vertexScore(const ScoreTables& tables, int cachePosition, uint32_t remaining)
+	{
+		if (remaining == 0) {
+			return -1.0f;
+		}
+		float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+		return score + tables.valence[std::min(remaining, MaxValence)];
+	}
+
+	// FIFO cache misses of a triangle list, for the statistics and the overdraw clustering
+	class FifoCache {
+	public:
+		FifoCache(uint32_t vertexCount, uint32_t size)
+			: stamps(vertexCount, 0), cacheSize(size)
+		{
+		}
+
+		// returns true when the vertex had to be transformed
+		bool Touch(uint32_t vertex)
+		{
+			if (stamps[vertex] != 0 && time - stamps[vertex] < cacheSize) {
+				return false;
+			}
+			stamps[vertex] = ++time;
+			return true;
+		}
+
+	private:
+		std::vector<uint32_t> stamps; // the time a vertex entered the cache, a FIFO only moves on a miss
+		uint32_t cacheSize;
+		uint32_t time{ 0 };
+	};
+}
+
+size_t MeshOptimizer::WeldVertices(std::vector<Vertex>& vertices, std::span<uint32_t> indices, float tolerance)
+{
+	struct Cell {
+		int32_t x, y, z;
+		bool operator==(const Cell&) const = default;
+	};
+	struct CellHash {
+		size_t operator()(const Cell& cell) const
+		{
+			return (static_cast<uint32_t>(cell.x) * 73856093u) ^ (static_cast<uint32_t>(cell.y) * 19349663u) ^ (static_cast<uint32_t>(cell.z) * 83492791u);
+		}
+	};
+
+	auto within = [tolerance](const auto& a, const auto& b) {
+		return glm::all(glm::lessThanEqual(glm::abs(a - b), decltype(a - b)(tolerance)));
+	};
+	auto same = [&](const Vertex& a, const Vertex& b) {
+		return within(a.Position, b.Position) && within(a.Normal, b.Normal) && within(a.Uv, b.Uv) && within(a.Color, b.Color);
+	};
+
+	// kept vertices are hashed by a grid of cells at least tolerance wide, so a match can only be in the same or a
+	// neighboring cell. Cells are counted from the bounds minimum and widened on large meshes so every index fits in 30 bits
+	glm::vec3 lower(0.0f), upper(0.0f);
+	if (!vertices.empty()) {
+		lower = upper = vertices[0].Position;
+		for (const Vertex& vertex : vertices) {
+			lower = glm::min(lower, vertex.Position);
+			upper = glm::max(upper, vertex.Position);
+		}
+	}
+	const glm::vec3 extent = upper - lower;
+	const double cellSize = std::max({ static_cast<double>(tolerance), 1.0e-7, static_cast<double>(std::max({ extent.x, extent.y, extent.z })) / (1 << 30) });
+	auto cellAxis = [cellSize](float value, float origin) {
+		// NaN and infinite coordinates land in cell 0 instead of overflowing the conversion
+		double cell = std::floor((static_cast<double>(value) - origin) / cellSize);
+		return std::isfinite(cell) ? static_cast<int32_t>(std::clamp(cell, 0.0, static_cast<double>(1 << 30))) : 0;
+	};
+	auto cellOf = [&](const glm::vec3& p) {
+		return Cell{ cellAxis(p.x, lower.x), cellAxis(p.y, lower.y), cellAxis(p.z, lower.z) };
+	};
+
+	std::unordered_map<Cell, uint32_t, CellHash> cellHead; // first kept vertex in a cell, the rest chain through nextInCell
+	cellHead.reserve(vertices.size());
+	std::vector<uint32_t> nextInCell;
+	nextInCell.reserve(vertices.size());
+	std::vector<uint32_t> remap(vertices.size());
+	size_t kept = 0;
+
+	for (size_t v = 0; v < vertices.size(); ++v) {
+		const Vertex vertex = vertices[v];
+		Cell cell = cellOf(vertex.Position);
+		uint32_t match = UINT32_MAX;
+		for (int dz = -1; dz <= 1 && match == UINT32_MAX; ++dz) {
+			for (int dy = -1; dy <= 1 && match == UINT32_MAX; ++dy) {
+				for (int dx = -1; dx <= 1 && match == UINT32_MAX; ++dx) {
+					auto head = cellHead.find({ cell.x + dx, cell.y + dy, cell.z + dz });
+					for (uint32_t candidate = head == cellHead.end() ? UINT32_MAX : head->second; candidate != UINT32_MAX; candidate = nextInCell[candidate]) {
+						if (same(vertices[candidate], vertex)) {
+							match = candidate;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		if (match != UINT32_MAX) {
+			remap[v] = match;
+			continue;
+		}
+
+		// kept vertices are compacted toward the front as they are found, v is never behind kept
+		uint32_t index = static_cast<uint32_t>(kept++);
+		vertices[index] = vertex;
+		auto [head, inserted] = cellHead.try_emplace(cell, index);
+		nextInCell.push_back(inserted ? UINT32_MAX : head->second);
+		head->second = index;
+		remap[v] = index;
+	}
+
+	for (uint32_t& index : indices) {
+		index = remap[index];
+	}
+
+	size_t removed = vertices.size() - kept;
+	vertices.resize(kept);
+	return removed;
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+	CacheStats stats;
+	if (indices.empty()) {
+		return stats;
+	}
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<uint8_t> used(vertexCount, 0);
+	uint32_t transformed = 0, unique = 0;
+	for (uint32_t index : indices) {
+		transformed += cache.Touch(index);
+		unique += used[index] == 0;
+		used[index] = 1;
+	}
+
+	stats.acmr = static_cast<float>(transformed) / static_cast<float>(indices.size() / 3);
+	stats.atvr = static_cast<float>(transformed) / static_cast<float>(unique);
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount)
+{
+	static const ScoreTables tables;
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// triangles around every vertex
+	std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+	for (uint32_t index : indices) {
+		++adjacencyStart[index + 1];
+	}
+	std::partial_sum(adjacencyStart.begin(), adjacencyStart.end(), adjacencyStart.begin());
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t i = 0; i < indices.size(); ++i) {
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<uint32_t> remaining(vertexCount);
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		remaining[v] = adjacencyStart[v + 1] - adjacencyStart[v];
+		score[v] = vertexScore(tables, -1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	for (size_t t = 0; t < triangleCount; ++t) {
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+	}
+
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	// the cache holds up to ScoreCacheSize entries, plus room for the three a new triangle pushes in
+	std::vector<uint32_t> cache, nextCache;
+	cache.reserve(ScoreCacheSize + 3);
+	nextCache.reserve(ScoreCacheSize + 3);
+
+	size_t cursor = 0; // next triangle to try when nothing in the cache has triangles left
+	int64_t best = -1;
+	for (size_t t = 0; t < triangleCount; ++t) {
+		if (best < 0 || triangleScore[t] > triangleScore[best]) {
+			best = static_cast<int64_t>(t);
+		}
+	}
+
+	while (best >= 0) {
+		const uint32_t* triangle = &indices[best * 3];
+		output.insert(output.end(), triangle, triangle + 3);
+		emitted[best] = 1;
+
+		// the triangle's vertices move to the front, the rest shift back
+		nextCache.assign(triangle, triangle + 3);
+		for (uint32_t vertex : cache) {
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+				nextCache.push_back(vertex);
+			}
+		}
+		for (int corner = 0; corner < 3; ++corner) {
+			--remaining[triangle[corner]];
+		}
+		for (size_t position = ScoreCacheSize; position < nextCache.size(); ++position) {
+			cachePosition[nextCache[position]] = -1;
+			score[nextCache[position]] = vertexScore(tables, -1, remaining[nextCache[position]]);
+		}
+		if (nextCache.size() > ScoreCacheSize) {
+			// triangles of the evicted vertices are rescored with everything else below
+			for (size_t position = ScoreCacheSize; position < nextCache.size(); ++position) {
+				uint32_t vertex = nextCache[position];
+				for (uint32_t a = adjacencyStart[vertex]; a < adjacencyStart[vertex + 1]; ++a) {
+					uint32_t t = adjacency[a];
+					if (!emitted[t]) {
+						triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+					}
+				}
+			}
+			nextCache.resize(ScoreCacheSize);
+		}
+		std::swap(cache, nextCache);
+
+		for (size_t position = 0; position < cache.size(); ++position) {
+			cachePosition[cache[position]] = static_cast<int>(position);
+			score[cache[position]] = vertexScore(tables, static_cast<int>(position), remaining[cache[position]]);
+		}
+
+		// the next triangle is the best one touching the cache
+		best = -1;
+		for (uint32_t vertex : cache) {
+			for (uint32_t a = adjacencyStart[vertex]; a < adjacencyStart[vertex + 1]; ++a) {
+				uint32_t t = adjacency[a];
+				if (emitted[t]) {
+					continue;
+				}
+				triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+				if (best < 0 || triangleScore[t] > triangleScore[best]) {
+					best = t;
+				}
+			}
+		}
+
+		// dead end, start over at the next triangle in the input
+		if (best < 0) {
+			while (cursor < triangleCount && emitted[cursor]) {
+				++cursor;
+			}
+			best = cursor < triangleCount ? static_cast<int64_t>(cursor) : -1;
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2) {
+		return;
+	}
+	const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	float cacheAcmr = AnalyzeVertexCache(indices, vertexCount).acmr;
+
+	// a cluster starts wherever a triangle misses on all three vertices, i.e. the cache order jumped
+	std::vector<uint32_t> clusterStart;
+	FifoCache cache(vertexCount, ReportCacheSize);
+	for (size_t t = 0; t < triangleCount; ++t) {
+		int misses = cache.Touch(indices[t * 3]) + cache.Touch(indices[t * 3 + 1]) + cache.Touch(indices[t * 3 + 2]);
+		if (t == 0 || misses == 3) {
+			clusterStart.push_back(static_cast<uint32_t>(t));
+		}
+	}
+	if (clusterStart.size() < 2) {
+		return;
+	}
+	clusterStart.push_back(static_cast<uint32_t>(triangleCount));
+
+	glm::vec3 meshCenter(0.0f);
+	for (const Vertex& vertex : vertices) {
+		meshCenter += vertex.Position;
+	}
+	meshCenter /= static_cast<float>(vertices.size());
+
+	// how far a cluster faces out from the center, area weighted
+	struct Cluster {
+		uint32_t first;
+		uint32_t count;
+		float key;
+	};
+	std::vector<Cluster> clusters;
+	for (size_t c = 0; c + 1 < clusterStart.size(); ++c) {
+		glm::vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (uint32_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t) {
+			glm::vec3 p0 = vertices[indices[t * 3]].Position, p1 = vertices[indices[t * 3 + 1]].Position, p2 = vertices[indices[t * 3 + 2]].Position;
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(cross);
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		centroid = area > 0.0f ? centroid / area : vertices[indices[clusterStart[c] * 3]].Position;
+		float length = glm::length(normal);
+		float key = length > 0.0f ? glm::dot(centroid - meshCenter, normal / length) : 0.0f;
+		clusters.push_back({ clusterStart[c], clusterStart[c + 1] - clusterStart[c], key });
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& lhs, const Cluster& rhs) { return lhs.key > rhs.key; });
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(indices.size());
+	for (const Cluster& cluster : clusters) {
+		sorted.insert(sorted.end(), indices.begin() + cluster.first * 3, indices.begin() + (cluster.first + cluster.count) * 3);
+	}
+
+	// clusters cut the cache order, give up on overdraw when that costs too much
+	if (AnalyzeVertexCache(sorted, vertexCount).acmr <= cacheAcmr * threshold) {
+		std::copy(sorted.begin(), sorted.end(), indices.begin());
+	}
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::span<Vertex> vertices, std::span<uint32_t> indices)
+{
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	uint32_t next = 0;
+	for (uint32_t& index : indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = next++;
+		}
+		index = remap[index];
+	}
+	for (uint32_t& target : remap) {
+		if (target == UINT32_MAX) {
+			target = next++;
+		}
+	}
+
+	std::vector<Vertex> reordered(vertices.size());
+	for (size_t v = 0; v < vertices.size(); ++v) {
+		reordered[remap[v]] = vertices[v];
+	}
+	std::copy(reordered.begin(), reordered.end(), vertices.begin());
+}
+
+void MeshOptimizer::Optimize(std::span<Vertex> vertices, std::span<uint32_t> indices, std::span<const IndexRange> ranges)
+{
+	const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	IndexRange whole{ 0, static_cast<uint32_t>(indices.size()) };
+	for (const IndexRange& range : ranges.empty() ? std::span<const IndexRange>(&whole, 1) : ranges) {
+		std::span<uint32_t> rangeIndices = indices.subspan(range.offset, range.count);
+		OptimizeVertexCache(rangeIndices, vertexCount);
+		OptimizeOverdraw(rangeIndices, vertices);
+	}
+	OptimizeVertexFetch(vertices, indices);
+}
@@ -0,0 +1,178 @@
+/*
+*
+* Defines the path tracer, a diffuse path tracer with the key light sampled directly at every bounce
+*
+*/
+
+#include <path_tracer.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+namespace {
+	constexpr float Pi = 3.14159265358979f;
+	constexpr float RayOffset = 1.0e-4f; // keeps secondary rays from hitting the surface they leave
+
+	// pcg hash, a small random number generator whose state is one integer
+	uint32_t nextRandom(uint32_t& state)
+	{
+		state = state * 747796405u + 2891336453u;
+		uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	float randomFloat(uint32_t& state)
+	{
+		return (nextRandom(state) >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// cosine weighted direction around the normal, the Lambert term and pdf cancel
+	glm::vec3 cosineDirection(const glm::vec3& normal, uint32_t& state)
+	{
+		float r1 = randomFloat(state), r2 = randomFloat(state);
+		float phi = 2.0f * Pi * r1;
+		float radius = std::sqrt(r2);
+		glm::vec3 tangent = std::abs(normal.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		tangent = glm::normalize(glm::cross(tangent, normal));
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+		return glm::normalize(tangent * (radius * std::cos(phi)) + bitangent * (radius * std::sin(phi)) + normal * std::sqrt(1.0f - r2));
+	}
+}
+
+uint32_t PathTracer::AddMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+	meshes.push_back({ vertices, indices });
+	return scene.AddMesh(vertices, indices);
+}
+
+uint32_t PathTracer::AddTexture(Image image)
+{
+	textures.push_back(std::move(image));
+	return static_cast<uint32_t>(textures.size() - 1);
+}
+
+uint32_t PathTracer::AddObject(uint32_t mesh, const glm::mat4& world, uint32_t texture)
+{
+	objects.push_back({ texture, glm::transpose(glm::inverse(glm::mat3(world))) });
+	return scene.AddObject(mesh, world);
+}
+
+glm::vec3 PathTracer::trace(Ray ray, uint32_t maxBounces, uint32_t& state) const
+{
+	glm::vec3 radiance(0.0f);
+	glm::vec3 throughput(1.0f);
+	glm::vec3 lightDir = glm::normalize(lighting.keyLightDir);
+
+	for (uint32_t bounce = 0; bounce <= maxBounces; ++bounce) {
+		SceneHit hit;
+		if (!scene.Intersect(ray, hit)) {
+			// the ambient term of the shader is light arriving evenly from every direction
+			radiance += throughput * (bounce == 0 ? lighting.background : lighting.ambientStrength * lighting.keyLightColor);
+			break;
+		}
+
+		const MeshData& mesh = meshes[scene.ObjectMesh(hit.object)];
+		const ObjectData& object = objects[hit.object];
+		uint32_t triangle = hit.hit.triangle;
+		const Vertex& v0 = mesh.vertices[mesh.indices[triangle * 3]];
+		const Vertex& v1 = mesh.vertices[mesh.indices[triangle * 3 + 1]];
+		const Vertex& v2 = mesh.vertices[mesh.indices[triangle * 3 + 2]];
+		float u = hit.hit.u, v = hit.hit.v, w = 1.0f - u - v;
+
+		glm::vec3 position = ray.origin + ray.direction * hit.hit.distance;
+		glm::vec3 normal = glm::normalize(object.normalMatrix * (v0.Normal * w + v1.Normal * u + v2.Normal * v));
+		// surfaces are lit from either side, like the GL renderer with culling off. New rays leave along the
+		// face normal, the interpolated one can point below a coarse surface and make it shadow itself
+		glm::vec3 faceNormal = glm::normalize(object.normalMatrix * glm::cross(v1.Position - v0.Position, v2.Position - v0.Position));
+		if (glm::dot(faceNormal, ray.direction) > 0.0f) {
+			faceNormal = -faceNormal;
+		}
+		if (glm::dot(normal, faceNormal) < 0.0f) {
+			normal = -normal;
+		}
+		glm::vec3 albedo = Texture::SampleBilinear(textures[object.texture], v0.Uv * w + v1.Uv * u + v2.Uv * v);
+
+		// key light with a shadow ray, diffuse plus the shader's Phong highlight
+		float diffuse = glm::dot(normal, lightDir);
+		if (diffuse > 0.0f) {
+			Ray shadow;
+			shadow.origin = position + faceNormal * RayOffset;
+			shadow.direction = lightDir;
+			if (!scene.Occluded(shadow)) {
+				glm::vec3 reflected = glm::reflect(-lightDir, normal);
+				float specular = lighting.specularStrength * std::pow(std::max(glm::dot(-ray.direction, reflected), 0.0f), lighting.shininess);
+				radiance += throughput * albedo * lighting.keyLightColor * (diffuse + specular);
+			}
+		}
+
+		// continue the path in a cosine weighted direction, the Lambert BRDF leaves the albedo as the weight
+		throughput *= albedo;
+		ray.origin = position + faceNormal * RayOffset;
+		ray.direction = cosineDirection(normal, state);
+		if (glm::dot(ray.direction, faceNormal) <= 0.0f) {
+			break;
+		}
+		ray.tMax = std::numeric_limits<float>::infinity();
+	}
+	return radiance;
+}
+
+PathTraceStats PathTracer::Render(ThreadPool& pool, const PathTraceOptions& options, Image& output)
+{
+	scene.Update();
+
+	output.width = static_cast<int>(options.width);
+	output.height = static_cast<int>(options.height);
+	output.pixels.assign(static_cast<size_t>(options.width) * options.height * 4, 255);
+
+	glm::vec3 front = glm::normalize(camera.front);
+	glm::vec3 right = glm::normalize(glm::cross(front, camera.up));
+	glm::vec3 up = glm::cross(right, front);
+	float tanHalfFov = std::tan(glm::radians(camera.fovY) * 0.5f);
+	float aspect = static_cast<float>(options.width) / static_cast<float>(options.height);
+
+	uint32_t tileSize = std::max(options.tileSize, 1u);
+	uint32_t tilesX = (options.width + tileSize - 1) / tileSize;
+	uint32_t tilesY = (options.height + tileSize - 1) / tileSize;
+
+	// one tile per chunk, idle threads take the next tile from the shared counter so uneven tiles balance out
+	auto start = std::chrono::steady_clock::now();
+	pool.ParallelFor(static_cast<size_t>(tilesX) * tilesY, 1, [&](size_t begin, size_t end) {
+		for (size_t tile = begin; tile < end; ++tile) {
+			uint32_t x0 = static_cast<uint32_t>(tile % tilesX) * tileSize;
+			uint32_t y0 = static_cast<uint32_t>(tile / tilesX) * tileSize;
+			uint32_t x1 = std::min(x0 + tileSize, options.width);
+			uint32_t y1 = std::min(y0 + tileSize, options.height);
+
+			for (uint32_t y = y0; y < y1; ++y) {
+				for (uint32_t x = x0; x < x1; ++x) {
+					uint32_t state = (y * options.width + x) * 9781u + 1u;
+					glm::vec3 color(0.0f);
+					for (uint32_t sample = 0; sample < options.samples; ++sample) {
+						// jittered inside the pixel, row 0 is the top of the image
+						float px = (x + randomFloat(state)) / options.width * 2.0f - 1.0f;
+						float py = 1.0f - (y + randomFloat(state)) / options.height * 2.0f;
+
+						Ray ray;
+						ray.origin = camera.position;
+						ray.direction = glm::normalize(front + right * (px * tanHalfFov * aspect) + up * (py * tanHalfFov));
+						color += trace(ray, options.maxBounces, state);
+					}
+					color = glm::clamp(color / static_cast<float>(std::max(options.samples, 1u)), 0.0f, 1.0f);
+
+					uint8_t* pixel = &output.pixels[(static_cast<size_t>(y) * options.width + x) * 4];
+					pixel[0] = static_cast<uint8_t>(color.r * 255.0f + 0.5f);
+					pixel[1] = static_cast<uint8_t>(color.g * 255.0f + 0.5f);
+					pixel[2] = static_cast<uint8_t>(color.b * 255.0f + 0.5f);
+				}
+			}
+		}
+	});
+
+	PathTraceStats stats;
+	stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	stats.samples = static_cast<uint64_t>(options.width) * options.height * options.samples;
+	stats.threads = pool.ThreadCount() + 1;
+	return stats;
+}
@@ -0,0 +1,89 @@
+/*
+*
+* Defines the pixel buffer ring used for streaming texture uploads
+*
+*/
+
+#include <pixel_buffer_ring.h>
+#include <gl_state.h>
+
+void PixelBufferRing::Create(size_t segmentBytes, uint32_t segmentCount)
+{
+	segmentSize = segmentBytes;
+	current = 0;
+	fences.assign(segmentCount, nullptr);
+
+	GLsizeiptr totalSize = static_cast<GLsizeiptr>(segmentBytes * segmentCount);
+	glGenBuffers(1, &buffer);
+	GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+
+	persistent = GLAD_GL_VERSION_4_4 != 0;
+	if (persistent) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, totalSize, nullptr, flags);
+		persistentPointer = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, totalSize, flags));
+		persistent = persistentPointer != nullptr;
+	}
+	if (!persistent) {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+	}
+
+	// client memory uploads elsewhere expect no pixel buffer to be bound
+	GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void PixelBufferRing::Destroy()
+{
+	for (auto& fence : fences) {
+		if (fence) {
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	if (persistentPointer) {
+		GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		persistentPointer = nullptr;
+	}
+
+	GLState::ForgetBuffer(buffer);
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+uint8_t* PixelBufferRing::Map(GLintptr& offset)
+{
+	current = (current + 1) % static_cast<uint32_t>(fences.size());
+	offset = static_cast<GLintptr>(segmentSize * current);
+
+	// the GPU may still be copying out of this segment from a few uploads ago
+	if (fences[current]) {
+		glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(fences[current]);
+		fences[current] = nullptr;
+	}
+
+	GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	if (persistent) {
+		return persistentPointer + offset;
+	}
+
+	// the fence already guarantees the range is idle, so the driver does not need to synchronize
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+	return static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, static_cast<GLsizeiptr>(segmentSize), flags));
+}
+
+void PixelBufferRing::Unmap()
+{
+	if (!persistent) {
+		GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+}
+
+void PixelBufferRing::Fence()
+{
+	fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,90 @@
+/*
+*
+* Defines the ray query scene, rays are moved into each object's space and tested against its mesh
+*
+*/
+
+#include <ray_scene.h>
+#include <algorithm>
+
+uint32_t RayScene::AddMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+	meshes.emplace_back().Build(vertices, indices);
+	return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+uint32_t RayScene::AddObject(uint32_t mesh, const glm::mat4& world)
+{
+	objects.push_back({ mesh, world, glm::inverse(world) });
+	objectBounds.push_back(TransformBounds(meshes[mesh].Bounds(), world));
+	rebuild = true;
+	return static_cast<uint32_t>(objects.size() - 1);
+}
+
+void RayScene::SetTransform(uint32_t object, const glm::mat4& world)
+{
+	objects[object].world = world;
+	objects[object].inverse = glm::inverse(world);
+	objectBounds[object] = TransformBounds(meshes[objects[object].mesh].Bounds(), world);
+}
+
+void RayScene::Update()
+{
+	// moving objects keep the tree shape, a new object set needs a fresh build
+	if (rebuild) {
+		objectBvh.Build(objectBounds);
+		rebuild = false;
+	}
+	else {
+		objectBvh.Refit(objectBounds);
+	}
+}
+
+template <bool AnyHit>
+bool RayScene::traverse(const Ray& ray, SceneHit& hit) const
+{
+	bool found = false;
+	objectBvh.TraverseRay(ray, [&](uint32_t first, uint32_t count, const Ray& current) {
+		float closest = std::numeric_limits<float>::infinity();
+		for (uint32_t i = first; i < first + count; ++i) {
+			uint32_t item = objectBvh.Items()[i];
+
+			// the direction is not renormalized, so distances along the local ray match the world ray
+			const Object& object = objects[item];
+			Ray local;
+			local.origin = glm::vec3(object.inverse * glm::vec4(current.origin, 1.0f));
+			local.direction = glm::vec3(object.inverse * glm::vec4(current.direction, 0.0f));
+			local.tMax = std::min(current.tMax, closest);
+
+			const TriangleBvh& triangles = meshes[object.mesh];
+			if constexpr (AnyHit) {
+				if (triangles.Occluded(local)) {
+					hit.object = item;
+					found = true;
+					return -1.0f;
+				}
+			}
+			else {
+				RayHit meshHit;
+				if (triangles.Intersect(local, meshHit)) {
+					closest = meshHit.distance;
+					hit = { item, meshHit };
+					found = true;
+				}
+			}
+		}
+		return closest;
+	});
+	return found;
+}
+
+bool RayScene::Intersect(const Ray& ray, SceneHit& hit) const
+{
+	return traverse<false>(ray, hit);
+}
+
+bool RayScene::Occluded(const Ray& ray) const
+{
+	SceneHit hit;
+	return traverse<true>(ray, hit);
+}
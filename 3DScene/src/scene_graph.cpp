@@ -0,0 +1,71 @@
+/*
+*
+* Defines the scene graph storage and its world matrix update
+*
+*/
+
+#include <scene_graph.h>
+#include <algorithm>
+
+NodeId SceneGraph::AddNode(const glm::mat4& local, NodeId parent)
+{
+	NodeId node = static_cast<NodeId>(parents.size());
+	locals.push_back(local);
+	worlds.push_back(parent == NoParent ? local : worlds[parent] * local);
+	parents.push_back(parent);
+	dirty.push_back(0);
+	return node;
+}
+
+void SceneGraph::Reserve(size_t nodeCount)
+{
+	locals.reserve(nodeCount);
+	worlds.reserve(nodeCount);
+	parents.reserve(nodeCount);
+	dirty.reserve(nodeCount);
+}
+
+void SceneGraph::Clear()
+{
+	locals.clear();
+	worlds.clear();
+	parents.clear();
+	dirty.clear();
+}
+
+void SceneGraph::SetLocal(NodeId node, const glm::mat4& local)
+{
+	locals[node] = local;
+	dirty[node] = 1;
+}
+
+uint32_t SceneGraph::Update()
+{
+	uint32_t updated = 0;
+	const size_t count = parents.size();
+
+	// a parent is always visited before its children, so its flag already says whether its world matrix changed
+	for (size_t i = 0; i < count; ++i) {
+		NodeId parent = parents[i];
+		if (parent != NoParent && dirty[parent]) {
+			dirty[i] = 1;
+		}
+		if (dirty[i]) {
+			worlds[i] = parent == NoParent ? locals[i] : worlds[parent] * locals[i];
+			++updated;
+		}
+	}
+
+	std::fill(dirty.begin(), dirty.end(), static_cast<uint8_t>(0));
+	return updated;
+}
+
+void SceneGraph::UpdateAll()
+{
+	const size_t count = parents.size();
+	for (size_t i = 0; i < count; ++i) {
+		NodeId parent = parents[i];
+		worlds[i] = parent == NoParent ? locals[i] : worlds[parent] * locals[i];
+	}
+	std::fill(dirty.begin(), dirty.end(), static_cast<uint8_t>(0));
+}
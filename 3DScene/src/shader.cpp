@@ -5,8 +5,13 @@
 */
 
 #include <shader.h> 
+#include <gl_state.h>
+#include <uniform_buffer.h>
+#include <algorithm>
 #include <iostream> 
 #include <fstream> 
+#include <sstream>
+#include <vector>
 #include <glm/gtc/type_ptr.hpp>
 
 // initializes shader w/ vertex and frag shader source code
@@ -44,7 +49,7 @@ Shader::Shader(const Path& vertexPath, const Path& fragmentPath)
 
 }
 // This function is designed to update a vec3 uniform variable in the shader program
-void Shader::SetVec3(const std::string& name, const glm::vec3& value)
+void Shader::SetVec3(std::string_view name, const glm::vec3& value)
 {
 	GLint loc = getUniformLocation(name);
 	if (loc != -1) {
@@ -54,11 +59,19 @@ void Shader::SetVec3(const std::string& name, const glm::vec3& value)
 		std::cerr << "Uniform '" << name << "' not found in shader program." << std::endl;
 	}
 }
+
+// updates a vec3 uniform through a location resolved earlier with UniformLocation
+void Shader::SetVec3(GLint location, const glm::vec3& value)
+{
+	if (location != -1) {
+		glUniform3fv(location, 1, glm::value_ptr(value));
+	}
+}
 // activates the shader program
 void Shader::Bind()
 {
 	// use our triangle shader
-	glUseProgram(shaderProgram);
+	GLState::UseProgram(shaderProgram);
 }
 
 //compiles and links shaders
@@ -104,15 +117,86 @@ void Shader::load(const std::string& vertexSource, const std::string& fragmentSo
 
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
+
+	cacheUniformLocations();
+	bindUniformBlocks();
+}
+
+// hooks the program's uniform blocks up to the shared binding points so per-frame data is bound once for every program
+void Shader::bindUniformBlocks()
+{
+	GLint blockCount = 0;
+	glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+
+	char name[128];
+	for (GLint i = 0; i < blockCount; ++i) {
+		GLsizei nameLength = 0;
+		glGetActiveUniformBlockName(shaderProgram, static_cast<GLuint>(i), sizeof(name), &nameLength, name);
+
+		GLint binding = UniformBlockBinding(std::string_view(name, static_cast<size_t>(nameLength)));
+		if (binding != -1) {
+			glUniformBlockBinding(shaderProgram, static_cast<GLuint>(i), static_cast<GLuint>(binding));
+		}
+		else {
+			std::cerr << "Uniform block '" << name << "' has no binding point." << std::endl;
+		}
+	}
+}
+
+// asks the driver for every active uniform once so drawing never has to call glGetUniformLocation
+void Shader::cacheUniformLocations()
+{
+	uniformLocations.clear();
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> nameBuffer(static_cast<size_t>(std::max(maxNameLength, 1)));
+	for (GLint i = 0; i < uniformCount; ++i) {
+		GLsizei nameLength = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(shaderProgram, static_cast<GLuint>(i), static_cast<GLsizei>(nameBuffer.size()), &nameLength, &size, &type, nameBuffer.data());
+
+		std::string name(nameBuffer.data(), static_cast<size_t>(nameLength));
+		GLint location = glGetUniformLocation(shaderProgram, name.c_str());
+		if (location == -1) {
+			continue; // uniforms inside blocks have no location
+		}
+
+		// arrays are reported as "name[0]", also allow looking them up by their plain name
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+			uniformLocations.emplace(name.substr(0, name.size() - 3), location);
+		}
+		uniformLocations.emplace(std::move(name), location);
+	}
 }
+
 //Gets the location ofa a uniform variable
-GLint Shader::getUniformLocation(const std::string& uniformName)
+GLint Shader::getUniformLocation(std::string_view uniformName) const
+{
+	auto it = uniformLocations.find(uniformName);
+	return it != uniformLocations.end() ? it->second : -1;
+}
+
+GLint Shader::UniformLocation(std::string_view uniformName) const
 {
-	return glGetUniformLocation(shaderProgram, uniformName.c_str());
+	return getUniformLocation(uniformName);
+}
+
+// updates a mat4 uniform through a location resolved earlier with UniformLocation
+void Shader::SetMat4(GLint location, const glm::mat4& mat4)
+{
+	if (location != -1) {
+		Bind();
+		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat4));
+	}
 }
 
 //This function updates a mat4 uniform variable
-void Shader::SetMat4(const std::string& uniformName, const glm::mat4& mat4)
+void Shader::SetMat4(std::string_view uniformName, const glm::mat4& mat4)
 {
 	auto uniformLoc = getUniformLocation(uniformName);
 
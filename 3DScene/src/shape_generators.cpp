@@ -0,0 +1,246 @@
+/*
+*
+* Defines the procedural shape generators
+*
+*/
+
+#include <shape_generators.h>
+#include <objects.h>
+#include <thread_pool.h>
+#include <algorithm>
+#include <cmath>
+#include <compare>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace {
+	constexpr float Pi = 3.1415926f;
+
+	// below this many vertices the handoff to the workers costs more than generating the rows here
+	constexpr size_t ParallelVertexThreshold = 1 << 16;
+
+	// rows per ParallelFor chunk, enough work that threads do not fight over the chunk counter
+	size_t rowChunk(int segments)
+	{
+		return std::max<size_t>(1, 16384 / (static_cast<size_t>(segments) + 1));
+	}
+
+	enum class ShapeKind {
+		Sphere,
+		Cylinder,
+		SphereCylinder
+	};
+
+	struct ShapeKey {
+		ShapeKind kind;
+		float radius;
+		float height;
+		int segments;
+		float secondRadius;
+		int secondSegments;
+
+		auto operator<=>(const ShapeKey&) const = default;
+	};
+
+	// function local so nothing is constructed before main, and only the shapes something asks for are generated
+	const ShapeGenerators::GeneratedMesh& cachedShape(const ShapeKey& key, const std::function<void(ShapeGenerators::GeneratedMesh&)>& generate)
+	{
+		static std::mutex mutex;
+		static std::map<ShapeKey, std::unique_ptr<ShapeGenerators::GeneratedMesh>> shapes;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& shape = shapes[key];
+		if (!shape) {
+			shape = std::make_unique<ShapeGenerators::GeneratedMesh>();
+			generate(*shape);
+		}
+		return *shape;
+	}
+
+	void forRows(ThreadPool* pool, size_t rows, size_t vertices, int segments, const std::function<void(size_t, size_t)>& body)
+	{
+		if (pool && pool->ThreadCount() > 0 && vertices >= ParallelVertexThreshold) {
+			pool->ParallelFor(rows, rowChunk(segments), body);
+		}
+		else {
+			body(0, rows);
+		}
+	}
+}
+
+ShapeGenerators::SinCosTable::SinCosTable(int segments, float step)
+	: sin(segments + 1), cos(segments + 1)
+{
+	for (int i = 0; i <= segments; ++i) {
+		// same expression the per vertex code used, so the generated meshes do not change
+		float angle = static_cast<float>(i) / segments * step;
+		sin[i] = std::sin(angle);
+		cos[i] = std::cos(angle);
+	}
+}
+
+ShapeGenerators::ShapeCounts ShapeGenerators::SphereCounts(int segments)
+{
+	size_t rowVertices = static_cast<size_t>(segments) + 1;
+	return { rowVertices * rowVertices, static_cast<size_t>(segments) * segments * 6 };
+}
+
+ShapeGenerators::ShapeCounts ShapeGenerators::CylinderCounts(int segments)
+{
+	return { (static_cast<size_t>(segments) + 1) * 2, static_cast<size_t>(segments) * 12 };
+}
+
+ShapeGenerators::ShapeCounts ShapeGenerators::SphereCylinderCounts(int cylinderSegments, int sphereSegments)
+{
+	ShapeCounts cylinder = CylinderCounts(cylinderSegments);
+	ShapeCounts sphere = SphereCounts(sphereSegments);
+	return { cylinder.vertices + sphere.vertices, cylinder.indices + sphere.indices };
+}
+
+// Sphere UV Mapping and normal lighting
+void ShapeGenerators::WriteSphereVertices(std::span<Vertex> vertices, float radius, int segments, glm::vec3 offset, ThreadPool* pool)
+{
+	const float vOffset = 0.25f; // silver part is the top 25% of the texture image
+	const size_t rowVertices = static_cast<size_t>(segments) + 1;
+	const SinCosTable around(segments, 2.0f * Pi);
+	const SinCosTable down(segments, Pi);
+
+	forRows(pool, rowVertices, vertices.size(), segments, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; ++y) {
+			float ySection = static_cast<float>(y) / segments;
+			Vertex* row = vertices.data() + y * rowVertices;
+			for (size_t x = 0; x < rowVertices; ++x) {
+				// spherical coordinates
+				glm::vec3 direction(around.cos[x] * down.sin[y], down.cos[y], around.sin[x] * down.sin[y]);
+
+				Vertex& vertex = row[x];
+				vertex.Position = direction * radius + offset;
+				vertex.Color = glm::vec3(0.75f, 0.75f, 0.75f);
+				vertex.Normal = glm::normalize(direction);
+				vertex.Uv = glm::vec2(static_cast<float>(x) / segments, ySection * vOffset);
+			}
+		}
+		});
+}
+
+void ShapeGenerators::WriteSphereIndices(std::span<uint32_t> indices, int segments, uint32_t baseVertex, ThreadPool* pool)
+{
+	const uint32_t rowVertices = static_cast<uint32_t>(segments) + 1;
+
+	forRows(pool, segments, indices.size() / 3, segments, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; ++y) {
+			uint32_t* out = indices.data() + y * segments * 6;
+			for (uint32_t x = 0; x < static_cast<uint32_t>(segments); ++x) {
+				// for the corners of segments
+				uint32_t bottomLeft = baseVertex + static_cast<uint32_t>(y) * rowVertices + x;
+				uint32_t topLeft = bottomLeft + rowVertices;
+				uint32_t topRight = topLeft + 1;
+				uint32_t bottomRight = bottomLeft + 1;
+
+				// two triangles per segment
+				out[0] = topLeft;
+				out[1] = bottomLeft;
+				out[2] = topRight;
+				out[3] = bottomLeft;
+				out[4] = bottomRight;
+				out[5] = topRight;
+				out += 6;
+			}
+		}
+		});
+}
+
+// Cylinder UV Mapping and normal calculations
+void ShapeGenerators::WriteCylinderVertices(std::span<Vertex> vertices, float radius, float height, int segments)
+{
+	const float vTop = 0.25f; // Top edge uses the silver part of the photo
+	const float vBottom = 1.0f; // Bottom edge uses the pink/ glass part of the photo
+	const glm::vec3 color(0.9f, 0.5f, 0.55f);
+	const SinCosTable around(segments, 2.0f * Pi);
+
+	for (int i = 0; i <= segments; ++i) {
+		float u = static_cast<float>(i) / segments;
+		glm::vec3 normal = glm::normalize(glm::vec3(around.cos[i], 0.0f, around.sin[i]));
+
+		// the top and bottom edge share the normal so lighting is consistent across the side
+		vertices[i * 2] = { glm::vec3(radius * around.cos[i], height / 2, radius * around.sin[i]), color, normal, glm::vec2(u, vTop) };
+		vertices[i * 2 + 1] = { glm::vec3(radius * around.cos[i], -height / 2, radius * around.sin[i]), color, normal, glm::vec2(u, vBottom) };
+	}
+}
+
+void ShapeGenerators::WriteCylinderIndices(std::span<uint32_t> indices, int segments, uint32_t baseVertex)
+{
+	uint32_t* out = indices.data();
+	for (int i = 0; i < segments; ++i) {
+		uint32_t current = baseVertex + i;
+		uint32_t next = baseVertex + (i + 1) % (segments + 1);
+		uint32_t bottom = static_cast<uint32_t>(segments) + 1;
+
+		// top of the circle
+		out[0] = current;
+		out[1] = next;
+		out[2] = baseVertex + segments;
+
+		// bottom of the circle
+		out[3] = current + bottom;
+		out[4] = next + bottom;
+		out[5] = baseVertex + 2 * segments + 1;
+
+		// sides of the cylinder
+		out[6] = current;
+		out[7] = next;
+		out[8] = next + bottom;
+		out[9] = current;
+		out[10] = next + bottom;
+		out[11] = current + bottom;
+		out += 12;
+	}
+}
+
+void ShapeGenerators::WriteSphereCylinder(std::span<Vertex> vertices, std::span<uint32_t> indices, float cylinderRadius, float cylinderHeight, int cylinderSegments,
+	float sphereRadius, int sphereSegments, ThreadPool* pool)
+{
+	ShapeCounts cylinder = CylinderCounts(cylinderSegments);
+
+	WriteCylinderVertices(vertices.first(cylinder.vertices), cylinderRadius, cylinderHeight, cylinderSegments);
+	WriteCylinderIndices(indices.first(cylinder.indices), cylinderSegments);
+
+	// the sphere sits on top of the cylinder
+	glm::vec3 translation(0.0f, cylinderHeight / 2.0f + sphereRadius * 0.5f, 0.0f);
+	WriteSphereVertices(vertices.subspan(cylinder.vertices), sphereRadius, sphereSegments, translation, pool);
+	WriteSphereIndices(indices.subspan(cylinder.indices), sphereSegments, static_cast<uint32_t>(cylinder.vertices), pool);
+}
+
+const ShapeGenerators::GeneratedMesh& ShapeGenerators::Sphere(float radius, int segments)
+{
+	return cachedShape({ ShapeKind::Sphere, radius, 0.0f, segments, 0.0f, 0 }, [&](GeneratedMesh& mesh) {
+		ShapeCounts counts = SphereCounts(segments);
+		mesh.vertices.resize(counts.vertices);
+		mesh.indices.resize(counts.indices);
+		WriteSphereVertices(mesh.vertices, radius, segments);
+		WriteSphereIndices(mesh.indices, segments);
+		});
+}
+
+const ShapeGenerators::GeneratedMesh& ShapeGenerators::Cylinder(float radius, float height, int segments)
+{
+	return cachedShape({ ShapeKind::Cylinder, radius, height, segments, 0.0f, 0 }, [&](GeneratedMesh& mesh) {
+		ShapeCounts counts = CylinderCounts(segments);
+		mesh.vertices.resize(counts.vertices);
+		mesh.indices.resize(counts.indices);
+		WriteCylinderVertices(mesh.vertices, radius, height, segments);
+		WriteCylinderIndices(mesh.indices, segments);
+		});
+}
+
+const ShapeGenerators::GeneratedMesh& ShapeGenerators::SphereCylinder(float cylinderRadius, float cylinderHeight, int cylinderSegments, float sphereRadius, int sphereSegments)
+{
+	return cachedShape({ ShapeKind::SphereCylinder, cylinderRadius, cylinderHeight, cylinderSegments, sphereRadius, sphereSegments }, [&](GeneratedMesh& mesh) {
+		ShapeCounts counts = SphereCylinderCounts(cylinderSegments, sphereSegments);
+		mesh.vertices.resize(counts.vertices);
+		mesh.indices.resize(counts.indices);
+		WriteSphereCylinder(mesh.vertices, mesh.indices, cylinderRadius, cylinderHeight, cylinderSegments, sphereRadius, sphereSegments);
+		});
+}
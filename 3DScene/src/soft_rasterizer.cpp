@@ -0,0 +1,381 @@
+/*
+*
+* Defines the CPU rasterizer: vertex stage, near plane clipping, tile binning, and the tile loop
+*
+*/
+
+#include <soft_rasterizer.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX__)
+#define RASTER_AVX 1
+#include <immintrin.h>
+#endif
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double elapsedMs(Clock::time_point start, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	constexpr uint32_t BlocksPerTile = SoftRasterizer::TileSize / SoftRasterizer::BlockSize;
+}
+
+uint32_t SoftRasterizer::AddMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+	meshes.push_back({ vertices, indices });
+	return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+uint32_t SoftRasterizer::AddTexture(const Image& image)
+{
+	textures.push_back(Texture::BuildMipChain(image));
+	return static_cast<uint32_t>(textures.size() - 1);
+}
+
+uint32_t SoftRasterizer::AddObject(uint32_t mesh, const glm::mat4& world, uint32_t texture)
+{
+	objects.push_back({ mesh, texture, world });
+	return static_cast<uint32_t>(objects.size() - 1);
+}
+
+void SoftRasterizer::SetTransform(uint32_t object, const glm::mat4& world)
+{
+	objects[object].world = world;
+}
+
+const char* SoftRasterizer::SimdName()
+{
+#if defined(RASTER_AVX)
+	return "AVX";
+#else
+	return "scalar";
+#endif
+}
+
+void SoftRasterizer::setupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, uint32_t texture, uint32_t width, uint32_t height)
+{
+	const ClipVertex* vertices[3] = { &a, &b, &c };
+	Triangle triangle;
+	glm::vec2 minScreen(std::numeric_limits<float>::max()), maxScreen(std::numeric_limits<float>::lowest());
+	triangle.minDepth = 1.0f;
+	for (int i = 0; i < 3; ++i) {
+		const ClipVertex& vertex = *vertices[i];
+		float inverseW = 1.0f / vertex.clip.w;
+		glm::vec3 ndc = glm::vec3(vertex.clip) * inverseW;
+
+		// pixel centers sit at half coordinates and row 0 is the top of the image
+		triangle.screen[i] = glm::vec2((ndc.x * 0.5f + 0.5f) * width, (0.5f - ndc.y * 0.5f) * height);
+		triangle.depth[i] = ndc.z * 0.5f + 0.5f;
+		triangle.inverseW[i] = inverseW;
+		triangle.worldOverW[i] = vertex.world * inverseW;
+		triangle.normalOverW[i] = vertex.normal * inverseW;
+		triangle.uvOverW[i] = vertex.uv * inverseW;
+		minScreen = glm::min(minScreen, triangle.screen[i]);
+		maxScreen = glm::max(maxScreen, triangle.screen[i]);
+		triangle.minDepth = std::min(triangle.minDepth, triangle.depth[i]);
+	}
+
+	const glm::vec2* s = triangle.screen;
+	triangle.area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[1].y - s[0].y) * (s[2].x - s[0].x);
+	if (std::abs(triangle.area) < 1.0e-8f) {
+		return;
+	}
+
+	triangle.minX = std::max(0, static_cast<int>(std::floor(minScreen.x - 0.5f)));
+	triangle.minY = std::max(0, static_cast<int>(std::floor(minScreen.y - 0.5f)));
+	triangle.maxX = std::min(static_cast<int>(width) - 1, static_cast<int>(std::ceil(maxScreen.x - 0.5f)));
+	triangle.maxY = std::min(static_cast<int>(height) - 1, static_cast<int>(std::ceil(maxScreen.y - 0.5f)));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+		return;
+	}
+
+	triangle.texture = texture;
+	triangles.push_back(triangle);
+}
+
+RasterStats SoftRasterizer::Render(ThreadPool& pool, const RasterFrame& frame, uint32_t width, uint32_t height, Image& output)
+{
+	RasterStats stats;
+	auto start = Clock::now();
+	glm::mat4 projectionView = frame.projection * frame.view;
+
+	// vertex stage and clipping, the same transform as shader.vert
+	triangles.clear();
+	double vertexMs = 0.0;
+	for (const auto& object : objects) {
+		const MeshData& mesh = meshes[object.mesh];
+		glm::mat4 clipFromModel = projectionView * object.world;
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(object.world)));
+
+		auto vertexStart = Clock::now();
+		clipVertices.resize(mesh.vertices.size());
+		pool.ParallelFor(mesh.vertices.size(), 4096, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				const Vertex& vertex = mesh.vertices[i];
+				clipVertices[i] = { clipFromModel * glm::vec4(vertex.Position, 1.0f), glm::vec3(object.world * glm::vec4(vertex.Position, 1.0f)),
+					normalMatrix * vertex.Normal, vertex.Uv };
+			}
+		});
+		vertexMs += elapsedMs(vertexStart, Clock::now());
+
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			const ClipVertex* corners[3] = { &clipVertices[mesh.indices[i]], &clipVertices[mesh.indices[i + 1]], &clipVertices[mesh.indices[i + 2]] };
+
+			// all three corners outside the same side plane, nothing to draw
+			bool outside = false;
+			for (int axis = 0; axis < 3 && !outside; ++axis) {
+				outside = (corners[0]->clip[axis] > corners[0]->clip.w && corners[1]->clip[axis] > corners[1]->clip.w && corners[2]->clip[axis] > corners[2]->clip.w)
+					|| (corners[0]->clip[axis] < -corners[0]->clip.w && corners[1]->clip[axis] < -corners[1]->clip.w && corners[2]->clip[axis] < -corners[2]->clip.w);
+			}
+			if (outside) {
+				continue;
+			}
+
+			// clip against the near plane z = -w, anything else is handled by the screen bounds and the depth test
+			ClipVertex polygon[4];
+			int count = 0;
+			for (int corner = 0; corner < 3; ++corner) {
+				const ClipVertex& current = *corners[corner];
+				const ClipVertex& next = *corners[(corner + 1) % 3];
+				float currentDistance = current.clip.z + current.clip.w;
+				float nextDistance = next.clip.z + next.clip.w;
+				if (currentDistance >= 0.0f) {
+					polygon[count++] = current;
+				}
+				if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+					float t = currentDistance / (currentDistance - nextDistance);
+					polygon[count++] = { glm::mix(current.clip, next.clip, t), glm::mix(current.world, next.world, t),
+						glm::mix(current.normal, next.normal, t), glm::mix(current.uv, next.uv, t) };
+				}
+			}
+			for (int corner = 1; corner + 1 < count; ++corner) {
+				setupTriangle(polygon[0], polygon[corner], polygon[corner + 1], object.texture, width, height);
+			}
+		}
+	}
+	stats.vertexMs = vertexMs;
+	stats.triangles = static_cast<uint32_t>(triangles.size());
+
+	// bin every triangle into the tiles its bounds touch, in submission order
+	auto binStart = Clock::now();
+	tilesX = (width + TileSize - 1) / TileSize;
+	tilesY = (height + TileSize - 1) / TileSize;
+	bins.resize(static_cast<size_t>(tilesX) * tilesY);
+	for (auto& bin : bins) {
+		bin.clear();
+	}
+	for (uint32_t index = 0; index < triangles.size(); ++index) {
+		const Triangle& triangle = triangles[index];
+		for (int ty = triangle.minY / static_cast<int>(TileSize); ty <= triangle.maxY / static_cast<int>(TileSize); ++ty) {
+			for (int tx = triangle.minX / static_cast<int>(TileSize); tx <= triangle.maxX / static_cast<int>(TileSize); ++tx) {
+				bins[static_cast<size_t>(ty) * tilesX + tx].push_back(index);
+				++stats.binEntries;
+			}
+		}
+	}
+	stats.binMs = elapsedMs(binStart, Clock::now());
+
+	output.width = static_cast<int>(width);
+	output.height = static_cast<int>(height);
+	output.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+	// one tile per chunk, tiles own disjoint pixels so no locking is needed
+	auto rasterStart = Clock::now();
+	std::atomic<uint64_t> blocksTested{ 0 }, blocksSkipped{ 0 };
+	pool.ParallelFor(bins.size(), 1, [&](size_t begin, size_t end) {
+		uint64_t tested = 0, skipped = 0;
+		for (size_t tile = begin; tile < end; ++tile) {
+			rasterizeTile(static_cast<uint32_t>(tile % tilesX), static_cast<uint32_t>(tile / tilesX), frame, width, height, output, tested, skipped);
+		}
+		blocksTested += tested;
+		blocksSkipped += skipped;
+	});
+	stats.rasterMs = elapsedMs(rasterStart, Clock::now());
+	stats.blocksTested = blocksTested;
+	stats.blocksSkipped = blocksSkipped;
+	stats.totalMs = elapsedMs(start, Clock::now());
+	return stats;
+}
+
+void SoftRasterizer::rasterizeTile(uint32_t tileX, uint32_t tileY, const RasterFrame& frame, uint32_t width, uint32_t height, Image& output,
+	uint64_t& blocksTested, uint64_t& blocksSkipped)
+{
+	int tileMinX = static_cast<int>(tileX * TileSize), tileMinY = static_cast<int>(tileY * TileSize);
+	int tileMaxX = std::min(tileMinX + static_cast<int>(TileSize), static_cast<int>(width)) - 1;
+	int tileMaxY = std::min(tileMinY + static_cast<int>(TileSize), static_cast<int>(height)) - 1;
+
+	// the tile's depth and the farthest depth in each of its blocks, both start at the far plane
+	alignas(32) float tileDepth[TileSize * TileSize];
+	float blockMax[BlocksPerTile * BlocksPerTile];
+	std::fill(std::begin(tileDepth), std::end(tileDepth), 1.0f);
+	std::fill(std::begin(blockMax), std::end(blockMax), 1.0f);
+
+	uint8_t clear[4] = { static_cast<uint8_t>(frame.clearColor.r * 255.0f + 0.5f), static_cast<uint8_t>(frame.clearColor.g * 255.0f + 0.5f),
+		static_cast<uint8_t>(frame.clearColor.b * 255.0f + 0.5f), 255 };
+	for (int y = tileMinY; y <= tileMaxY; ++y) {
+		uint8_t* row = &output.pixels[(static_cast<size_t>(y) * width + tileMinX) * 4];
+		for (int x = tileMinX; x <= tileMaxX; ++x, row += 4) {
+			std::copy(clear, clear + 4, row);
+		}
+	}
+
+	for (uint32_t index : bins[static_cast<size_t>(tileY) * tilesX + tileX]) {
+		const Triangle& triangle = triangles[index];
+
+		// edge functions E(x, y) = a x + b y + c, each one weights the corner opposite its edge. Flipping the
+		// sign for back facing triangles makes the inside positive for both, both faces are drawn like in GL
+		const glm::vec2* s = triangle.screen;
+		float sign = triangle.area > 0.0f ? 1.0f : -1.0f;
+		float inverseArea = 1.0f / std::abs(triangle.area);
+		float a[3], b[3], c[3];
+		for (int edge = 0; edge < 3; ++edge) {
+			const glm::vec2& from = s[(edge + 1) % 3];
+			const glm::vec2& to = s[(edge + 2) % 3];
+			a[edge] = -(to.y - from.y) * sign * inverseArea;
+			b[edge] = (to.x - from.x) * sign * inverseArea;
+			c[edge] = ((to.y - from.y) * from.x - (to.x - from.x) * from.y) * sign * inverseArea;
+		}
+
+		int minX = std::max(triangle.minX, tileMinX), maxX = std::min(triangle.maxX, tileMaxX);
+		int minY = std::max(triangle.minY, tileMinY), maxY = std::min(triangle.maxY, tileMaxY);
+		if (minX > maxX || minY > maxY) {
+			continue;
+		}
+
+		int firstBlockX = (minX - tileMinX) / BlockSize, lastBlockX = (maxX - tileMinX) / BlockSize;
+		int firstBlockY = (minY - tileMinY) / BlockSize, lastBlockY = (maxY - tileMinY) / BlockSize;
+		for (int blockY = firstBlockY; blockY <= lastBlockY; ++blockY) {
+			for (int blockX = firstBlockX; blockX <= lastBlockX; ++blockX) {
+				// the whole triangle is behind everything already drawn in this block
+				float& farthest = blockMax[blockY * BlocksPerTile + blockX];
+				++blocksTested;
+				if (triangle.minDepth >= farthest) {
+					++blocksSkipped;
+					continue;
+				}
+
+				int x0 = tileMinX + blockX * static_cast<int>(BlockSize);
+				bool written = false;
+				for (int row = 0; row < static_cast<int>(BlockSize); ++row) {
+					int y = tileMinY + blockY * static_cast<int>(BlockSize) + row;
+					if (y < minY || y > maxY) {
+						continue;
+					}
+					float* depthRow = &tileDepth[(y - tileMinY) * TileSize + (x0 - tileMinX)];
+					float py = y + 0.5f;
+
+					float w0[BlockSize], w1[BlockSize], w2[BlockSize];
+					int mask = 0;
+#if defined(RASTER_AVX)
+					__m256 px = _mm256_add_ps(_mm256_set1_ps(x0 + 0.5f), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+					__m256 e0 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a[0]), px), _mm256_set1_ps(b[0] * py + c[0]));
+					__m256 e1 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a[1]), px), _mm256_set1_ps(b[1] * py + c[1]));
+					__m256 e2 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a[2]), px), _mm256_set1_ps(b[2] * py + c[2]));
+					__m256 zero = _mm256_setzero_ps();
+					__m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(px, _mm256_set1_ps(minX + 0.0f), _CMP_GE_OQ));
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(px, _mm256_set1_ps(maxX + 1.0f), _CMP_LT_OQ));
+					if (_mm256_movemask_ps(inside) == 0) {
+						continue;
+					}
+
+					// depth is affine in screen space, test it against the row of the tile's depth
+					__m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e0, _mm256_set1_ps(triangle.depth[0])), _mm256_mul_ps(e1, _mm256_set1_ps(triangle.depth[1]))),
+						_mm256_mul_ps(e2, _mm256_set1_ps(triangle.depth[2])));
+					__m256 stored = _mm256_loadu_ps(depthRow);
+					__m256 pass = _mm256_and_ps(inside, _mm256_cmp_ps(z, stored, _CMP_LT_OQ));
+					mask = _mm256_movemask_ps(pass);
+					if (mask == 0) {
+						continue;
+					}
+					_mm256_storeu_ps(depthRow, _mm256_blendv_ps(stored, z, pass));
+					_mm256_storeu_ps(w0, e0);
+					_mm256_storeu_ps(w1, e1);
+					_mm256_storeu_ps(w2, e2);
+#else
+					for (int lane = 0; lane < static_cast<int>(BlockSize); ++lane) {
+						int x = x0 + lane;
+						float px = x + 0.5f;
+						w0[lane] = a[0] * px + b[0] * py + c[0];
+						w1[lane] = a[1] * px + b[1] * py + c[1];
+						w2[lane] = a[2] * px + b[2] * py + c[2];
+						if (x < minX || x > maxX || w0[lane] < 0.0f || w1[lane] < 0.0f || w2[lane] < 0.0f) {
+							continue;
+						}
+						float z = w0[lane] * triangle.depth[0] + w1[lane] * triangle.depth[1] + w2[lane] * triangle.depth[2];
+						if (z < depthRow[lane]) {
+							depthRow[lane] = z;
+							mask |= 1 << lane;
+						}
+					}
+					if (mask == 0) {
+						continue;
+					}
+#endif
+					written = true;
+					uint8_t* pixels = &output.pixels[(static_cast<size_t>(y) * width + x0) * 4];
+					for (int lane = 0; lane < static_cast<int>(BlockSize); ++lane) {
+						if (mask & (1 << lane)) {
+							shade(triangle, glm::vec3(w0[lane], w1[lane], w2[lane]), glm::vec3(a[0], a[1], a[2]), glm::vec3(b[0], b[1], b[2]), frame, pixels + lane * 4);
+						}
+					}
+				}
+
+				// the block can only have come closer, refresh its farthest depth
+				if (written) {
+					float blockFarthest = 0.0f;
+					for (int row = 0; row < static_cast<int>(BlockSize); ++row) {
+						const float* depthRow = &tileDepth[(blockY * BlockSize + row) * TileSize + blockX * BlockSize];
+						for (int lane = 0; lane < static_cast<int>(BlockSize); ++lane) {
+							blockFarthest = std::max(blockFarthest, depthRow[lane]);
+						}
+					}
+					farthest = blockFarthest;
+				}
+			}
+		}
+	}
+}
+
+// shader.frag: Phong ambient, diffuse, and specular from the key light times the bilinear texture color
+void SoftRasterizer::shade(const Triangle& triangle, const glm::vec3& w, const glm::vec3& dx, const glm::vec3& dy, const RasterFrame& frame, uint8_t* pixel) const
+{
+	// perspective correct attributes
+	glm::vec3 inverseW(triangle.inverseW[0], triangle.inverseW[1], triangle.inverseW[2]);
+	float correction = 1.0f / glm::dot(w, inverseW);
+	glm::vec3 fragPos = (triangle.worldOverW[0] * w.x + triangle.worldOverW[1] * w.y + triangle.worldOverW[2] * w.z) * correction;
+	glm::vec3 normal = glm::normalize((triangle.normalOverW[0] * w.x + triangle.normalOverW[1] * w.y + triangle.normalOverW[2] * w.z) * correction);
+	auto uvAt = [&](const glm::vec3& weights) {
+		return (triangle.uvOverW[0] * weights.x + triangle.uvOverW[1] * weights.y + triangle.uvOverW[2] * weights.z) / glm::dot(weights, inverseW);
+	};
+	glm::vec2 uv = uvAt(w);
+
+	// level of detail from the texel footprint of one pixel step, the same estimate GL makes from derivatives
+	const MipChain& texture = textures[triangle.texture];
+	glm::vec2 size(static_cast<float>(texture.levels[0].width), static_cast<float>(texture.levels[0].height));
+	glm::vec2 uvDx = (uvAt(w + dx) - uv) * size;
+	glm::vec2 uvDy = (uvAt(w + dy) - uv) * size;
+	float footprint = std::max(glm::dot(uvDx, uvDx), glm::dot(uvDy, uvDy));
+	float lod = 0.5f * std::log2(std::max(footprint, 1.0e-8f));
+
+	glm::vec3 ambient = 0.4f * frame.keyLightColor;
+	glm::vec3 diffuse = std::max(glm::dot(normal, frame.keyLightDir), 0.0f) * frame.keyLightColor;
+	glm::vec3 viewDir = glm::normalize(frame.viewPos - fragPos);
+	glm::vec3 reflectDir = glm::reflect(-frame.keyLightDir, normal);
+	float spec = std::max(glm::dot(viewDir, reflectDir), 0.0f);
+	spec *= spec; spec *= spec; spec *= spec; spec *= spec; spec *= spec; // to the 32nd power
+	glm::vec3 specular = 0.5f * spec * frame.keyLightColor;
+
+	glm::vec3 color = glm::clamp((ambient + diffuse + specular) * Texture::SampleTrilinear(texture, uv, lod), 0.0f, 1.0f);
+	pixel[0] = static_cast<uint8_t>(color.r * 255.0f + 0.5f);
+	pixel[1] = static_cast<uint8_t>(color.g * 255.0f + 0.5f);
+	pixel[2] = static_cast<uint8_t>(color.b * 255.0f + 0.5f);
+	pixel[3] = 255;
+}
@@ -0,0 +1,191 @@
+/*
+*
+* Defines the texture helpers for loading images, building mip chains, and creating textures and samplers
+*
+*/
+
+#include <texture.h>
+#include <gl_state.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stb_image.h>
+#include <stb_image_resize2.h>
+#include <stb_image_write.h>
+
+// anisotropic filtering is core in GL 4.6 and an extension before that, both use the same values
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+int Texture::MipLevelCount(int width, int height)
+{
+	int levels = 1;
+	int size = std::max(width, height);
+	while (size > 1) {
+		size /= 2;
+		++levels;
+	}
+	return levels;
+}
+
+bool Texture::LoadImage(const std::filesystem::path& path, Image& image)
+{
+	auto pathString = path.string();
+	int channels = 0;
+	unsigned char* data = stbi_load(pathString.c_str(), &image.width, &image.height, &channels, STBI_rgb_alpha);
+	if (!data) {
+		return false;
+	}
+
+	image.pixels.assign(data, data + static_cast<size_t>(image.width) * image.height * 4);
+	stbi_image_free(data);
+	return true;
+}
+
+bool Texture::SaveImage(const std::filesystem::path& path, const Image& image)
+{
+	auto pathString = path.string();
+	if (!stbi_write_png(pathString.c_str(), image.width, image.height, 4, image.pixels.data(), image.width * 4)) {
+		std::cerr << "Failed to write image: " << pathString << std::endl;
+		return false;
+	}
+	return true;
+}
+
+Image Texture::PlaceholderImage()
+{
+	Image checker;
+	checker.width = 2;
+	checker.height = 2;
+	checker.pixels = {
+		255, 0, 255, 255,   0, 0, 0, 255,
+		0, 0, 0, 255,       255, 0, 255, 255
+	};
+	return checker;
+}
+
+glm::vec3 Texture::SampleBilinear(const Image& image, glm::vec2 uv)
+{
+	float x = (uv.x - std::floor(uv.x)) * image.width - 0.5f;
+	float y = (uv.y - std::floor(uv.y)) * image.height - 0.5f;
+	int x0 = static_cast<int>(std::floor(x)), y0 = static_cast<int>(std::floor(y));
+	float fx = x - x0, fy = y - y0;
+
+	// x and y are within half a texel of the image, so each neighbor wraps at most once
+	int x1 = x0 + 1, y1 = y0 + 1;
+	x0 = x0 < 0 ? x0 + image.width : x0;
+	y0 = y0 < 0 ? y0 + image.height : y0;
+	x1 = x1 >= image.width ? x1 - image.width : x1;
+	y1 = y1 >= image.height ? y1 - image.height : y1;
+
+	auto texel = [&](int tx, int ty) {
+		const uint8_t* pixel = &image.pixels[(static_cast<size_t>(ty) * image.width + tx) * 4];
+		return glm::vec3(pixel[0], pixel[1], pixel[2]);
+	};
+	glm::vec3 top = glm::mix(texel(x0, y0), texel(x1, y0), fx);
+	glm::vec3 bottom = glm::mix(texel(x0, y1), texel(x1, y1), fx);
+	return glm::mix(top, bottom, fy) * (1.0f / 255.0f);
+}
+
+glm::vec3 Texture::SampleTrilinear(const MipChain& chain, glm::vec2 uv, float lod)
+{
+	float maxLevel = static_cast<float>(chain.levels.size() - 1);
+	lod = std::clamp(lod, 0.0f, maxLevel);
+	int level = static_cast<int>(lod);
+	float blend = lod - level;
+	glm::vec3 color = SampleBilinear(chain.levels[level], uv);
+	if (blend > 0.0f) {
+		color = glm::mix(color, SampleBilinear(chain.levels[level + 1], uv), blend);
+	}
+	return color;
+}
+
+MipChain Texture::BuildMipChain(const Image& base)
+{
+	MipChain chain;
+	int levelCount = MipLevelCount(base.width, base.height);
+	chain.levels.reserve(static_cast<size_t>(levelCount));
+	chain.levels.push_back(base);
+
+	for (int level = 1; level < levelCount; ++level) {
+		const Image& previous = chain.levels.back();
+
+		Image next;
+		next.width = std::max(previous.width / 2, 1);
+		next.height = std::max(previous.height / 2, 1);
+		next.pixels.resize(static_cast<size_t>(next.width) * next.height * 4);
+
+		stbir_resize_uint8_srgb(previous.pixels.data(), previous.width, previous.height, 0,
+			next.pixels.data(), next.width, next.height, 0, STBIR_RGBA);
+
+		chain.levels.push_back(std::move(next));
+	}
+	return chain;
+}
+
+GLuint Texture::Create(const Image& image)
+{
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+
+	glTexStorage2D(GL_TEXTURE_2D, MipLevelCount(image.width, image.height), GL_RGBA8, image.width, image.height);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+	glGenerateMipmap(GL_TEXTURE_2D);
+	return texture;
+}
+
+GLuint Texture::Create(const MipChain& chain)
+{
+	if (chain.levels.empty()) {
+		return 0;
+	}
+
+	const Image& base = chain.levels[0];
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+
+	glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(chain.levels.size()), GL_RGBA8, base.width, base.height);
+	for (size_t level = 0; level < chain.levels.size(); ++level) {
+		const Image& image = chain.levels[level];
+		glTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(chain.levels.size()) - 1);
+	return texture;
+}
+
+GLuint Texture::CreateSampler(float maxAnisotropy)
+{
+	GLuint sampler = 0;
+	glGenSamplers(1, &sampler);
+	glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	if (GLAD_GL_VERSION_4_6 || HasExtension("GL_ARB_texture_filter_anisotropic") || HasExtension("GL_EXT_texture_filter_anisotropic")) {
+		float driverMax = 1.0f;
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &driverMax);
+		glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, std::min(maxAnisotropy, driverMax));
+	}
+	return sampler;
+}
+
+bool Texture::HasExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		auto extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+		if (extension && std::strcmp(extension, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,389 @@
+/*
+*
+* Defines the BC1/BC3 block compression helpers and the compressed texture disk cache
+*
+*/
+
+#include <texture_compression.h>
+#include <gl_state.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <stb_dxt.h>
+
+namespace {
+	constexpr uint32_t CacheMagic = 0x31435442; // "BTC1"
+	constexpr uint32_t CacheVersion = 1;
+
+	struct CacheHeader {
+		uint32_t magic{ CacheMagic };
+		uint32_t version{ CacheVersion };
+		uint32_t format{ 0 };
+		uint32_t levelCount{ 0 };
+		uint64_t sourceStamp{ 0 };
+		float psnr{ 0.0f };
+		uint32_t reserved{ 0 };
+	};
+
+	// larger than any GL implementation allows, bounds what a cache entry can make the loader allocate
+	constexpr int MaxCachedSize = 32768;
+
+	struct CacheLevelHeader {
+		int32_t width{ 0 };
+		int32_t height{ 0 };
+		uint64_t byteCount{ 0 };
+	};
+
+	int blocksAcross(int pixels)
+	{
+		return (pixels + 3) / 4;
+	}
+
+	// copies a 4x4 block out of the image, repeating the edge pixels of levels that are not a multiple of 4
+	void gatherBlock(const Image& image, int blockX, int blockY, uint8_t block[64])
+	{
+		for (int y = 0; y < 4; ++y) {
+			int sourceY = std::min(blockY * 4 + y, image.height - 1);
+			for (int x = 0; x < 4; ++x) {
+				int sourceX = std::min(blockX * 4 + x, image.width - 1);
+				const uint8_t* pixel = &image.pixels[(static_cast<size_t>(sourceY) * image.width + sourceX) * 4];
+				std::copy(pixel, pixel + 4, block + (y * 4 + x) * 4);
+			}
+		}
+	}
+
+	void expand565(uint16_t color, int rgb[3])
+	{
+		rgb[0] = ((color >> 11) & 31) * 255 / 31;
+		rgb[1] = ((color >> 5) & 63) * 255 / 63;
+		rgb[2] = (color & 31) * 255 / 31;
+	}
+
+	// decodes the color half of a block into 16 RGBA pixels
+	void decodeColorBlock(const uint8_t* block, bool forceFourColors, uint8_t pixels[64])
+	{
+		uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+		uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+
+		int palette[4][4];
+		expand565(c0, palette[0]);
+		expand565(c1, palette[1]);
+		palette[0][3] = palette[1][3] = 255;
+
+		if (c0 > c1 || forceFourColors) {
+			for (int c = 0; c < 3; ++c) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			palette[2][3] = palette[3][3] = 255;
+		}
+		else {
+			for (int c = 0; c < 3; ++c) {
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+			palette[2][3] = 255;
+			palette[3][3] = 0;
+		}
+
+		uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+		for (int i = 0; i < 16; ++i) {
+			const int* color = palette[(indices >> (2 * i)) & 3];
+			for (int c = 0; c < 4; ++c) {
+				pixels[i * 4 + c] = static_cast<uint8_t>(color[c]);
+			}
+		}
+	}
+
+	// decodes the alpha half of a BC3 block into the alpha channel of 16 pixels
+	void decodeAlphaBlock(const uint8_t* block, uint8_t pixels[64])
+	{
+		int a0 = block[0];
+		int a1 = block[1];
+		int palette[8] = { a0, a1 };
+		if (a0 > a1) {
+			for (int i = 1; i < 7; ++i) {
+				palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+			}
+		}
+		else {
+			for (int i = 1; i < 5; ++i) {
+				palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; ++i) {
+			indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+		}
+		for (int i = 0; i < 16; ++i) {
+			pixels[i * 4 + 3] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+		}
+	}
+
+	double psnr(const Image& reference, const Image& decoded)
+	{
+		double squaredError = 0.0;
+		size_t samples = 0;
+		for (size_t i = 0; i < reference.pixels.size(); ++i) {
+			double difference = static_cast<double>(reference.pixels[i]) - decoded.pixels[i];
+			squaredError += difference * difference;
+			++samples;
+		}
+		double mse = squaredError / std::max<size_t>(samples, 1);
+		return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+	}
+}
+
+bool TextureCompression::IsSupported()
+{
+	return Texture::HasExtension("GL_EXT_texture_compression_s3tc");
+}
+
+size_t TextureCompression::BlockBytes(BlockFormat format)
+{
+	return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+GLenum TextureCompression::GLFormat(BlockFormat format)
+{
+	return format == BlockFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+bool TextureCompression::HasAlpha(const Image& image)
+{
+	for (size_t i = 3; i < image.pixels.size(); i += 4) {
+		if (image.pixels[i] != 255) {
+			return true;
+		}
+	}
+	return false;
+}
+
+CompressedTexture TextureCompression::Compress(const MipChain& chain, ThreadPool& pool)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	CompressedTexture texture;
+	if (chain.levels.empty()) {
+		return texture;
+	}
+
+	texture.format = HasAlpha(chain.levels[0]) ? BlockFormat::BC3 : BlockFormat::BC1;
+	int alpha = texture.format == BlockFormat::BC3 ? 1 : 0;
+	size_t blockBytes = BlockBytes(texture.format);
+
+	for (const Image& image : chain.levels) {
+		CompressedLevel level;
+		level.width = image.width;
+		level.height = image.height;
+
+		int blocksX = blocksAcross(image.width);
+		int blocksY = blocksAcross(image.height);
+		level.blocks.resize(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+
+		// every block is independent, so rows of blocks are spread over the workers
+		pool.ParallelFor(static_cast<size_t>(blocksY), 8, [&](size_t rowBegin, size_t rowEnd) {
+			uint8_t block[64];
+			for (size_t blockY = rowBegin; blockY < rowEnd; ++blockY) {
+				for (int blockX = 0; blockX < blocksX; ++blockX) {
+					gatherBlock(image, blockX, static_cast<int>(blockY), block);
+					uint8_t* destination = &level.blocks[(blockY * blocksX + blockX) * blockBytes];
+					stb_compress_dxt_block(destination, block, alpha, STB_DXT_NORMAL);
+				}
+			}
+		});
+
+		texture.levels.push_back(std::move(level));
+	}
+
+	texture.encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	texture.psnr = static_cast<float>(psnr(chain.levels[0], Decompress(texture.levels[0], texture.format)));
+	return texture;
+}
+
+Image TextureCompression::Decompress(const CompressedLevel& level, BlockFormat format)
+{
+	Image image;
+	image.width = level.width;
+	image.height = level.height;
+	image.pixels.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+	int blocksX = blocksAcross(level.width);
+	int blocksY = blocksAcross(level.height);
+	size_t blockBytes = BlockBytes(format);
+
+	uint8_t pixels[64];
+	for (int blockY = 0; blockY < blocksY; ++blockY) {
+		for (int blockX = 0; blockX < blocksX; ++blockX) {
+			const uint8_t* block = &level.blocks[(static_cast<size_t>(blockY) * blocksX + blockX) * blockBytes];
+			if (format == BlockFormat::BC3) {
+				decodeColorBlock(block + 8, true, pixels);
+				decodeAlphaBlock(block, pixels);
+			}
+			else {
+				decodeColorBlock(block, false, pixels);
+			}
+
+			for (int y = 0; y < 4 && blockY * 4 + y < level.height; ++y) {
+				for (int x = 0; x < 4 && blockX * 4 + x < level.width; ++x) {
+					uint8_t* destination = &image.pixels[(static_cast<size_t>(blockY * 4 + y) * level.width + blockX * 4 + x) * 4];
+					std::copy(pixels + (y * 4 + x) * 4, pixels + (y * 4 + x) * 4 + 4, destination);
+				}
+			}
+		}
+	}
+	return image;
+}
+
+std::filesystem::path TextureCompression::CachePath(const std::filesystem::path& source)
+{
+	std::error_code error;
+	std::filesystem::path canonical = std::filesystem::weakly_canonical(source, error);
+	if (error) {
+		canonical = std::filesystem::absolute(source);
+	}
+
+	// FNV-1a over the path, then mixed with the size and modification time
+	uint64_t key = 14695981039346656037ull;
+	for (char c : canonical.generic_string()) {
+		key = (key ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+	}
+	key ^= SourceStamp(source) + 0x9E3779B97F4A7C15ull + (key << 6) + (key >> 2);
+
+	char name[17];
+	std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	return std::filesystem::current_path() / "cache" / (source.stem().string() + "-" + name + ".btc");
+}
+
+uint64_t TextureCompression::SourceStamp(const std::filesystem::path& source)
+{
+	std::error_code error;
+	uint64_t size = std::filesystem::file_size(source, error);
+	if (error) {
+		return 0;
+	}
+	auto modified = std::filesystem::last_write_time(source, error).time_since_epoch().count();
+	return size ^ (static_cast<uint64_t>(modified) * 0x9E3779B97F4A7C15ull);
+}
+
+bool TextureCompression::SaveCache(const std::filesystem::path& cachePath, const CompressedTexture& texture, uint64_t sourceStamp)
+{
+	std::error_code error;
+	std::filesystem::create_directories(cachePath.parent_path(), error);
+
+	// pool workers can build the same entry at once, each writes its own temporary file
+	std::filesystem::path temporary = cachePath;
+	temporary += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+	std::ofstream file(temporary, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	CacheHeader header;
+	header.format = static_cast<uint32_t>(texture.format);
+	header.levelCount = static_cast<uint32_t>(texture.levels.size());
+	header.sourceStamp = sourceStamp;
+	header.psnr = texture.psnr;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	for (const auto& level : texture.levels) {
+		CacheLevelHeader levelHeader{ level.width, level.height, level.blocks.size() };
+		file.write(reinterpret_cast<const char*>(&levelHeader), sizeof(levelHeader));
+		file.write(reinterpret_cast<const char*>(level.blocks.data()), static_cast<std::streamsize>(level.blocks.size()));
+	}
+	file.close();
+	if (!file) {
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+
+	// the rename replaces an existing entry in one step, a worker that loses the race leaves the winner's copy
+	std::filesystem::rename(temporary, cachePath, error);
+	if (error) {
+		std::filesystem::remove(temporary, error);
+		return std::filesystem::exists(cachePath, error);
+	}
+	return true;
+}
+
+bool TextureCompression::LoadCache(const std::filesystem::path& cachePath, CompressedTexture& texture, uint64_t sourceStamp)
+{
+	std::ifstream file(cachePath, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	CacheHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	// a stale cache entry is rebuilt from the source image
+	if (!file || header.magic != CacheMagic || header.version != CacheVersion || header.sourceStamp != sourceStamp) {
+		return false;
+	}
+
+	// the entry is checked against what Compress writes before anything is allocated from it, so a corrupt entry is
+	// re-encoded instead of throwing on a worker or handing the upload fewer bytes than the level needs
+	if (header.format != static_cast<uint32_t>(BlockFormat::BC1) && header.format != static_cast<uint32_t>(BlockFormat::BC3)) {
+		return false;
+	}
+	if (header.levelCount == 0 || header.levelCount > static_cast<uint32_t>(Texture::MipLevelCount(MaxCachedSize, 1))) {
+		return false;
+	}
+
+	texture.format = static_cast<BlockFormat>(header.format);
+	texture.psnr = header.psnr;
+	texture.levels.resize(header.levelCount);
+	for (size_t i = 0; i < texture.levels.size(); ++i) {
+		CacheLevelHeader levelHeader;
+		file.read(reinterpret_cast<char*>(&levelHeader), sizeof(levelHeader));
+		if (!file) {
+			return false;
+		}
+
+		// level 0 sets the chain, every later level is half the one before
+		bool sizeMatches = i == 0
+			? levelHeader.width > 0 && levelHeader.height > 0 && levelHeader.width <= MaxCachedSize && levelHeader.height <= MaxCachedSize
+				&& header.levelCount == static_cast<uint32_t>(Texture::MipLevelCount(levelHeader.width, levelHeader.height))
+			: levelHeader.width == std::max(texture.levels[i - 1].width / 2, 1) && levelHeader.height == std::max(texture.levels[i - 1].height / 2, 1);
+		if (!sizeMatches) {
+			return false;
+		}
+		uint64_t expectedBytes = static_cast<uint64_t>(blocksAcross(levelHeader.width)) * blocksAcross(levelHeader.height) * BlockBytes(texture.format);
+		if (levelHeader.byteCount != expectedBytes) {
+			return false;
+		}
+
+		CompressedLevel& level = texture.levels[i];
+		level.width = levelHeader.width;
+		level.height = levelHeader.height;
+		level.blocks.resize(static_cast<size_t>(levelHeader.byteCount));
+		file.read(reinterpret_cast<char*>(level.blocks.data()), static_cast<std::streamsize>(levelHeader.byteCount));
+	}
+	return static_cast<bool>(file);
+}
+
+GLuint TextureCompression::Create(const CompressedTexture& texture)
+{
+	if (texture.levels.empty()) {
+		return 0;
+	}
+
+	GLuint id = 0;
+	glGenTextures(1, &id);
+	GLState::BindTexture(0, GL_TEXTURE_2D, id);
+
+	const CompressedLevel& base = texture.levels[0];
+	glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(texture.levels.size()), GLFormat(texture.format), base.width, base.height);
+	for (size_t i = 0; i < texture.levels.size(); ++i) {
+		const CompressedLevel& level = texture.levels[i];
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), 0, 0, level.width, level.height, GLFormat(texture.format),
+			static_cast<GLsizei>(level.blocks.size()), level.blocks.data());
+	}
+	return id;
+}
@@ -0,0 +1,424 @@
+/*
+*
+* Defines the texture manager that loads, deduplicates, and owns the scene textures
+*
+*/
+
+#include <texture_manager.h>
+#include <gl_state.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace {
+	// each pixel buffer segment holds a band of rows, larger levels are uploaded over several steps
+	constexpr size_t UploadSegmentBytes = 4 * 1024 * 1024;
+
+	size_t chainBytes(const MipChain& chain)
+	{
+		size_t bytes = 0;
+		for (const auto& level : chain.levels) {
+			bytes += level.pixels.size();
+		}
+		return bytes;
+	}
+
+	size_t chainBytes(const CompressedTexture& texture)
+	{
+		size_t bytes = 0;
+		for (const auto& level : texture.levels) {
+			bytes += level.blocks.size();
+		}
+		return bytes;
+	}
+}
+
+void TextureManager::Init(ThreadPool& workerPool, bool compress)
+{
+	pool = &workerPool;
+	pixelRing.Create(UploadSegmentBytes);
+
+	compression = compress && TextureCompression::IsSupported();
+	if (compress && !compression) {
+		std::cerr << "S3TC texture compression is not supported, textures stay RGBA8" << std::endl;
+	}
+
+	MipChain chain = Texture::BuildMipChain(Texture::PlaceholderImage());
+
+	Entry placeholder;
+	placeholder.path = "<placeholder>";
+	placeholder.texture = Texture::Create(chain);
+	placeholder.loaded = true;
+	placeholder.bytes = chainBytes(chain);
+	entries.push_back(placeholder);
+}
+
+void TextureManager::Destroy()
+{
+	// workers still decoding hold a pointer to this manager
+	{
+		std::unique_lock<std::mutex> lock(decodedMutex);
+		decodedReady.wait(lock, [this] { return decodesInFlight == 0; });
+		decoded.clear();
+	}
+
+	for (const auto& job : uploads) {
+		glDeleteTextures(1, &job.texture);
+	}
+	uploads.clear();
+
+	for (const auto& entry : entries) {
+		if (entry.loaded) {
+			GLState::ForgetTexture(entry.texture);
+			glDeleteTextures(1, &entry.texture);
+		}
+	}
+	entries.clear();
+	handlesByPath.clear();
+	pixelRing.Destroy();
+}
+
+std::string TextureManager::canonicalKey(const std::filesystem::path& path) const
+{
+	// the same file reached through different relative paths should still be loaded once
+	std::error_code error;
+	std::string key = std::filesystem::weakly_canonical(path, error).generic_string();
+	if (error) {
+		key = path.lexically_normal().generic_string();
+	}
+	return key;
+}
+
+uint32_t TextureManager::addEntry(const std::string& key)
+{
+	Entry entry;
+	entry.path = key;
+	entry.texture = entries[0].texture;
+	entry.requested = Clock::now();
+
+	uint32_t index = static_cast<uint32_t>(entries.size());
+	entries.push_back(std::move(entry));
+	handlesByPath.emplace(key, index);
+	return index;
+}
+
+void TextureManager::finishEntry(uint32_t index, GLuint texture, size_t bytes)
+{
+	Entry& entry = entries[index];
+	entry.texture = texture;
+	entry.loaded = true;
+	entry.pending = false;
+	entry.bytes = bytes;
+	entry.loadMs = std::chrono::duration<double, std::milli>(Clock::now() - entry.requested).count();
+}
+
+TextureHandle TextureManager::Load(const std::filesystem::path& path)
+{
+	std::string key = canonicalKey(path);
+	auto existing = handlesByPath.find(key);
+	if (existing != handlesByPath.end()) {
+		return TextureHandle{ existing->second };
+	}
+
+	uint32_t index = addEntry(key);
+
+	Image image;
+	if (Texture::LoadImage(path, image)) {
+		MipChain chain = Texture::BuildMipChain(image);
+		entries[index].decodeMs = std::chrono::duration<double, std::milli>(Clock::now() - entries[index].requested).count();
+		entries[index].uncompressedBytes = chainBytes(chain);
+		finishEntry(index, Texture::Create(chain), chainBytes(chain));
+	}
+	else {
+		std::cerr << "Failed to load texture at path: " << path.string() << ", using placeholder" << std::endl;
+		entries[index].loadMs = std::chrono::duration<double, std::milli>(Clock::now() - entries[index].requested).count();
+	}
+
+	return TextureHandle{ index };
+}
+
+TextureHandle TextureManager::LoadAsync(const std::filesystem::path& path)
+{
+	std::string key = canonicalKey(path);
+	auto existing = handlesByPath.find(key);
+	if (existing != handlesByPath.end()) {
+		return TextureHandle{ existing->second };
+	}
+
+	uint32_t index = addEntry(key);
+	entries[index].pending = true;
+
+	{
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		++decodesInFlight;
+	}
+
+	// decoding, mip generation, and compression are the slow part and need no GL context
+	pool->Submit([this, index, path, compress = compression] {
+		auto start = Clock::now();
+
+		DecodedImage result;
+		result.index = index;
+
+		std::filesystem::path cachePath;
+		uint64_t stamp = 0;
+		if (compress) {
+			cachePath = TextureCompression::CachePath(path);
+			stamp = TextureCompression::SourceStamp(path);
+			if (stamp != 0 && TextureCompression::LoadCache(cachePath, result.blocks, stamp)) {
+				result.ok = true;
+				result.compressed = true;
+				result.cached = true;
+				// the RGBA8 size is known from the level dimensions without decoding the source
+				for (const auto& level : result.blocks.levels) {
+					result.uncompressedBytes += static_cast<size_t>(level.width) * level.height * 4;
+				}
+			}
+		}
+
+		Image image;
+		if (!result.ok) {
+			result.ok = Texture::LoadImage(path, image);
+		}
+		if (result.ok && !result.cached) {
+			result.chain = Texture::BuildMipChain(image);
+			result.uncompressedBytes = chainBytes(result.chain);
+			if (compress) {
+				result.blocks = TextureCompression::Compress(result.chain, *pool);
+				result.compressed = true;
+				result.chain.levels.clear();
+				if (!TextureCompression::SaveCache(cachePath, result.blocks, stamp)) {
+					std::cerr << "Failed to write texture cache: " << cachePath.string() << std::endl;
+				}
+			}
+		}
+		else if (!result.ok) {
+			std::cerr << "Failed to load texture at path: " << path.string() << ", using placeholder" << std::endl;
+		}
+		result.decodeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		decoded.push_back(std::move(result));
+		--decodesInFlight;
+		decodedReady.notify_all();
+	});
+
+	return TextureHandle{ index };
+}
+
+// takes finished decodes from the workers and allocates their textures
+void TextureManager::startUploads()
+{
+	std::vector<DecodedImage> ready;
+	{
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		ready.swap(decoded);
+	}
+
+	for (auto& image : ready) {
+		Entry& entry = entries[image.index];
+		entry.decodeMs = image.decodeMs;
+		entry.uncompressedBytes = image.uncompressedBytes;
+
+		if (!image.ok) {
+			entry.pending = false;
+			entry.loadMs = std::chrono::duration<double, std::milli>(Clock::now() - entry.requested).count();
+			continue;
+		}
+
+		UploadJob job;
+		job.index = image.index;
+		job.compressed = image.compressed;
+
+		glGenTextures(1, &job.texture);
+		GLState::BindTexture(0, GL_TEXTURE_2D, job.texture);
+
+		if (image.compressed) {
+			entry.compressed = true;
+			entry.cached = image.cached;
+			entry.format = image.blocks.format;
+			entry.encodeMs = image.blocks.encodeMs;
+			entry.psnr = image.blocks.psnr;
+
+			const CompressedLevel& base = image.blocks.levels[0];
+			job.blocks = std::move(image.blocks);
+			glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(job.blocks.levels.size()), TextureCompression::GLFormat(job.blocks.format),
+				base.width, base.height);
+		}
+		else {
+			const Image& base = image.chain.levels[0];
+			job.chain = std::move(image.chain);
+			glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(job.chain.levels.size()), GL_RGBA8, base.width, base.height);
+		}
+		uploads.push_back(std::move(job));
+	}
+}
+
+bool TextureManager::uploadStep(UploadJob& job)
+{
+	GLState::BindTexture(0, GL_TEXTURE_2D, job.texture);
+	if (job.compressed) {
+		uploadBlockRows(job);
+		return job.level >= job.blocks.levels.size();
+	}
+
+	uploadRows(job);
+	return job.level >= job.chain.levels.size();
+}
+
+void TextureManager::uploadRows(UploadJob& job)
+{
+	const Image& image = job.chain.levels[job.level];
+	size_t rowBytes = static_cast<size_t>(image.width) * 4;
+
+	if (rowBytes > pixelRing.SegmentSize()) {
+		// a single row does not fit in a segment, upload the level straight from client memory
+		GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(job.level), 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+		job.row = image.height;
+	}
+	else {
+		int rowsPerSegment = static_cast<int>(pixelRing.SegmentSize() / rowBytes);
+		int rows = std::min(rowsPerSegment, image.height - job.row);
+
+		GLintptr offset = 0;
+		uint8_t* destination = pixelRing.Map(offset);
+		std::memcpy(destination, image.pixels.data() + rowBytes * job.row, rowBytes * rows);
+		pixelRing.Unmap();
+
+		glTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(job.level), 0, job.row, image.width, rows, GL_RGBA, GL_UNSIGNED_BYTE,
+			reinterpret_cast<const void*>(offset));
+		pixelRing.Fence();
+		job.row += rows;
+	}
+
+	if (job.row >= image.height) {
+		job.row = 0;
+		++job.level;
+	}
+}
+
+// same as uploadRows but in rows of 4x4 blocks, job.row stays in pixels so it is always a multiple of 4
+void TextureManager::uploadBlockRows(UploadJob& job)
+{
+	const CompressedLevel& level = job.blocks.levels[job.level];
+	GLenum format = TextureCompression::GLFormat(job.blocks.format);
+	int blockRows = (level.height + 3) / 4;
+	size_t blockRowBytes = static_cast<size_t>((level.width + 3) / 4) * TextureCompression::BlockBytes(job.blocks.format);
+
+	if (blockRowBytes > pixelRing.SegmentSize()) {
+		GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(job.level), 0, 0, level.width, level.height, format,
+			static_cast<GLsizei>(level.blocks.size()), level.blocks.data());
+		job.row = level.height;
+	}
+	else {
+		int firstBlockRow = job.row / 4;
+		int rowsPerSegment = static_cast<int>(pixelRing.SegmentSize() / blockRowBytes);
+		int rows = std::min(rowsPerSegment, blockRows - firstBlockRow);
+		size_t bytes = blockRowBytes * rows;
+
+		GLintptr offset = 0;
+		uint8_t* destination = pixelRing.Map(offset);
+		std::memcpy(destination, level.blocks.data() + blockRowBytes * firstBlockRow, bytes);
+		pixelRing.Unmap();
+
+		// the last block row of a level whose height is not a multiple of 4 is only partly covered
+		int pixelRows = std::min(rows * 4, level.height - job.row);
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(job.level), 0, job.row, level.width, pixelRows, format,
+			static_cast<GLsizei>(bytes), reinterpret_cast<const void*>(offset));
+		pixelRing.Fence();
+		job.row += rows * 4;
+	}
+
+	if (job.row >= level.height) {
+		job.row = 0;
+		++job.level;
+	}
+}
+
+void TextureManager::Update(double budgetMs)
+{
+	bool hadWork = HasPending();
+	auto start = Clock::now();
+
+	startUploads();
+
+	// always make some progress, then stop once the frame's budget is spent
+	while (!uploads.empty()) {
+		UploadJob& job = uploads.front();
+		if (uploadStep(job)) {
+			finishEntry(job.index, job.texture, job.compressed ? chainBytes(job.blocks) : chainBytes(job.chain));
+			uploads.pop_front();
+		}
+
+		if (std::chrono::duration<double, std::milli>(Clock::now() - start).count() >= budgetMs) {
+			break;
+		}
+	}
+
+	// texture uploads elsewhere read from client memory
+	GLState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (hadWork && !HasPending()) {
+		PrintReport();
+	}
+}
+
+void TextureManager::Flush()
+{
+	{
+		std::unique_lock<std::mutex> lock(decodedMutex);
+		decodedReady.wait(lock, [this] { return decodesInFlight == 0; });
+	}
+	Update(std::numeric_limits<double>::infinity());
+}
+
+bool TextureManager::HasPending() const
+{
+	for (const auto& entry : entries) {
+		if (entry.pending) {
+			return true;
+		}
+	}
+	return false;
+}
+
+GLuint TextureManager::Get(TextureHandle handle) const
+{
+	if (handle.index >= entries.size()) {
+		return entries.empty() ? 0 : entries[0].texture;
+	}
+	return entries[handle.index].texture;
+}
+
+void TextureManager::PrintReport() const
+{
+	double totalMs = 0.0;
+	size_t totalBytes = 0, totalUncompressed = 0;
+	for (size_t i = 1; i < entries.size(); ++i) {
+		const Entry& entry = entries[i];
+		std::cout << "  " << entry.path << ": decode " << entry.decodeMs << " ms, ready after " << entry.loadMs << " ms, "
+			<< entry.bytes / 1024 << " KiB" << (entry.loaded ? "" : " (placeholder)");
+		if (entry.compressed) {
+			std::cout << ", " << (entry.format == BlockFormat::BC1 ? "BC1" : "BC3") << " vs " << entry.uncompressedBytes / 1024 << " KiB RGBA8, "
+				<< "PSNR " << entry.psnr << " dB, ";
+			if (entry.cached) {
+				std::cout << "from cache";
+			}
+			else {
+				std::cout << "encode " << entry.encodeMs << " ms";
+			}
+		}
+		std::cout << std::endl;
+		totalMs = std::max(totalMs, entry.loadMs);
+		totalBytes += entry.bytes;
+		totalUncompressed += entry.loaded ? entry.uncompressedBytes : entry.bytes;
+	}
+	std::cout << "Textures: " << entries.size() - 1 << " ready within " << totalMs << " ms, " << totalBytes / 1024 << " KiB";
+	if (totalBytes != totalUncompressed) {
+		std::cout << " (" << totalUncompressed / 1024 << " KiB as RGBA8)";
+	}
+	std::cout << std::endl;
+}
@@ -0,0 +1,129 @@
+/*
+*
+* Defines the thread pool used for background work
+*
+*/
+
+#include <thread_pool.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+	if (threadCount == 0) {
+		threadCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	}
+
+	workers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; ++i) {
+		workers.emplace_back([this] { workerLoop(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	taskAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	allDone.wait(lock, [this] { return tasks.empty() && activeTasks == 0; });
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)>& body)
+{
+	if (count == 0) {
+		return;
+	}
+	chunkSize = std::max<size_t>(chunkSize, 1);
+	size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	// shared with the helper tasks, which may only start running after this call has returned
+	struct Work {
+		std::function<void(size_t, size_t)> body;
+		size_t count{ 0 };
+		size_t chunkSize{ 0 };
+		size_t chunkCount{ 0 };
+		std::atomic<size_t> nextChunk{ 0 };
+		std::atomic<size_t> doneChunks{ 0 };
+		std::mutex doneMutex;
+		std::condition_variable doneSignal;
+
+		// grabs chunks until none are left
+		void run()
+		{
+			size_t chunk;
+			while ((chunk = nextChunk.fetch_add(1)) < chunkCount) {
+				size_t begin = chunk * chunkSize;
+				body(begin, std::min(begin + chunkSize, count));
+				if (doneChunks.fetch_add(1) + 1 == chunkCount) {
+					std::lock_guard<std::mutex> lock(doneMutex);
+					doneSignal.notify_all();
+				}
+			}
+		}
+	};
+
+	auto work = std::make_shared<Work>();
+	work->body = body;
+	work->count = count;
+	work->chunkSize = chunkSize;
+	work->chunkCount = chunkCount;
+
+	size_t helpers = std::min(workers.size(), chunkCount - 1);
+	for (size_t i = 0; i < helpers; ++i) {
+		Submit([work] { work->run(); });
+	}
+
+	work->run();
+
+	std::unique_lock<std::mutex> lock(work->doneMutex);
+	work->doneSignal.wait(lock, [&] { return work->doneChunks.load() == work->chunkCount; });
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty()) {
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+			++activeTasks;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--activeTasks;
+			if (tasks.empty() && activeTasks == 0) {
+				allDone.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,183 @@
+/*
+*
+* Defines the triangle BVH build and the four wide ray-triangle kernel
+*
+*/
+
+#include <triangle_bvh.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRIANGLE_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+	constexpr float Epsilon = 1.0e-8f;
+	constexpr float Infinity = std::numeric_limits<float>::infinity();
+}
+
+void TriangleBvh::Build(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+{
+	triangleCount = indices.size() / 3;
+	blocks.clear();
+	leafBlocks.assign(triangleCount, 0);
+	bounds = {};
+
+	std::vector<MeshBounds> triangleBounds(triangleCount);
+	for (size_t i = 0; i < triangleCount; ++i) {
+		const glm::vec3& a = vertices[indices[i * 3]].Position;
+		const glm::vec3& b = vertices[indices[i * 3 + 1]].Position;
+		const glm::vec3& c = vertices[indices[i * 3 + 2]].Position;
+		triangleBounds[i] = { glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)) };
+	}
+	bvh.Build(triangleBounds, 4, 4);
+	if (bvh.Empty()) {
+		return;
+	}
+	bounds = { bvh.Nodes()[0].min, bvh.Nodes()[0].max };
+
+	// every leaf gets its own blocks so a leaf is tested with one kernel call, leaves cut off at the
+	// maximum depth can be larger than four and take several
+	const auto& items = bvh.Items();
+	for (const BvhNode& node : bvh.Nodes()) {
+		if (!node.IsLeaf()) {
+			continue;
+		}
+
+		leafBlocks[node.leftOrFirst] = static_cast<uint32_t>(blocks.size());
+		for (uint32_t first = 0; first < node.count; first += 4) {
+			Triangle4& block = blocks.emplace_back();
+			for (uint32_t lane = 0; lane < 4; ++lane) {
+				glm::vec3 v0(0.0f), e1(0.0f), e2(0.0f);
+				uint32_t triangle = ~0u;
+				if (first + lane < node.count) {
+					triangle = items[node.leftOrFirst + first + lane];
+					v0 = vertices[indices[triangle * 3]].Position;
+					e1 = vertices[indices[triangle * 3 + 1]].Position - v0;
+					e2 = vertices[indices[triangle * 3 + 2]].Position - v0;
+				}
+				block.v0x[lane] = v0.x; block.v0y[lane] = v0.y; block.v0z[lane] = v0.z;
+				block.e1x[lane] = e1.x; block.e1y[lane] = e1.y; block.e1z[lane] = e1.z;
+				block.e2x[lane] = e2.x; block.e2y[lane] = e2.y; block.e2z[lane] = e2.z;
+				block.triangle[lane] = triangle;
+			}
+		}
+	}
+}
+
+const char* TriangleBvh::SimdName()
+{
+#if defined(TRIANGLE_SSE)
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
+
+int TriangleBvh::intersect4(const Triangle4& block, const Ray& ray, float* distance, float* u, float* v)
+{
+#if defined(TRIANGLE_SSE)
+	__m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y), dz = _mm_set1_ps(ray.direction.z);
+	__m128 e1x = _mm_loadu_ps(block.e1x), e1y = _mm_loadu_ps(block.e1y), e1z = _mm_loadu_ps(block.e1z);
+	__m128 e2x = _mm_loadu_ps(block.e2x), e2y = _mm_loadu_ps(block.e2y), e2z = _mm_loadu_ps(block.e2z);
+
+	// p = d x e2, det = e1 . p
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+	__m128 valid = _mm_cmpgt_ps(absDet, _mm_set1_ps(Epsilon));
+	__m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+	// s = o - v0, u = (s . p) / det
+	__m128 sx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_loadu_ps(block.v0x));
+	__m128 sy = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_loadu_ps(block.v0y));
+	__m128 sz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_loadu_ps(block.v0z));
+	__m128 uu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+
+	// q = s x e1, v = (d . q) / det, t = (e2 . q) / det
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+	__m128 vv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDet);
+	__m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+	__m128 zero = _mm_setzero_ps();
+	valid = _mm_and_ps(valid, _mm_cmpge_ps(uu, zero));
+	valid = _mm_and_ps(valid, _mm_cmpge_ps(vv, zero));
+	valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(uu, vv), _mm_set1_ps(1.0f)));
+	valid = _mm_and_ps(valid, _mm_cmpgt_ps(tt, _mm_set1_ps(Epsilon)));
+	valid = _mm_and_ps(valid, _mm_cmplt_ps(tt, _mm_set1_ps(ray.tMax)));
+
+	_mm_storeu_ps(distance, tt);
+	_mm_storeu_ps(u, uu);
+	_mm_storeu_ps(v, vv);
+	return _mm_movemask_ps(valid);
+#else
+	int mask = 0;
+	for (int lane = 0; lane < 4; ++lane) {
+		glm::vec3 e1(block.e1x[lane], block.e1y[lane], block.e1z[lane]);
+		glm::vec3 e2(block.e2x[lane], block.e2y[lane], block.e2z[lane]);
+		glm::vec3 p = glm::cross(ray.direction, e2);
+		float det = glm::dot(e1, p);
+		if (std::abs(det) <= Epsilon) {
+			continue;
+		}
+
+		float inverseDet = 1.0f / det;
+		glm::vec3 s = ray.origin - glm::vec3(block.v0x[lane], block.v0y[lane], block.v0z[lane]);
+		glm::vec3 q = glm::cross(s, e1);
+		u[lane] = glm::dot(s, p) * inverseDet;
+		v[lane] = glm::dot(ray.direction, q) * inverseDet;
+		distance[lane] = glm::dot(e2, q) * inverseDet;
+		if (u[lane] >= 0.0f && v[lane] >= 0.0f && u[lane] + v[lane] <= 1.0f && distance[lane] > Epsilon && distance[lane] < ray.tMax) {
+			mask |= 1 << lane;
+		}
+	}
+	return mask;
+#endif
+}
+
+template <bool AnyHit>
+bool TriangleBvh::traverse(const Ray& ray, RayHit& hit) const
+{
+	bool found = false;
+	bvh.TraverseRay(ray, [&](uint32_t first, uint32_t count, const Ray& current) {
+		float closest = Infinity;
+		uint32_t blockCount = (count + 3) / 4;
+		for (uint32_t b = 0; b < blockCount; ++b) {
+			const Triangle4& block = blocks[leafBlocks[first] + b];
+			float distance[4], u[4], v[4];
+			int mask = intersect4(block, current, distance, u, v);
+			if (mask == 0) {
+				continue;
+			}
+
+			found = true;
+			if constexpr (AnyHit) {
+				return -1.0f;
+			}
+			for (int lane = 0; lane < 4; ++lane) {
+				if ((mask & (1 << lane)) && distance[lane] < closest) {
+					closest = distance[lane];
+					hit = { distance[lane], block.triangle[lane], u[lane], v[lane] };
+				}
+			}
+		}
+		return closest;
+	});
+	return found;
+}
+
+bool TriangleBvh::Intersect(const Ray& ray, RayHit& hit) const
+{
+	return traverse<false>(ray, hit);
+}
+
+bool TriangleBvh::Occluded(const Ray& ray) const
+{
+	RayHit hit;
+	return traverse<true>(ray, hit);
+}
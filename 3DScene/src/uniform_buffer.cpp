@@ -0,0 +1,117 @@
+/*
+*
+* Defines the uniform buffer classes used for per-frame and per-object shader data
+*
+*/
+
+#include <uniform_buffer.h>
+#include <gl_state.h>
+#include <algorithm>
+#include <cstring>
+
+GLint UniformBlockBinding(std::string_view blockName)
+{
+	if (blockName == "FrameData") {
+		return FrameBinding;
+	}
+	if (blockName == "ObjectData") {
+		return ObjectBinding;
+	}
+	return -1;
+}
+
+void UniformBuffer::Create(GLsizeiptr size)
+{
+	bufferSize = size;
+	glGenBuffers(1, &buffer);
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+}
+
+void UniformBuffer::Destroy()
+{
+	GLState::ForgetBuffer(buffer);
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+void UniformBuffer::Update(const void* data, GLsizeiptr size, GLintptr offset)
+{
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
+
+void UniformBuffer::BindBase(GLuint bindingPoint)
+{
+	GLState::BindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, buffer, 0, bufferSize);
+}
+
+void UniformRing::Create(GLsizeiptr size, uint32_t recordCapacity, uint32_t framesInFlight)
+{
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+	recordSize = size;
+	stride = (size + alignment - 1) / alignment * alignment;
+	capacity = recordCapacity;
+	frames = framesInFlight;
+	frameIndex = 0;
+	count = 0;
+	staging.assign(static_cast<size_t>(stride) * capacity, 0);
+
+	glGenBuffers(1, &buffer);
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, stride * capacity * frames, nullptr, GL_DYNAMIC_DRAW);
+}
+
+void UniformRing::Destroy()
+{
+	GLState::ForgetBuffer(buffer);
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+// moves on to the next frame's segment of the buffer
+void UniformRing::BeginFrame()
+{
+	frameIndex = (frameIndex + 1) % frames;
+	count = 0;
+}
+
+uint32_t UniformRing::Push(const void* record)
+{
+	if (count >= capacity) {
+		grow();
+	}
+
+	std::memcpy(staging.data() + static_cast<size_t>(stride) * count, record, static_cast<size_t>(recordSize));
+	return count++;
+}
+
+// Doubles the capacity when a frame has more objects than fit. The records pushed so far stay in the staging copy
+// and are uploaded into the new storage, draws already issued keep reading the storage the driver orphaned
+void UniformRing::grow()
+{
+	capacity = std::max(capacity * 2, 1u);
+	staging.resize(static_cast<size_t>(stride) * capacity, 0);
+
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, stride * capacity * frames, nullptr, GL_DYNAMIC_DRAW);
+}
+
+// uploads every record pushed this frame with a single call
+void UniformRing::Upload()
+{
+	if (count == 0) {
+		return;
+	}
+
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, stride * capacity * frameIndex, stride * count, staging.data());
+}
+
+void UniformRing::Bind(GLuint bindingPoint, uint32_t slot)
+{
+	GLintptr offset = stride * capacity * frameIndex + stride * slot;
+	GLState::BindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, buffer, offset, recordSize);
+}
@@ -0,0 +1,189 @@
+/*
+*
+* Defines the vertex layouts and the packing of authored vertices into them
+*
+*/
+
+#include <vertex_layout.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <glm/gtc/packing.hpp>
+
+namespace {
+	// attributes start on 4 byte boundaries, which every driver fetches at full speed
+	uint32_t align4(uint32_t bytes)
+	{
+		return (bytes + 3) & ~3u;
+	}
+
+	void write(uint8_t* destination, const void* source, size_t bytes)
+	{
+		std::memcpy(destination, source, bytes);
+	}
+
+	bool uvsInUnitRange(std::span<const Vertex> vertices)
+	{
+		for (const auto& vertex : vertices) {
+			if (vertex.Uv.x < 0.0f || vertex.Uv.x > 1.0f || vertex.Uv.y < 0.0f || vertex.Uv.y > 1.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	glm::vec2 signNotZero(glm::vec2 value)
+	{
+		return glm::vec2(value.x >= 0.0f ? 1.0f : -1.0f, value.y >= 0.0f ? 1.0f : -1.0f);
+	}
+}
+
+uint32_t VertexPacking::OctEncode(glm::vec3 normal)
+{
+	// project onto the octahedron, then fold the lower half over the diagonals
+	float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (length == 0.0f) {
+		return glm::packSnorm2x16(glm::vec2(0.0f));
+	}
+
+	glm::vec2 encoded = glm::vec2(normal.x, normal.y) / length;
+	if (normal.z < 0.0f) {
+		encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * signNotZero(encoded);
+	}
+	return glm::packSnorm2x16(encoded);
+}
+
+glm::vec3 VertexPacking::OctDecode(uint32_t encoded)
+{
+	glm::vec2 e = glm::unpackSnorm2x16(encoded);
+	glm::vec3 normal(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+	float t = std::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -t : t;
+	normal.y += normal.y >= 0.0f ? -t : t;
+	return glm::normalize(normal);
+}
+
+VertexLayout VertexPacking::MakeLayout(const VertexFormat& format)
+{
+	VertexLayout layout;
+	layout.format = format;
+	uint32_t offset = 0;
+
+	if (format.position == PositionFormat::Float3) {
+		layout.attributes.push_back({ PositionLocation, 3, GL_FLOAT, GL_FALSE, offset });
+		offset += 12;
+	}
+	else {
+		layout.attributes.push_back({ PositionLocation, 3, GL_HALF_FLOAT, GL_FALSE, offset });
+		offset += align4(6);
+	}
+
+	if (format.normal == NormalFormat::Float3) {
+		layout.attributes.push_back({ NormalLocation, 3, GL_FLOAT, GL_FALSE, offset });
+		offset += 12;
+	}
+	else {
+		layout.attributes.push_back({ NormalLocation, 2, GL_SHORT, GL_TRUE, offset });
+		offset += 4;
+	}
+
+	switch (format.uv) {
+	case UvFormat::Float2:
+		layout.attributes.push_back({ UvLocation, 2, GL_FLOAT, GL_FALSE, offset });
+		offset += 8;
+		break;
+	case UvFormat::Half2:
+		layout.attributes.push_back({ UvLocation, 2, GL_HALF_FLOAT, GL_FALSE, offset });
+		offset += 4;
+		break;
+	case UvFormat::Unorm16:
+		layout.attributes.push_back({ UvLocation, 2, GL_UNSIGNED_SHORT, GL_TRUE, offset });
+		offset += 4;
+		break;
+	}
+
+	layout.stride = offset;
+	return layout;
+}
+
+PackedVertices VertexPacking::Pack(std::span<const Vertex> vertices, VertexFormat format)
+{
+	if (format.uv == UvFormat::Unorm16 && !uvsInUnitRange(vertices)) {
+		std::cerr << "UVs outside [0, 1] cannot be stored as unorm16, using half floats" << std::endl;
+		format.uv = UvFormat::Half2;
+	}
+
+	PackedVertices packed;
+	packed.layout = MakeLayout(format);
+	packed.count = static_cast<uint32_t>(vertices.size());
+	packed.data.resize(static_cast<size_t>(packed.layout.stride) * vertices.size());
+
+	if (!vertices.empty()) {
+		packed.bounds.min = packed.bounds.max = vertices[0].Position;
+		for (const auto& vertex : vertices) {
+			packed.bounds.min = glm::min(packed.bounds.min, vertex.Position);
+			packed.bounds.max = glm::max(packed.bounds.max, vertex.Position);
+		}
+
+		// centered on the box, the farthest vertex gives a tighter radius than the box corners
+		packed.sphere.center = packed.bounds.Center();
+		float radiusSquared = 0.0f;
+		for (const auto& vertex : vertices) {
+			glm::vec3 offset = vertex.Position - packed.sphere.center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		packed.sphere.radius = std::sqrt(radiusSquared);
+	}
+
+	// half positions are scaled into [-1, 1] over the mesh bounds, where half precision is densest
+	if (format.position == PositionFormat::Half3 && !vertices.empty()) {
+		packed.dequantOffset = packed.bounds.Center();
+		packed.dequantScale = glm::max(packed.bounds.Extents(), glm::vec3(1e-6f));
+	}
+
+	uint8_t* destination = packed.data.data();
+	for (const auto& vertex : vertices) {
+		uint8_t* cursor = destination;
+
+		if (format.position == PositionFormat::Float3) {
+			write(cursor, &vertex.Position, 12);
+			cursor += 12;
+		}
+		else {
+			glm::vec3 unit = (vertex.Position - packed.dequantOffset) / packed.dequantScale;
+			uint16_t halves[4] = { glm::packHalf1x16(unit.x), glm::packHalf1x16(unit.y), glm::packHalf1x16(unit.z), 0 };
+			write(cursor, halves, 8);
+			cursor += 8;
+		}
+
+		if (format.normal == NormalFormat::Float3) {
+			write(cursor, &vertex.Normal, 12);
+			cursor += 12;
+		}
+		else {
+			uint32_t oct = OctEncode(vertex.Normal);
+			write(cursor, &oct, 4);
+			cursor += 4;
+		}
+
+		switch (format.uv) {
+		case UvFormat::Float2:
+			write(cursor, &vertex.Uv, 8);
+			break;
+		case UvFormat::Half2: {
+			uint32_t uv = glm::packHalf2x16(vertex.Uv);
+			write(cursor, &uv, 4);
+			break;
+		}
+		case UvFormat::Unorm16: {
+			uint32_t uv = glm::packUnorm2x16(vertex.Uv);
+			write(cursor, &uv, 4);
+			break;
+		}
+		}
+
+		destination += packed.layout.stride;
+	}
+	return packed;
+}